@@ -5,214 +5,540 @@
 #include "alarm.h"
 #include "minithread.h"
 #include "queue.h"
+#include "slab.h"
 
-//alarm node type, inside the alarm list
-typedef struct alarm_node{
-    alarm_t alarm;
-    alarm_node_t next;
-} alarm_node;
+/*
+ * Alarms are kept in a hierarchical timing wheel: WHEEL_LEVELS wheels of
+ * WHEEL_SLOTS slots each. An alarm due within WHEEL_SLOTS ticks goes in
+ * the first wheel, in the slot for its tick; one due later goes in the
+ * slot of a coarser wheel that covers its tick, and is moved down
+ * (cascaded) into a finer wheel when time gets to that slot. Setting and
+ * cancelling an alarm only link and unlink it from its slot, and a tick
+ * only looks at the slot for that tick.
+ *
+ * The wheels tick every ALARM_TICK on the monotonic clock (tick n is
+ * at n * ALARM_TICK), much finer than the scheduler's clock ticks. An
+ * alarm goes off at the first tick at or after its deadline, and the
+ * alarm timer is kept set for the first alarm's tick.
+ *
+ * Once the alarm worker is started (alarm_set_deferred), alarms that go
+ * off are moved onto the due list rather than run by the interrupt
+ * handler, and the worker runs them with interrupts enabled, a budget
+ * at a time (alarm_run_due). An alarm on the due list is still pending:
+ * deregistering it takes it off.
+ */
+#define ALARM_TICK (100 * MICROSECOND)
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1 << (WHEEL_BITS * WHEEL_LEVELS)) //ticks the wheels cover
+#define DUE_LEVEL -1 //level of the alarms on the due list
 
-//our list of alarms
-typedef struct alarm_list{
-    int len;
-    alarm_node_t head;
-} alarm_list;
+#define ALARM_BUDGET 64 //alarms the worker runs before giving up the processor
+#define ALARM_BUDGET_TIME (2 * MILLISECOND) //or time it spends running them
 
 //alarm type, equivalent of alarm_id
 typedef struct alarm{
-    int reg_time;
-    int delay;
+    alarm_t next; //in its slot; overwritten by the slab when freed
+    alarm_t* pprev; //the pointer to this alarm in its slot
+    int pending; //set, and neither gone off nor deregistered
+    int level; //the wheel it is in, or DUE_LEVEL
+    int64_t expires; //the tick it goes off at
+    uint64_t when; //the time it was set for
     alarm_handler_t alarm_func;
     void* alarm_func_arg;
 } alarm;
 
-//global list containing all alarms
+//our wheels of alarms
+typedef struct alarm_list{
+    int len;
+    int64_t next_tick; //the first tick whose alarms have not gone off yet
+    uint64_t next_deadline; //no alarm is due before this (the alarm timer's), or 0
+    int count[WHEEL_LEVELS]; //alarms in each wheel
+    alarm_t slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    int deferred; //functions are left to the alarm worker
+    int due_len;
+    alarm_t due; //gone off, waiting for the worker, oldest first
+    alarm_t* due_tail; //the next pointer of the last of them
+    alarm_stats stats;
+} alarm_list;
+
+//global wheels containing all alarms
 alarm_list_t a_list;
 
-//gives length of alarm
+static slab_cache alarm_cache = SLAB_CACHE_INIT("alarm", alarm);
+
+//gives number of alarms set
 int
 alarm_list_len(alarm_list_t a_list){
     return a_list->len;
 }
 
-//adds a new alarm node into the alarm list
-//takes in delay in clock ticks (not seconds)
-//reg_time is the time the alarm was set at,
-//also in clock ticks
-alarm_id
-set_alarm(int delay, alarm_handler_t alarm, void* arg, int reg_time ){
-    alarm_t new_alarm;
-    alarm_node_t new_node;
-    alarm_node_t curr_hd;
-    interrupt_level_t l;
+static void
+alarm_link(int level, alarm_t* slot, alarm_t a){
+    a->level = level;
+    a_list->count[level]++;
+    a_list->len++;
+    a->next = *slot;
+    if (a->next != NULL){
+        a->next->pprev = &a->next;
+    }
+    a->pprev = slot;
+    *slot = a;
+}
 
-    l = set_interrupt_level(DISABLED);
+static void
+alarm_unlink(alarm_t a){
+    if (a->level == DUE_LEVEL){
+        a_list->due_len--;
+        if (a_list->due_tail == &a->next){
+            a_list->due_tail = a->pprev;
+        }
+    }
+    else{
+        a_list->count[a->level]--;
+        a_list->len--;
+    }
+    *a->pprev = a->next;
+    if (a->next != NULL){
+        a->next->pprev = a->pprev;
+    }
+}
 
-    //NULL checking
-    if ( alarm == NULL || a_list == NULL){
-        set_interrupt_level(l);
-        return NULL;
+//puts an alarm that went off at the end of the due list
+static void
+alarm_defer(alarm_t a){
+    a->level = DUE_LEVEL;
+    a->next = NULL;
+    a->pprev = a_list->due_tail;
+    *a_list->due_tail = a;
+    a_list->due_tail = &a->next;
+    a_list->due_len++;
+    if (a_list->due_len > a_list->stats.max_due){
+        a_list->stats.max_due = a_list->due_len;
     }
+}
 
-    new_alarm = (alarm_t)register_alarm(delay,alarm, arg);
-    new_alarm->reg_time = reg_time;
+//runs an alarm's function, with interrupts at level l, and frees it.
+//Interrupts must be disabled, and the alarm off the wheels
+static void
+alarm_fire(alarm_t a, interrupt_level_t l){
+    uint64_t start = clock_now();
+    uint64_t late = start > a->when ? start - a->when : 0;
+    uint64_t bound = MICROSECOND;
+    int bucket;
 
-    new_node = (alarm_node_t)malloc(sizeof(alarm_node));
-    if (!new_node){
-        set_interrupt_level(l);
-        return NULL;
+    a->pending = 0;
+    a_list->stats.fired++;
+    a_list->stats.total_latency += late;
+    if (late > a_list->stats.max_latency){
+        a_list->stats.max_latency = late;
     }
-    //initialize..
-    new_node->alarm = new_alarm;
-    new_node->next = NULL;
-    curr_hd = a_list->head;
-
-    if (a_list->len == 0){
-        //make new node head since list was empty
-        a_list->head = new_node;
-    } else if (curr_hd->alarm->reg_time +
-            curr_hd->alarm->delay - reg_time > delay){
-        //make new node head since old head was later
-        new_node->next = curr_hd;
-        a_list->head = new_node;
-    } else {
-        //add new node to right place in sorted list
-        while (curr_hd->next != NULL &&
-                    curr_hd->next->alarm->reg_time +
-                    curr_hd->next->alarm->delay - reg_time < delay){
-           curr_hd = curr_hd->next;
+    for (bucket = 0; bucket < ALARM_LATENCY_BUCKETS - 1; bucket++){
+        if (late < bound){
+            break;
         }
-        new_node->next = curr_hd->next;
-        curr_hd->next = new_node;
+        bound *= 10;
     }
-    a_list->len += 1;
+    a_list->stats.latency[bucket]++;
+
     set_interrupt_level(l);
+    ( a->alarm_func )( a->alarm_func_arg);
+    set_interrupt_level(DISABLED);
+
+    late = clock_now() - start;
+    if (late > a_list->stats.max_run){
+        a_list->stats.max_run = late;
+    }
+    slab_free(&alarm_cache, a);
+}
+
+//puts an alarm in the slot that covers its tick
+static void
+alarm_insert(alarm_t a){
+    int64_t delta = a->expires - a_list->next_tick;
+    int level;
+
+    if (delta < 0){
+        //late: it goes off with the next tick
+        alarm_link(0, &a_list->slots[0][a_list->next_tick & WHEEL_MASK], a);
+        return;
+    }
+    if (delta >= WHEEL_SPAN){
+        //past the last wheel: park it as far out as it goes, it is
+        //put back in when time gets there
+        delta = WHEEL_SPAN - 1;
+    }
+    for (level = 0; level < WHEEL_LEVELS - 1; level++){
+        if (delta < 1 << (WHEEL_BITS * (level + 1))){
+            break;
+        }
+    }
+    alarm_link(level, &a_list->slots[level][((a_list->next_tick + delta)
+                >> (WHEEL_BITS * level)) & WHEEL_MASK], a);
+}
+
+//moves the alarms in a slot of a coarser wheel into finer ones.
+//returns the slot's index
+static int
+alarm_cascade(int level){
+    int index = (a_list->next_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    alarm_t a = a_list->slots[level][index];
+    alarm_t next;
+
+    a_list->slots[level][index] = NULL;
+    while (a != NULL){
+        next = a->next;
+        a_list->count[level]--;
+        a_list->len--;
+        alarm_insert(a);
+        a = next;
+    }
+    return index;
+}
+
+//gives the time the first alarm goes off at,
+//on the monotonic clock, or 0 if there are none
+uint64_t
+alarm_next_deadline(){
+    int64_t next = -1;
+    int level;
+    int64_t index;
+    int i;
+    alarm_t a;
+
+    if (a_list == NULL || a_list->len == 0){
+        return 0;
+    }
+    //the earliest alarm of each wheel is in its first slot in use,
+    //counting from where time is now
+    for (level = 0; level < WHEEL_LEVELS; level++){
+        if (a_list->count[level] == 0){
+            continue;
+        }
+        index = (a_list->next_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        for (i = level == 0 ? 0 : 1; i <= WHEEL_SLOTS; i++){
+            a = a_list->slots[level][(index + i) & WHEEL_MASK];
+            if (a != NULL){
+                break;
+            }
+        }
+        for (; a != NULL; a = a->next){
+            if (next == -1 || a->expires < next){
+                next = a->expires;
+            }
+        }
+    }
+    if (next == -1){
+        //all that is left is on the due list
+        return 0;
+    }
+    if (next < a_list->next_tick){
+        next = a_list->next_tick;
+    }
+    return (uint64_t)next * ALARM_TICK;
+}
+
+//gives the time the first alarm goes off at,
+//in clock ticks, or -1 if there are none
+int
+alarm_next_time(){
+    uint64_t next = alarm_next_deadline();
+
+    if (next == 0){
+        return -1;
+    }
+    if (next <= boot_time){
+        return 0;
+    }
+    return (next - boot_time + TIME_QUANTA - 1) / TIME_QUANTA;
+}
+
+//takes an alarm from the slab, not yet set
+static alarm_t
+alarm_create(alarm_handler_t func, void *arg){
+    alarm_t new_alarm;
+
+    new_alarm = (alarm_t)slab_alloc(&alarm_cache);
+    if (!new_alarm){
+        return NULL;
+    }
+    new_alarm->pending = 0;
+    new_alarm->alarm_func = func;
+    new_alarm->alarm_func_arg = arg;
     return new_alarm;
 }
 
-/* see alarm.h 
- * NOTE: Does not need interrupts disabled because
- * it does not touch global data structures other
- * than for error checking purposes. All global
- * data structure manipulation happens in set_alarm
- * */
+/* see alarm.h */
 alarm_id
-register_alarm(int delay, alarm_handler_t alarm, void *arg)
-{
+set_alarm_at(uint64_t when, alarm_handler_t alarm, void* arg){
     alarm_t new_alarm;
+    uint64_t deadline;
+    interrupt_level_t l;
 
-    if (alarm == NULL || a_list == NULL){
+    l = set_interrupt_level(DISABLED);
+
+    //NULL checking
+    if ( alarm == NULL || a_list == NULL){
+        set_interrupt_level(l);
         return NULL;
     }
 
-    new_alarm = (alarm_t)malloc(sizeof(alarm));
+    new_alarm = alarm_create(alarm, arg);
     if (!new_alarm){
+        set_interrupt_level(l);
         return NULL;
     }
+    //round up, it must not go off early
+    new_alarm->when = when;
+    new_alarm->expires = (when + ALARM_TICK - 1) / ALARM_TICK;
+    new_alarm->pending = 1;
+    alarm_insert(new_alarm);
+    //the first alarm is earlier now, the alarm timer must go off sooner
+    deadline = (uint64_t)new_alarm->expires * ALARM_TICK;
+    if (a_list->next_deadline == 0 || deadline < a_list->next_deadline){
+        a_list->next_deadline = deadline;
+        clock_set_alarm(deadline);
+    }
+    set_interrupt_level(l);
+    return new_alarm;
+}
 
-    //initialize...
-    new_alarm->delay = delay;
-    new_alarm->alarm_func = alarm;
-    new_alarm->alarm_func_arg = arg;
+//adds a new alarm to the wheels
+//takes in delay in clock ticks (not seconds)
+//reg_time is the time the alarm was set at,
+//also in clock ticks
+alarm_id
+set_alarm(int delay, alarm_handler_t alarm, void* arg, int reg_time ){
+    int64_t tick = (int64_t)reg_time + delay;
 
-    return new_alarm;
+    return set_alarm_at(tick > 0 ? boot_time + (uint64_t)tick * TIME_QUANTA
+            : boot_time, alarm, arg);
 }
 
 /* see alarm.h */
-//assumptions: deregister always called on alarms that
-//were actually registered before
+alarm_id
+register_alarm(int delay, alarm_handler_t alarm, void *arg)
+{
+    return set_alarm_at(clock_now() + (uint64_t)delay * MILLISECOND, alarm, arg);
+}
+
+/* see alarm.h */
+//alarms that went off have been freed, but the slab keeps their
+//memory for alarms, so their pending flag still says they went off
+//(until the alarm is reused)
 int
-deregister_alarm(alarm_id alarm)
+deregister_alarm(alarm_id id)
 {
-    alarm_node_t curr_hd;
-    alarm_node_t tmp;
+    alarm_t alarm = (alarm_t)id;
     interrupt_level_t l;
 
     l = set_interrupt_level(DISABLED);
 
-    //if null alarm, return 0
+    //if null alarm, return -1
     if (alarm == NULL || a_list == NULL){
         set_interrupt_level(l);
         return -1;
     }
-    //if list empty, alarm was executed
-    if (a_list->len == 0){
+    //alarm was executed previously
+    if (!alarm->pending){
         set_interrupt_level(l);
         return 1;
     }
-    curr_hd = a_list->head;
-    //if head is alarm, free it and return 0
-    if ( (alarm_id)(curr_hd->alarm) == alarm ){
-        tmp = curr_hd->next;
-        //free(curr_hd->alarm->alarm_func);
-        //free(curr_hd->alarm->alarm_func_arg);
-        free(curr_hd->alarm);
-        free(curr_hd);
+    alarm_unlink(alarm);
+    alarm->pending = 0;
+    slab_free(&alarm_cache, alarm);
+    set_interrupt_level(l);
+    return 0;
+}
 
-        a_list->head = tmp;
-        a_list->len--;
-        set_interrupt_level(l);
-        return 0;
+//the tick the wheels can skip ahead to from next_tick without passing
+//an alarm or a slot that has to be cascaded, or target if sooner
+static int64_t
+alarm_skip(int64_t target){
+    int64_t skip;
+    int level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++){
+        if (a_list->count[level] > 0){
+            break;
+        }
     }
-    //search for the alarm...
-    while (curr_hd->next != NULL && (alarm_id)(curr_hd->next->alarm) != alarm){
-        curr_hd = curr_hd->next;
+    if (level == 0){
+        return a_list->next_tick;
     }
-    //could not find, alarm was executed previously
-    if (curr_hd->next == NULL){
-        set_interrupt_level(l);
-        return 1;
-    } else {
-        //found the alarm to free, so free it
-        tmp = curr_hd->next->next;
-        free(curr_hd->next->alarm);
-        free(curr_hd->next);
-        curr_hd->next = tmp;
-        a_list->len--;
+    if (level == WHEEL_LEVELS){
+        return target;
+    }
+    //the next time a slot of that wheel is cascaded
+    skip = ((a_list->next_tick >> (WHEEL_BITS * level)) + 1)
+        << (WHEEL_BITS * level);
+    return skip < target ? skip : target;
+}
+
+/* see alarm.h */
+//runs the alarms of every tick up to and including now's that have
+//not gone off yet, so a late call catches up. Each tick only looks at
+//its own slot (and cascades when a finer wheel wraps), and stretches
+//of time with nothing to do are skipped
+int
+run_alarms(uint64_t now){
+    int64_t target;
+    alarm_t due;
+    alarm_t a;
+    int index;
+    int level;
+    int fired = 0;
+    interrupt_level_t l;
+
+    l = set_interrupt_level(DISABLED);
+
+    if (a_list == NULL){
         set_interrupt_level(l);
         return 0;
     }
+
+    target = now / ALARM_TICK;
+    while (a_list->next_tick <= target){
+        a_list->next_tick = alarm_skip(target);
+        index = a_list->next_tick & WHEEL_MASK;
+        if (index == 0){
+            for (level = 1; level < WHEEL_LEVELS; level++){
+                if (alarm_cascade(level) != 0){
+                    break;
+                }
+            }
+        }
+        a_list->next_tick++;
+
+        //take the slot's alarms off the wheel first: the functions
+        //may set and deregister alarms
+        due = a_list->slots[0][index];
+        a_list->slots[0][index] = NULL;
+        if (due != NULL){
+            due->pprev = &due;
+        }
+        while (due != NULL){
+            a = due;
+            alarm_unlink(a);
+            if (a_list->deferred){
+                alarm_defer(a);
+            }
+            else{
+                a_list->stats.inline_fired++;
+                alarm_fire(a, DISABLED);
+            }
+            fired = 1;
+        }
+    }
+
+    //set the alarm timer for the next alarm, unless it already is
+    if (fired || a_list->next_deadline <= now){
+        a_list->next_deadline = alarm_next_deadline();
+        clock_set_alarm(a_list->next_deadline);
+    }
+    set_interrupt_level(l);
+    return a_list->due_len;
 }
 
-//iterates over the alarm list and by comparing
-//with the current system time determins which
-//alarm should be executed. Only iterates over k
-//elements, where k = the number of alarms that should
-//be going off in this round
-void execute_alarms(int sys_time){
-    alarm_node_t curr_hd;
-    alarm_node_t tmp;
+/* see alarm.h */
+int
+alarm_run_due(){
+    uint64_t start;
+    int ran = 0;
+    int left;
+    alarm_t a;
     interrupt_level_t l;
 
     l = set_interrupt_level(DISABLED);
-
     if (a_list == NULL){
         set_interrupt_level(l);
-        return;
+        return 0;
+    }
+    a_list->stats.worker_runs++;
+    start = clock_now();
+    while ((a = a_list->due) != NULL){
+        if (ran == ALARM_BUDGET || clock_now() - start >= ALARM_BUDGET_TIME){
+            a_list->stats.budget_exhausted++;
+            break;
+        }
+        alarm_unlink(a);
+        alarm_fire(a, l);
+        ran++;
     }
+    left = a_list->due_len;
+    set_interrupt_level(l);
+    return left;
+}
 
-    curr_hd = a_list->head;
-    //iterate to find all alarms that need to be executed
-    //free each node and alarm and func/func arg after execution
-    while (curr_hd != NULL && curr_hd->alarm->reg_time +
-                curr_hd->alarm->delay == sys_time){
-        ( (curr_hd->alarm)->alarm_func )( (curr_hd->alarm)->alarm_func_arg);
-        tmp = curr_hd;
-        curr_hd = curr_hd->next;
-        free(tmp->alarm);
-        free(tmp);
-        a_list->len--;
+/* see alarm.h */
+int
+alarm_due_count(){
+    return a_list == NULL ? 0 : a_list->due_len;
+}
+
+/* see alarm.h */
+void
+alarm_set_deferred(int deferred){
+    interrupt_level_t l;
+
+    l = set_interrupt_level(DISABLED);
+    if (a_list != NULL){
+        a_list->deferred = deferred;
     }
-    a_list->head = curr_hd;
     set_interrupt_level(l);
-    return;
+}
+
+/* see alarm.h */
+int
+alarm_get_stats(alarm_stats_t stats){
+    interrupt_level_t l;
+
+    if (a_list == NULL || stats == NULL){
+        return -1;
+    }
+    l = set_interrupt_level(DISABLED);
+    *stats = a_list->stats;
+    set_interrupt_level(l);
+    return 0;
+}
+
+/* see alarm.h */
+void
+alarm_print_stats(){
+    alarm_stats stats;
+    char* bounds[ALARM_LATENCY_BUCKETS] =
+        { "<1us", "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+    int i;
+
+    if (alarm_get_stats(&stats) == -1){
+        return;
+    }
+    printf("alarms run: %ld, %ld by the worker in %ld runs, "
+            "%ld out of budget, %ld most waiting\n",
+            stats.fired, stats.fired - stats.inline_fired, stats.worker_runs,
+            stats.budget_exhausted, stats.max_due);
+    printf("latency: %lu us average, %lu us at worst; longest alarm %lu us\n",
+            (unsigned long)(stats.fired > 0 ?
+                stats.total_latency / stats.fired / MICROSECOND : 0),
+            (unsigned long)(stats.max_latency / MICROSECOND),
+            (unsigned long)(stats.max_run / MICROSECOND));
+    for (i = 0; i < ALARM_LATENCY_BUCKETS; i++){
+        printf("%8s %9ld\n", bounds[i], stats.latency[i]);
+    }
+}
+
+//runs the alarms up to and including clock tick sys_time
+void execute_alarms(int sys_time){
+    run_alarms(boot_time + (uint64_t)sys_time * TIME_QUANTA);
 }
 
 alarm_list_t
 init_alarm(){
-    a_list = (alarm_list_t)malloc(sizeof(alarm_list));
-    a_list->len = 0;
-    a_list->head = NULL;
+    a_list = (alarm_list_t)calloc(1, sizeof(alarm_list));
+    a_list->next_tick = boot_time / ALARM_TICK;
+    a_list->due_tail = &a_list->due;
     return a_list;
 }
 
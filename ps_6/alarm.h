@@ -1,27 +1,75 @@
 #ifndef __ALARM_H__
 #define __ALARM_H__ 1
 
+#include <stdint.h>
+
 /*
  * This is the alarm interface. You should implement the functions for these
  * prototypes, though you may have to modify some other files to do so.
  */
 
 
-/* An alarm_handler_t is a function that will run within the interrupt handler.
- * It must not block, and it must not perform I/O or any other long-running
- * computations.
+/* An alarm_handler_t is a function that will run on the alarm worker, a
+ * kernel thread, with interrupts enabled: it must disable them itself
+ * around the kernel state it touches. It may send packets and set alarms,
+ * but it must not block, since the alarms due after it wait for it.
+ * Before the worker is started it runs within the interrupt handler.
  */
 typedef void (*alarm_handler_t)(void*);
 typedef void *alarm_id;
 
 typedef struct alarm *alarm_t;
-typedef struct alarm_node *alarm_node_t;
 typedef struct alarm_list *alarm_list_t;
 
+#define ALARM_LATENCY_BUCKETS 7
+
+/*
+ * What the alarms have done, for alarm_get_stats. Latency is the time from
+ * an alarm's deadline to its function starting.
+ */
+typedef struct alarm_stats {
+    long fired; //alarm functions run
+    long inline_fired; //run by run_alarms itself, not the worker
+    long worker_runs; //calls to alarm_run_due
+    long budget_exhausted; //times the worker stopped with alarms left
+    long max_due; //most alarms waiting for the worker at once
+    uint64_t total_latency; //nanoseconds, over all of them
+    uint64_t max_latency;
+    uint64_t max_run; //longest an alarm function took, in nanoseconds
+    long latency[ALARM_LATENCY_BUCKETS]; //under 1us, 10us, ... 100ms, and more
+} alarm_stats;
+
+typedef alarm_stats* alarm_stats_t;
+
+/*
+ * returns the number of alarms set that have not gone off.
+ */
 int alarm_list_len(alarm_list_t a_list);
 
 /*
- * wrapper function for setting alarm with system time information.
+ * returns the time the next alarm goes off at, in clock ticks, or -1 if no
+ * alarms are set. Takes time proportional to the number of slots in the
+ * timing wheels, not the number of alarms.
+ */
+int alarm_next_time();
+
+/*
+ * the same, in nanoseconds on the monotonic clock (see clock_now), or 0
+ * if no alarms are set.
+ */
+uint64_t alarm_next_deadline();
+
+/*
+ * set an alarm to go off at time "when" on the monotonic clock, in
+ * nanoseconds. Alarms go off within a millisecond of their time, never
+ * before it, however it compares with the clock ticks. Returns a handle
+ * to the alarm.
+ */
+alarm_id set_alarm_at(uint64_t when, alarm_handler_t func, void *arg);
+
+/*
+ * wrapper function for setting alarm with system time information: it
+ * goes off at clock tick sys_time + delay.
  */
 alarm_id set_alarm(int delay, alarm_handler_t func, void *arg, int sys_time);
 
@@ -31,11 +79,55 @@ alarm_id set_alarm(int delay, alarm_handler_t func, void *arg, int sys_time);
 alarm_id register_alarm(int delay, alarm_handler_t func, void *arg);
 
 /* unregister an alarm.  Returns 0 if the alarm had not been executed, 1
- * otherwise.
+ * otherwise. Takes constant time. The handle of an alarm that has gone off
+ * or been unregistered may be reused by a later alarm.
  */
 int deregister_alarm(alarm_id id);
 
-void execute_alarms();
+/*
+ * sets off the alarms due at or before time "now" on the monotonic clock
+ * that have not gone off yet, including those it was not called in time
+ * for, and sets the alarm timer (see clock_set_alarm) for the next one.
+ * Their functions are run here, unless the worker has been started, in
+ * which case they are put on the due list for it. Returns the number of
+ * alarms on the due list.
+ */
+int run_alarms(uint64_t now);
+
+/*
+ * the same, up to clock tick sys_time.
+ */
+void execute_alarms(int sys_time);
+
+/*
+ * with deferred set, run_alarms leaves the alarms' functions to the worker
+ * (see alarm_run_due) instead of running them itself.
+ */
+void alarm_set_deferred(int deferred);
+
+/*
+ * called by the alarm worker: runs the functions of the alarms on the due
+ * list, oldest first, with interrupts at the caller's level, until the list
+ * is empty or a budget of alarms or time is used up. Returns the number of
+ * alarms still on the due list.
+ */
+int alarm_run_due();
+
+/*
+ * returns the number of alarms on the due list. Call it with interrupts
+ * disabled to know whether the worker can stop.
+ */
+int alarm_due_count();
+
+/*
+ * copies the alarm statistics into stats. Returns 0 (success) or -1 (failure).
+ */
+int alarm_get_stats(alarm_stats_t stats);
+
+/*
+ * prints the alarm statistics.
+ */
+void alarm_print_stats();
 
 alarm_list_t init_alarm();
 
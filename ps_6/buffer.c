@@ -6,6 +6,13 @@
  * synchronization implementations.
  * 
  * Change MAXCOUNT to vary the number of items produced by the producer.
+ *
+ * The buffer is a channel, and each side moves its items as a batch,
+ * so neither has to wait for the other once per item.
+ *
+ * Usage: buffer [count] [handoff]
+ * With handoff set to 1, the side that wakes the other up hands it the
+ * processor (see channel_set_handoff).
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,38 +23,45 @@
 
 #define MAXCOUNT  1000
 
-int buffer[BUFFER_SIZE];
-int size, head, tail;
+channel_t buffer;
+int handoff = 0;
 
-semaphore_t empty;
-semaphore_t full;
+uint64_t start_time;
+long start_switches;
 
 int consumer(int* arg) {
-  int n, i;
+  void* items[BUFFER_SIZE];
+  int n, i, got;
   int out = 0;
 
   while (out < *arg) {
     n = genintrand(BUFFER_SIZE);
     n = (n <= *arg - out) ? n : *arg - out;
     printf("Consumer wants to get %d items out of buffer ...\n", n);
-    for (i=0; i<n; i++) {
-      semaphore_P(empty);
-      out = buffer[tail];
-      printf("Consumer is taking %d out of buffer.\n", out);
-      tail = (tail + 1) % BUFFER_SIZE;
-      size--;
-      semaphore_V(full);
+    while (n > 0) {
+      got = channel_receive_batch(buffer, items, n);
+      for (i=0; i<got; i++) {
+        out = (int) (long) items[i];
+        printf("Consumer is taking %d out of buffer.\n", out);
+      }
+      n -= got;
     }
   }
 
-
+  printf("%d items in %lu ms, %.2f context switches per item, handoff %s\n",
+      *arg, (unsigned long)((minithread_time_ns() - start_time) / 1000000),
+      (double)(minithread_context_switches() - start_switches) / *arg,
+      handoff ? "on" : "off");
   return 0;
 }
 
 int producer(int* arg) {
+  void* items[BUFFER_SIZE];
   int count = 1;
   int n, i;
 
+  start_time = minithread_time_ns();
+  start_switches = minithread_context_switches();
   minithread_fork(consumer, arg);
 
   minithread_yield();
@@ -57,13 +71,10 @@ int producer(int* arg) {
     n = (n <= *arg - count + 1) ? n : *arg - count + 1;
     printf("Producer wants to put %d items into buffer ...\n", n);
     for (i=0; i<n; i++) {
-      semaphore_P(full);
       printf("Producer is putting %d into buffer.\n", count);
-      buffer[head] = count++;
-      head = (head + 1) % BUFFER_SIZE;
-      size++;
-      semaphore_V(empty);
+      items[i] = (void *) (long) count++;
     }
+    channel_send_batch(buffer, items, n);
   }
 
   return 0;
@@ -72,12 +83,15 @@ int producer(int* arg) {
 int
 main(int argc, char * argv[]) {
   int maxcount = MAXCOUNT;
-  
-  size = head = tail = 0;
-  empty = semaphore_create();
-  semaphore_initialize(empty, 0);
-  full = semaphore_create();
-  semaphore_initialize(full, BUFFER_SIZE);
+
+  if (argc > 1) {
+    maxcount = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    handoff = atoi(argv[2]);
+  }
+  buffer = channel_create(BUFFER_SIZE);
+  channel_set_handoff(buffer, handoff);
 
   minithread_system_initialize(producer, &maxcount);
   return -1;
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "defs.h"
 #include "disk.h"
@@ -30,6 +33,7 @@ void start_disk_poll(disk_t* disk); /* forward declaration */
 int disk_send_request(disk_t* disk, int blocknum, char* buffer,
         disk_request_type_t type){
     disk_queue_elem_t* saved_last=NULL;
+    uint64_t one = 1;
     disk_queue_elem_t* disk_request
         = (disk_queue_elem_t*) malloc(sizeof(disk_queue_elem_t));
 
@@ -61,7 +65,7 @@ int disk_send_request(disk_t* disk, int blocknum, char* buffer,
     }
 
     /* signal the task that simulates the disk */
-    if (sem_post(&disk->semaphore)){
+    if (write(disk->event, &one, sizeof(one)) != sizeof(one)){
         kprintf("You have exceeded the maximum number of requests pending.\n");
 
         /* undo changes made to the request queue */
@@ -191,244 +195,230 @@ disk_write_block(disk_t* disk, int blocknum, char* buffer) {
 }
 
 
-/* handle read and write to disk. Watch the job queue and
-   submit the requests to the operating system one by one.
+/* handle read and write to disk. Take the requests off the job
+   queue and submit them to the operating system one by one.
    On completion, the user suplied function with the user
    suplied parameter is called
 
    The interrupt mechanism is used much like in the network
-   case. One such process per disk.
+   case. The I/O thread calls disk_poll when the disk's eventfd
+   says requests have been queued.
 
-   The argument is a disk_t with the disk description.
+   disk_serve handles one request. It returns 0, or -1 if the queue
+   was empty or the disk was shut down.
  */
-void disk_poll(void* arg) {
-    enum { DISK_OK, DISK_CRASHED } disk_state;
-
-    disk_t* disk = (disk_t*) arg;
+static int disk_serve(disk_t* disk) {
     disk_layout_t layout;
 
     disk_interrupt_arg_t* disk_interrupt;
     disk_queue_elem_t* disk_request;
 
-    disk_state=DISK_OK;
+    int blocknum;
+    char* buffer;
+    disk_request_type_t type;
+    int offset;
+
+    /* We use mutex to protect queue handling, as should
+       the code that inserts requests in the queue
+     */
+
+    if (DEBUG)
+        kprintf("Disk Controler: got a request.\n");
 
-    for (;;){
-        int blocknum;
-        char* buffer;
-        disk_request_type_t type;
-        int offset;
+    /* get exclusive access to queue handling  and dequeue a request */
+    pthread_mutex_lock(&disk_mutex);
+
+    layout = disk->layout; /* this is the layout used until the request is fulfilled */
+    /* this is safe since a disk can only grow */
 
-        /* We use mutex to protect queue handling, as should
-           the code that inserts requests in the queue
+    if (disk->queue != NULL){
+        disk_interrupt = (disk_interrupt_arg_t*)
+            malloc(sizeof(disk_interrupt_arg_t));
+        assert( disk_interrupt != NULL);
+
+        disk_interrupt->disk = disk;
+        /* we look first at the first request in the queue
+           to see if it is special.
          */
+        disk_interrupt->request =
+            disk->queue->request;
 
-        /* wait for somebody to put something in the queue */
-        sem_wait(&disk->semaphore);
+        /* check if we shut down the disk */
+        if (disk->queue->request.type == DISK_SHUTDOWN){
+            if (DEBUG)
+                kprintf("Disk: Shutting down.\n");
 
-        if (DEBUG)
-            kprintf("Disk Controler: got a request.\n");
-
-        /* get exclusive access to queue handling  and dequeue a request */
-        pthread_mutex_lock(&disk_mutex);
-
-        layout = disk->layout; /* this is the layout used until the request is fulfilled */
-        /* this is safe since a disk can only grow */
-
-        if (disk->queue != NULL){
-            disk_interrupt = (disk_interrupt_arg_t*)
-                malloc(sizeof(disk_interrupt_arg_t));
-            assert( disk_interrupt != NULL);
-
-            disk_interrupt->disk = disk;
-            /* we look first at the first request in the queue
-               to see if it is special.
-             */
-            disk_interrupt->request =
-                disk->queue->request;
-
-            /* check if we shut down the disk */
-            if (disk->queue->request.type == DISK_SHUTDOWN){
-                if (DEBUG)
-                    kprintf("Disk: Shutting down.\n");
-
-                disk_interrupt->reply=DISK_REPLY_OK;
-                fclose(disk->file);
-                pthread_mutex_unlock(&disk_mutex);
-                sem_destroy(&disk->semaphore);
-                send_interrupt(DISK_INTERRUPT_TYPE, mini_disk_handler, (void*)disk_interrupt);
-                break; /* end the disk task */
-            }
+            disk_interrupt->reply=DISK_REPLY_OK;
+            fclose(disk->file);
+            pthread_mutex_unlock(&disk_mutex);
+            interrupt_remove_source(disk->event);
+            close(disk->event);
+            send_interrupt(DISK_INTERRUPT_TYPE, mini_disk_handler, (void*)disk_interrupt);
+            return -1; /* end the disk task */
+        }
 
-            /* check if we got to reset the disk */
-            if (disk->queue->request.type == DISK_RESET){
-                disk_queue_elem_t* curr;
-                disk_queue_elem_t *next;
-
-                if (DEBUG)
-                    kprintf("Disk: Resetting.\n");
-
-                disk_interrupt->reply=DISK_REPLY_OK;
-                /* empty the queue */
-                curr=disk->queue;
-                while (curr!=NULL){
-                    next=curr->next;
-                    free(curr);
-                    curr=next;
-                }
-                disk->queue = disk->last = NULL;
-
-                disk_state = DISK_OK;
-                pthread_mutex_unlock(&disk_mutex);
-                goto sendinterrupt;
-            }
+        /* check if we got to reset the disk */
+        if (disk->queue->request.type == DISK_RESET){
+            disk_queue_elem_t* curr;
+            disk_queue_elem_t *next;
 
-            /* permute the first two elements in the queue
-               probabilistically if queue has two elements
-             */
-            if (disk->queue->next !=NULL &&
-                    (genrand() < reordering_rate)){
-                //kprintf("Disk: swapping.\n");
-                disk_queue_elem_t* first = disk->queue;
-                disk_queue_elem_t* second = first->next;
-                first->next = second->next;
-                second->next = first;
-                disk->queue = second;
-                if (disk->last == second)
-                    disk->last = first;
+            if (DEBUG)
+                kprintf("Disk: Resetting.\n");
+
+            disk_interrupt->reply=DISK_REPLY_OK;
+            /* empty the queue */
+            curr=disk->queue;
+            while (curr!=NULL){
+                next=curr->next;
+                free(curr);
+                curr=next;
             }
+            disk->queue = disk->last = NULL;
 
-            /* dequeue the first request */
-            disk_request = disk->queue;
-            disk->queue = disk_request->next;
-            if (disk->queue == NULL)
-                disk->last = NULL;
-        } else {
-            /* empty queue, release the lock and leave */
+            disk->crashed = 0;
             pthread_mutex_unlock(&disk_mutex);
-            break;
+            goto sendinterrupt;
+        }
+
+        /* permute the first two elements in the queue
+           probabilistically if queue has two elements
+         */
+        if (disk->queue->next !=NULL &&
+                (genrand() < reordering_rate)){
+            //kprintf("Disk: swapping.\n");
+            disk_queue_elem_t* first = disk->queue;
+            disk_queue_elem_t* second = first->next;
+            first->next = second->next;
+            second->next = first;
+            disk->queue = second;
+            if (disk->last == second)
+                disk->last = first;
         }
 
+        /* dequeue the first request */
+        disk_request = disk->queue;
+        disk->queue = disk_request->next;
+        if (disk->queue == NULL)
+            disk->last = NULL;
+    } else {
+        /* empty queue, release the lock and leave */
         pthread_mutex_unlock(&disk_mutex);
+        return -1;
+    }
 
-        disk_interrupt->request = disk_request->request;
+    pthread_mutex_unlock(&disk_mutex);
 
-        /* crash the disk ocasionally */
-        if (genrand() < crash_rate){
-            disk_state = DISK_CRASHED;
+    disk_interrupt->request = disk_request->request;
 
-            /*      if (DEBUG) */
-            kprintf("Disk: Crashing disk.\n");
+    /* crash the disk ocasionally */
+    if (genrand() < crash_rate){
+        disk->crashed = 1;
 
-        }
+        /*      if (DEBUG) */
+        kprintf("Disk: Crashing disk.\n");
 
-        /* check if disk crashed */
-        if (disk_state == DISK_CRASHED){
-            disk_interrupt->reply=DISK_REPLY_CRASHED;
-            goto sendinterrupt;
-        }
+    }
 
-        if ( genrand() < failure_rate ) {
-            /* Trash the request */
-            disk_interrupt->reply = DISK_REPLY_FAILED;
+    /* check if disk crashed */
+    if (disk->crashed){
+        disk_interrupt->reply=DISK_REPLY_CRASHED;
+        goto sendinterrupt;
+    }
 
-            if (DEBUG)
-                kprintf("Disk: Request failed.\n");
+    if ( genrand() < failure_rate ) {
+        /* Trash the request */
+        disk_interrupt->reply = DISK_REPLY_FAILED;
 
-            goto sendinterrupt;
-        }
+        if (DEBUG)
+            kprintf("Disk: Request failed.\n");
 
-        /* Check validity of request */
+        goto sendinterrupt;
+    }
 
-        disk_interrupt->reply = DISK_REPLY_OK;
+    /* Check validity of request */
 
-        blocknum = disk_request->request.blocknum;
-        buffer = disk_request->request.buffer;
-        type = disk_request->request.type;
+    disk_interrupt->reply = DISK_REPLY_OK;
 
-        if (DEBUG)
-            kprintf("Disk Controler: got a request for block %d type %d .\n",
-                    blocknum, type);
+    blocknum = disk_request->request.blocknum;
+    buffer = disk_request->request.buffer;
+    type = disk_request->request.type;
 
-        /* If we got here is a read or a write request */
+    if (DEBUG)
+        kprintf("Disk Controler: got a request for block %d type %d .\n",
+                blocknum, type);
 
-        offset = DISK_BLOCK_SIZE*(blocknum + 1);
+    /* If we got here is a read or a write request */
 
-        if ( (blocknum >= layout.size) ||
-                (fseek(disk->file, offset, SEEK_SET) != 0) ) {
-            disk_interrupt->reply = DISK_REPLY_ERROR;
+    offset = DISK_BLOCK_SIZE*(blocknum + 1);
 
-            if (DEBUG)
-                kprintf("Disk Controler: Block too big or failed fseek, block=%d,  offset=%d, disk_size=%d.\n",
-                        blocknum, offset, layout.size);
+    if ( (blocknum >= layout.size) ||
+            (fseek(disk->file, offset, SEEK_SET) != 0) ) {
+        disk_interrupt->reply = DISK_REPLY_ERROR;
 
-            goto sendinterrupt;
-        }
+        if (DEBUG)
+            kprintf("Disk Controler: Block too big or failed fseek, block=%d,  offset=%d, disk_size=%d.\n",
+                    blocknum, offset, layout.size);
 
-        switch (type) {
-            case DISK_READ:
-                if (fread(buffer, 1, DISK_BLOCK_SIZE, disk->file)
-                        < DISK_BLOCK_SIZE)
-                    disk_interrupt->reply = DISK_REPLY_ERROR;
-                if (DEBUG)
-                    kprintf("Disk: Read request.\n");
-
-                break;
-            case DISK_WRITE:
-                if (fwrite(buffer, 1, DISK_BLOCK_SIZE, disk->file)
-                        < DISK_BLOCK_SIZE)
-                    disk_interrupt->reply = DISK_REPLY_ERROR;
-                fflush(disk->file);
-                if (DEBUG)
-                    kprintf("Disk: Write request.\n");
-
-                break;
-            default:
-                break;
-        }
+        goto sendinterrupt;
+    }
 
-sendinterrupt:
-        if (DEBUG)
-            kprintf("Disk Controler: sending an interrupt for block %d, request type %d, with reply %d.\n",
-                    disk_interrupt->request.blocknum,
-                    disk_interrupt->request.type,
-                    disk_interrupt->reply);
+    switch (type) {
+        case DISK_READ:
+            if (fread(buffer, 1, DISK_BLOCK_SIZE, disk->file)
+                    < DISK_BLOCK_SIZE)
+                disk_interrupt->reply = DISK_REPLY_ERROR;
+            if (DEBUG)
+                kprintf("Disk: Read request.\n");
 
-        send_interrupt(DISK_INTERRUPT_TYPE, mini_disk_handler, (void*)disk_interrupt);
+            break;
+        case DISK_WRITE:
+            if (fwrite(buffer, 1, DISK_BLOCK_SIZE, disk->file)
+                    < DISK_BLOCK_SIZE)
+                disk_interrupt->reply = DISK_REPLY_ERROR;
+            fflush(disk->file);
+            if (DEBUG)
+                kprintf("Disk: Write request.\n");
+
+            break;
+        default:
+            break;
     }
 
+sendinterrupt:
+    if (DEBUG)
+        kprintf("Disk Controler: sending an interrupt for block %d, request type %d, with reply %d.\n",
+                disk_interrupt->request.blocknum,
+                disk_interrupt->request.type,
+                disk_interrupt->reply);
+
+    send_interrupt(DISK_INTERRUPT_TYPE, mini_disk_handler, (void*)disk_interrupt);
+    return 0;
 }
 
-void start_disk_poll(disk_t* disk){
-    //int id;
-    pthread_t disk_thread;
-    sigset_t set;
-    struct sigaction sa;
-    sigset_t old_set;
-    sigemptyset(&set);
-    sigaddset(&set,SIGRTMAX-1);
-    sigaddset(&set,SIGRTMAX-2);
-    sigprocmask(SIG_BLOCK,&set,&old_set);
-
-    sa.sa_handler = (void*)handle_interrupt;
-    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
-    sa.sa_sigaction= (void*)handle_interrupt;
-    sigemptyset(&sa.sa_mask);
-    sigaddset(&sa.sa_mask,SIGRTMAX-2);
-    sigaddset(&sa.sa_mask,SIGRTMAX-1);
-    if (sigaction(SIGRTMAX-2, &sa, NULL) == -1)
-        AbortOnError(0);
+static void disk_poll(int fd, void* arg) {
+    disk_t* disk = (disk_t*) arg;
+    uint64_t count;
 
+    /* how many requests have been queued since the last time */
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return;
+    while (count-- > 0) {
+        if (disk_serve(disk) == -1)
+            break;
+    }
+}
 
+void start_disk_poll(disk_t* disk){
     /* reset the request queue */
     disk->queue = disk->last = NULL;
+    disk->crashed = 0;
 
-    /* create request semaphore */
-    AbortOnCondition(sem_init(&disk->semaphore, 0, 0),"sem_init");
-
-    AbortOnCondition(pthread_create(&disk_thread, NULL, (void*)disk_poll, (void*)disk),
-      "pthread");
+    /* create the request eventfd */
+    disk->event = eventfd(0, EFD_NONBLOCK);
+    AbortOnCondition(disk->event == -1, "eventfd");
 
-    pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+    AbortOnCondition(interrupt_add_source(disk->event, disk_poll, (void*)disk) == -1,
+      "epoll_ctl");
 }
 
 void install_disk_handler(interrupt_handler_t disk_handler){
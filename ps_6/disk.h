@@ -9,7 +9,6 @@
 /* get the correct version of Linux recognized */
 #include <stdio.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include "defs.h"
 #include "interrupts.h"
 
@@ -80,7 +79,8 @@ typedef struct {
   FILE* file;
   disk_queue_elem_t* queue;
   disk_queue_elem_t* last;
-  sem_t semaphore; /* the semaphore should be signaled when something is added to the queue */
+  int event; /* eventfd, written to when something is added to the queue */
+  int crashed; /* the disk has crashed and fails every request until reset */
 } disk_t;
 
 /* structure used to pass arguments through interrupts */
@@ -0,0 +1,71 @@
+/* fork_bench.c
+   Measures how fast threads can be forked and reaped.
+   Usage: fork_bench [forks]
+   Runs two patterns: forking one thread at a time and waiting for it
+   to exit (the way sieve.c adds a filter per prime), and forking a
+   batch of threads and then waiting for all of them.
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_FORKS 100000
+#define BATCH 100
+
+int forks = DEFAULT_FORKS;
+semaphore_t done;
+
+int
+child(int* arg) {
+  semaphore_V(done);
+  return 0;
+}
+
+void
+report(char* pattern, uint64_t start) {
+  uint64_t elapsed = currentTimeMillis() - start;
+
+  if (elapsed == 0) elapsed = 1;
+  printf("%-10s %d forks in %lu ms: %lu forks/sec\n", pattern, forks,
+      (unsigned long)elapsed, (unsigned long)(forks * 1000ULL / elapsed));
+}
+
+int
+run_fork_bench(int* arg) {
+  int i;
+  int j;
+  uint64_t start;
+
+  start = currentTimeMillis();
+  for (i = 0; i < forks; i++) {
+    minithread_fork(child, NULL);
+    semaphore_P(done);
+  }
+  report("one-by-one", start);
+
+  start = currentTimeMillis();
+  for (i = 0; i < forks; i += BATCH) {
+    for (j = 0; j < BATCH; j++) {
+      minithread_fork(child, NULL);
+    }
+    for (j = 0; j < BATCH; j++) {
+      semaphore_P(done);
+    }
+  }
+  report("batch", start);
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    forks = atoi(argv[1]);
+  }
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_fork_bench, NULL);
+  return 0;
+}
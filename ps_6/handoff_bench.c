@@ -0,0 +1,293 @@
+/* handoff_bench.c
+   Measures what semaphore handoff (semaphore_set_handoff) does to
+   producer/consumer pipelines, with handoff off and then on.
+   Usage: handoff_bench [max prime] [items] [processors]
+   sieve: a sieve pipeline like sieve.c's, but passing each number
+   through a pair of semaphores, finding the primes up to max prime.
+   buffer: a bounded buffer of semaphores like buffer.c's, passing
+   items from producer to consumer, timing each item from put to take. wakeup: a
+   thread wakes another and carries on computing, while a third thread
+   is busy, timing each wakeup from the V to the woken thread running.
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_MAX 20000
+#define DEFAULT_ITEMS 200000
+#define BUFFER_SIZE 16
+#define WAKEUPS 10
+#define WORK_NS (2 * 1000000) //what the waker does after each V
+
+typedef struct {
+  int value;
+  semaphore_t produce;
+  semaphore_t consume;
+} pipe_t;
+
+typedef struct {
+  pipe_t* left;
+  pipe_t* right;
+  int prime;
+} filter_t;
+
+int max = DEFAULT_MAX;
+int items = DEFAULT_ITEMS;
+int num_procs = 1;
+int handoff = 0;
+semaphore_t done;
+
+uint64_t buffer[BUFFER_SIZE];
+int head, tail;
+semaphore_t empty;
+semaphore_t full;
+uint64_t total_latency;
+uint64_t max_latency;
+
+semaphore_t wake;
+semaphore_t woken;
+volatile uint64_t woke_at;
+volatile int busy;
+
+void
+latency(uint64_t since) {
+  uint64_t l = minithread_time_ns() - since;
+
+  total_latency += l;
+  if (l > max_latency) max_latency = l;
+}
+
+/* SIEVE */
+
+pipe_t*
+pipe_new() {
+  pipe_t* c = (pipe_t*)malloc(sizeof(pipe_t));
+
+  c->produce = semaphore_create();
+  semaphore_initialize(c->produce, 0);
+  semaphore_set_handoff(c->produce, handoff);
+  c->consume = semaphore_create();
+  semaphore_initialize(c->consume, 0);
+  semaphore_set_handoff(c->consume, handoff);
+  return c;
+}
+
+int
+source(int* arg) {
+  pipe_t* c = (pipe_t*)arg;
+  int i;
+
+  for (i = 2; i <= max; i++) {
+    c->value = i;
+    semaphore_V(c->consume);
+    semaphore_P(c->produce);
+  }
+  c->value = -1;
+  semaphore_V(c->consume);
+  return 0;
+}
+
+int
+filter(int* arg) {
+  filter_t* f = (filter_t*)arg;
+  int value;
+
+  do {
+    semaphore_P(f->left->consume);
+    value = f->left->value;
+    semaphore_V(f->left->produce);
+    if (value == -1 || value % f->prime != 0) {
+      f->right->value = value;
+      semaphore_V(f->right->consume);
+      semaphore_P(f->right->produce);
+    }
+  } while (value != -1);
+  return 0;
+}
+
+int
+sink(int* arg) {
+  pipe_t* p = pipe_new();
+  filter_t* f;
+  minithread_attr attr;
+
+  minithread_attr_init(&attr);
+  attr.stack_size = MIN_STACKSIZE;
+  attr.guard_size = 0;
+
+  minithread_fork(source, (int*)p);
+  while (1) {
+    semaphore_P(p->consume);
+    *arg = p->value;
+    semaphore_V(p->produce);
+    if (*arg == -1) break;
+
+    f = (filter_t*)malloc(sizeof(filter_t));
+    f->left = p;
+    f->prime = *arg;
+    p = pipe_new();
+    f->right = p;
+    minithread_fork_ex(filter, (int*)f, &attr);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+void
+bench_sieve() {
+  uint64_t start = minithread_time_ns();
+  long switches = minithread_context_switches();
+  uint64_t elapsed;
+  int last;
+
+  minithread_fork(sink, &last);
+  semaphore_P(done);
+  elapsed = minithread_time_ns() - start;
+  switches = minithread_context_switches() - switches;
+  printf("sieve to %d, handoff %-3s %10.1f ms %10.0f numbers/s %6.2f switches/number\n",
+      max, handoff ? "on" : "off", elapsed / 1e6, (max - 1) / (elapsed / 1e9),
+      (double)switches / (max - 1));
+}
+
+/* BOUNDED BUFFER */
+
+int
+consumer(int* arg) {
+  int i;
+
+  for (i = 0; i < items; i++) {
+    semaphore_P(empty);
+    latency(buffer[tail]);
+    tail = (tail + 1) % BUFFER_SIZE;
+    semaphore_V(full);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+producer(int* arg) {
+  int i;
+
+  for (i = 0; i < items; i++) {
+    semaphore_P(full);
+    buffer[head] = minithread_time_ns();
+    head = (head + 1) % BUFFER_SIZE;
+    semaphore_V(empty);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+void
+bench_buffer() {
+  uint64_t start = minithread_time_ns();
+  long switches = minithread_context_switches();
+  uint64_t elapsed;
+
+  head = tail = 0;
+  total_latency = max_latency = 0;
+  semaphore_initialize(empty, 0);
+  semaphore_initialize(full, BUFFER_SIZE);
+  semaphore_set_handoff(empty, handoff);
+  semaphore_set_handoff(full, handoff);
+  minithread_fork(consumer, NULL);
+  minithread_fork(producer, NULL);
+  semaphore_P(done);
+  semaphore_P(done);
+  elapsed = minithread_time_ns() - start;
+  switches = minithread_context_switches() - switches;
+  printf("buffer, handoff %-3s %10.0f items/s, put to take %8.1f us mean %10.1f us max"
+      " %6.2f switches/item\n", handoff ? "on" : "off", items / (elapsed / 1e9),
+      total_latency / 1e3 / items, max_latency / 1e3, (double)switches / items);
+}
+
+/* WAKEUP */
+
+int
+spinner(int* arg) {
+  while (busy);
+  semaphore_V(done);
+  return 0;
+}
+
+int
+sleeper(int* arg) {
+  int i;
+
+  for (i = 0; i < WAKEUPS; i++) {
+    semaphore_P(wake);
+    woke_at = minithread_time_ns();
+    semaphore_V(woken);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+void
+bench_wakeup() {
+  uint64_t at;
+  int i;
+
+  total_latency = max_latency = 0;
+  semaphore_set_handoff(wake, handoff);
+  busy = 1;
+  minithread_fork(spinner, NULL);
+  minithread_fork(sleeper, NULL);
+  minithread_yield();
+  for (i = 0; i < WAKEUPS; i++) {
+    at = minithread_time_ns();
+    semaphore_V(wake);
+    while (minithread_time_ns() - at < WORK_NS);
+    semaphore_P(woken);
+    total_latency += woke_at - at;
+    if (woke_at - at > max_latency) max_latency = woke_at - at;
+  }
+  busy = 0;
+  semaphore_P(done);
+  semaphore_P(done);
+  printf("wakeup, handoff %-3s %10.1f us mean %10.1f us max\n",
+      handoff ? "on" : "off", total_latency / 1e3 / WAKEUPS, max_latency / 1e3);
+}
+
+int
+run_handoff_bench(int* arg) {
+  printf("%d processors\n", num_procs);
+  for (handoff = 0; handoff <= 1; handoff++) {
+    bench_sieve();
+  }
+  for (handoff = 0; handoff <= 1; handoff++) {
+    bench_buffer();
+  }
+  for (handoff = 0; handoff <= 1; handoff++) {
+    bench_wakeup();
+  }
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    max = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    items = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    num_procs = atoi(argv[3]);
+  }
+  minithread_set_processors(num_procs);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  empty = semaphore_create();
+  full = semaphore_create();
+  wake = semaphore_create();
+  semaphore_initialize(wake, 0);
+  woken = semaphore_create();
+  semaphore_initialize(woken, 0);
+  minithread_system_initialize(run_handoff_bench, NULL);
+  return 0;
+}
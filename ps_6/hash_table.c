@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "miniroute.h"
 #include "interrupts.h"
+#include "slab.h"
 
 #define INITIAL_CAPACITY 64
  
@@ -22,6 +23,8 @@ struct hash_table {
   int threshold_shrink;
 };
 
+static slab_cache node_cache = SLAB_CACHE_INIT("hash table node", struct ht_node);
+
 /* Return an empty hash_table.  Returns NULL on error.
  */
 hash_table_t hash_table_create() {
@@ -139,7 +142,7 @@ int hash_table_add(hash_table_t ht, network_address_t key, void* val) {
     } 
   }
 
-  new_node = (ht_node_t)malloc(sizeof(struct ht_node));
+  new_node = (ht_node_t)slab_alloc(&node_cache);
   if (new_node == NULL) {
     return -1;
   }
@@ -232,7 +235,7 @@ int hash_table_destroy(hash_table_t ht) {
       while (curr != NULL) {
         temp = curr;
         curr = curr->next;
-        free(temp);
+        slab_free(&node_cache, temp);
       } 
     } 
   }
@@ -288,7 +291,7 @@ void* hash_table_remove(hash_table_t ht, network_address_t key) {
     if (network_compare_network_addresses(curr->key, key)) { // found it
       val = curr->val;
       ht->array[idx] = curr->next;
-      free(curr);
+      slab_free(&node_cache, curr);
       ht->size--; 
       return val;
     }
@@ -297,7 +300,7 @@ void* hash_table_remove(hash_table_t ht, network_address_t key) {
         val = curr->next->val;
         temp = curr->next;
         curr->next = curr->next->next;
-        free(temp);
+        slab_free(&node_cache, temp);
         ht->size--; 
         return val;
       }
@@ -0,0 +1,45 @@
+/* interrupt_bench.c
+   Measures how many device interrupts per second reach their handlers,
+   by reading lines from stdin: each line is one read interrupt.
+   Usage: yes | head -n 200000 | interrupt_bench [lines]
+*/
+#include "minithread.h"
+#include "read.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_LINES 200000
+#define LINE_LENGTH 64
+
+int lines = DEFAULT_LINES;
+
+int
+run_interrupt_bench(int* arg) {
+  char buffer[LINE_LENGTH];
+  uint64_t start;
+  uint64_t elapsed;
+  int i;
+
+  // the first line starts the clock, once the reader is going
+  miniterm_read(buffer, LINE_LENGTH);
+  start = currentTimeMillis();
+  for (i = 1; i < lines; i++) {
+    miniterm_read(buffer, LINE_LENGTH);
+  }
+  elapsed = currentTimeMillis() - start;
+  if (elapsed == 0) elapsed = 1;
+  printf("%d read interrupts in %lu ms: %lu interrupts/sec\n", lines,
+      (unsigned long)elapsed, (unsigned long)(lines * 1000ULL / elapsed));
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    lines = atoi(argv[1]);
+  }
+  minithread_system_initialize(run_interrupt_bench, NULL);
+  return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* CPU_SET, pthread_setaffinity_np */
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
@@ -7,7 +8,10 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <ucontext.h>
-#include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include "defs.h"
 #include "interrupts.h"
 #include "interrupts_private.h"
@@ -24,7 +28,10 @@
 #define ENABLED 1
 #define DISABLED 0
 
-interrupt_level_t interrupt_level;
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
 long ticks;
 extern int start();
 extern int end();
@@ -32,17 +39,83 @@ extern int end();
 /*
  * Virtual processor interrupt level (spl).
  * Are interrupts enabled? A new interrupt will only be taken when interrupts
- * are enabled.
+ * are enabled. Each processor has its own.
+ */
+__thread interrupt_level_t interrupt_level = DISABLED;
+
+/*
+ * Held by whichever processor has interrupts disabled. The first processor
+ * starts out with interrupts disabled, so it starts out holding the lock.
+ */
+tas_lock_t kernel_lock = 1;
+
+/*
+ * The calling processor's clock, and the period its interrupts come
+ * at when it is not idle.
  */
-interrupt_level_t interrupt_level;
+static __thread timer_t clock_timer;
+static int clock_period;
 
-typedef struct interrupt_t interrupt_t;
-struct interrupt_t {
-  interrupt_handler_t handler;
-  void *arg;
-};
+/*
+ * The first processor's alarm timer, which goes off once at the deadline
+ * clock_set_alarm last gave it, and the deadline (0 if none).
+ */
+#define ALARM_RETRY_DELAY (50 * MICROSECOND)
+static timer_t alarm_timer;
+static int alarm_timer_made;
+static volatile uint64_t alarm_when;
+
+/*
+ * Device interrupts wait in this ring between the device thread that
+ * sends them and the processor that runs their handlers. Device threads
+ * push without locks and without waiting for the handler, and only the
+ * first interrupt since the ring was last drained sends a signal; the
+ * processor that takes it runs every handler waiting.
+ *
+ * Position pos uses slot pos % EVENT_RING_SIZE. The slot is free for it
+ * when its stamp is pos's lap (pos - pos % EVENT_RING_SIZE) and holds
+ * its event when the stamp is one more, so a zeroed ring is empty. Only
+ * a processor holding the kernel lock pops.
+ */
+#define EVENT_RING_SIZE 1024
+#define EVENT_RETRY_DELAY (50 * MICROSECOND)
 
-static pthread_mutex_t signal_mutex;
+typedef struct interrupt_event {
+    volatile uint64_t stamp;
+    interrupt_handler_t handler;
+    void *arg;
+} interrupt_event;
+
+static interrupt_event event_ring[EVENT_RING_SIZE];
+static volatile uint64_t event_head; /* next position to push at */
+static uint64_t event_tail; /* next position to pop at */
+static volatile int event_signalled; /* a signal is on its way, or owed */
+
+/*
+ * Takes SIGRTMAX-2 again on the calling processor when it could not run
+ * the handlers the first time.
+ */
+static __thread timer_t retry_timer;
+static __thread int retry_timer_made;
+
+/*
+ * The devices' file descriptors, which the I/O thread waits on together.
+ */
+typedef struct interrupt_source {
+    int fd;
+    device_poll_t poll;
+    void *arg;
+    struct interrupt_source *next;
+} interrupt_source;
+
+static int io_epoll = -1;
+static int io_cpu = -1;
+static interrupt_source *io_sources;
+static pthread_mutex_t io_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t io_once = PTHREAD_ONCE_INIT;
+
+static void interrupt_retry();
+static void interrupt_drain(void *arg);
 
 #define R8 0
 #define R9 1
@@ -69,42 +142,58 @@ interrupt_handler_t mini_clock_handler;
 interrupt_handler_t mini_network_handler;
 interrupt_handler_t mini_read_handler;
 interrupt_handler_t mini_disk_handler;
+interrupt_handler_t mini_drain_handler = NULL;
 
-static volatile int signal_handled = 0;
 
-sem_t interrupt_received_sema;
+static void
+kernel_lock_acquire() {
+    while (atomic_test_and_set(&kernel_lock))
+        sched_yield();
+}
 
 /*
  * atomically sets interrupt level and returns the original
- * interrupt level
+ * interrupt level. Going from ENABLED to DISABLED takes the
+ * kernel lock and going back drops it; the level is always
+ * changed first on the way down and last on the way up, so an
+ * interrupt never finds the lock held by its own processor.
  */
 interrupt_level_t set_interrupt_level(interrupt_level_t newlevel) {
-    return swap(&interrupt_level, newlevel);
-}
+    interrupt_level_t oldlevel;
 
+    if (newlevel == DISABLED) {
+        /*
+         * already disabled: nothing can run on this processor or move
+         * this thread off it, so the plain read is safe and spares the
+         * swap on the many nested calls.
+         */
+        if (interrupt_level == DISABLED)
+            return DISABLED;
+        oldlevel = swap_interrupt_level(DISABLED);
+        if (oldlevel == ENABLED)
+            kernel_lock_acquire();
+    }
+    else {
+        oldlevel = interrupt_level;
+        if (oldlevel == DISABLED) {
+            atomic_clear(&kernel_lock);
+            swap_interrupt_level(ENABLED);
+        }
+    }
+    return oldlevel;
+}
 
 /*
- * Register the minithread clock handler by making
- * mini_clock_handler point to it.
- *
- * Then set the signal handler for SIGRTMAX-1 to
- * handle_interrupt.  This signal handler will either
- * interrupt the minithreads, or drop the interrupt,
- * depending on safety conditions.
- *
- * The signals are handled on their own stack to reduce
- * chances of an overrun.
+ * Start the clock of the calling processor: a timer on the
+ * monotonic clock, delivered to it alone, and a stack to take
+ * the signals on. The monotonic clock keeps running while the
+ * processor sleeps in interrupt_wait.
  */
-void
-minithread_clock_init(int period, interrupt_handler_t clock_handler){
-    timer_t timerid;
+static void
+start_processor_clock(int period) {
     struct sigevent sev;
     struct itimerspec its;
-    struct sigaction sa;
     stack_t ss;
-    mini_clock_handler = clock_handler;
-
-    sem_init(&interrupt_received_sema,0,0);
 
     ss.ss_sp = malloc(SIGSTKSZ);
     if (ss.ss_sp == NULL){
@@ -118,6 +207,157 @@ minithread_clock_init(int period, interrupt_handler_t clock_handler){
         abort();
     }
 
+    /* Create the timer */
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    sev.sigev_signo = SIGRTMAX-1;
+    sev.sigev_value.sival_ptr = &clock_timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &clock_timer) == -1)
+        errExit("timer_create");
+
+    /* Start the timer */
+    its.it_value.tv_sec = (period) / 1000000000;
+    its.it_value.tv_nsec = (period) % 1000000000;
+    its.it_interval.tv_sec = its.it_value.tv_sec;
+    its.it_interval.tv_nsec = its.it_value.tv_nsec;
+
+    if (timer_settime(clock_timer, 0, &its, NULL) == -1)
+        errExit("timer_settime");
+
+    sev.sigev_signo = SIGRTMAX-2;
+    sev.sigev_value.sival_ptr = &retry_timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &retry_timer) == -1)
+        errExit("timer_create");
+    retry_timer_made = 1;
+
+    /* interrupts sent before any processor could take them */
+    if (event_signalled)
+        interrupt_retry();
+}
+
+uint64_t
+clock_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
+/*
+ * Arm the calling processor's clock to go off at time first, and
+ * then every interval nanoseconds (or never again, if interval is 0).
+ * A first of 0 disarms it.
+ */
+static void
+clock_arm(uint64_t first, uint64_t interval) {
+    struct itimerspec its;
+
+    its.it_value.tv_sec = first / SECOND;
+    its.it_value.tv_nsec = first % SECOND;
+    its.it_interval.tv_sec = interval / SECOND;
+    its.it_interval.tv_nsec = interval % SECOND;
+    if (timer_settime(clock_timer, TIMER_ABSTIME, &its, NULL) == -1)
+        errExit("timer_settime");
+}
+
+void
+clock_set_periodic(uint64_t first) {
+    clock_arm(first, clock_period);
+}
+
+void
+clock_set_oneshot(uint64_t when) {
+    clock_arm(when, 0);
+}
+
+void
+clock_set_alarm(uint64_t when) {
+    struct itimerspec its;
+
+    if (!alarm_timer_made || when == alarm_when)
+        return;
+    alarm_when = when;
+    its.it_value.tv_sec = when / SECOND;
+    its.it_value.tv_nsec = when % SECOND;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+    if (timer_settime(alarm_timer, TIMER_ABSTIME, &its, NULL) == -1)
+        errExit("timer_settime");
+}
+
+/*
+ * The alarm timer went off when the first processor could not take it:
+ * have it go off again shortly.
+ */
+static void
+alarm_retry() {
+    struct itimerspec its;
+
+    its.it_value.tv_sec = 0;
+    its.it_value.tv_nsec = ALARM_RETRY_DELAY;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+    timer_settime(alarm_timer, 0, &its, NULL);
+}
+
+/*
+ * rt_sigsuspend, made here rather than through libc so that the
+ * instruction a signal interrupts lies between start and end, and
+ * handle_interrupt runs the handler as it would for any other code
+ * of ours.
+ */
+static void
+suspend_here(sigset_t* mask) {
+    long ret;
+
+    asm volatile ("syscall"
+                  : "=a" (ret)
+                  : "0" ((long)SYS_rt_sigsuspend), "D" (mask), "S" ((long)(_NSIG / 8))
+                  : "rcx", "r11", "memory");
+}
+
+void
+interrupt_wait(volatile int* cond) {
+    sigset_t set;
+    sigset_t old_set;
+
+    sigemptyset(&set);
+    sigaddset(&set,SIGRTMAX-1);
+    sigaddset(&set,SIGRTMAX-2);
+    pthread_sigmask(SIG_BLOCK,&set,&old_set);
+
+    /* a wakeup sent since we blocked is pending, and ends the suspend at once */
+    if (*cond == 0)
+        suspend_here(&old_set);
+
+    pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+}
+
+void
+interrupt_wake(pthread_t processor) {
+    pthread_kill(processor, SIGRTMAX-1);
+}
+
+
+/*
+ * Register the minithread clock handler by making
+ * mini_clock_handler point to it.
+ *
+ * Then set the signal handler for SIGRTMAX-1 to
+ * handle_interrupt.  This signal handler will either
+ * interrupt the minithreads, or drop the interrupt,
+ * depending on safety conditions.
+ *
+ * The signals are handled on their own stack to reduce
+ * chances of an overrun.
+ */
+void
+minithread_clock_init(int period, interrupt_handler_t clock_handler){
+    struct sigaction sa;
+    struct sigevent sev;
+    mini_clock_handler = clock_handler;
+    clock_period = period;
+
     if(DEBUG)
         printf("SIGRTMAX = %d\n",SIGRTMAX);
 
@@ -131,21 +371,26 @@ minithread_clock_init(int period, interrupt_handler_t clock_handler){
     if (sigaction(SIGRTMAX-1, &sa, NULL) == -1)
         errExit("sigaction");
 
-    /* Create the timer */
-    sev.sigev_notify = SIGEV_SIGNAL;
+    start_processor_clock(period);
+
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
     sev.sigev_signo = SIGRTMAX-1;
-    sev.sigev_value.sival_ptr = &timerid;
-    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &timerid) == -1)
+    sev.sigev_value.sival_ptr = &alarm_timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &alarm_timer) == -1)
         errExit("timer_create");
+    alarm_timer_made = 1;
+}
 
-    /* Start the timer */
-    its.it_value.tv_sec = (period) / 1000000000;
-    its.it_value.tv_nsec = (period) % 1000000000;
-    its.it_interval.tv_sec = its.it_value.tv_sec;
-    its.it_interval.tv_nsec = its.it_value.tv_nsec;
-
-    if (timer_settime(timerid, 0, &its, NULL) == -1)
-        errExit("timer_settime");
+/*
+ * Bring up the calling kernel thread as another processor: give
+ * it a clock like the first one's, then take the kernel lock so
+ * it starts out with interrupts disabled.
+ */
+void
+interrupt_processor_init(int period){
+    start_processor_clock(period);
+    kernel_lock_acquire();
 }
 
 
@@ -157,6 +402,11 @@ void
 handle_interrupt(int sig, siginfo_t *si, ucontext_t *ucontext)
 {
     uint64_t eip = ucontext->uc_mcontext.gregs[RIP];
+
+    /* a wakeup from interrupt_wake only needs to end interrupt_wait */
+    if(sig==SIGRTMAX-1 && si->si_code==SI_TKILL)
+        return;
+
     /*
      * This allows us to check the interrupt level
      * and effectively block other signals.
@@ -171,6 +421,7 @@ handle_interrupt(int sig, siginfo_t *si, ucontext_t *ucontext)
             eip < (uint64_t)end){
 
         unsigned long *newsp;
+        void *fpcopy = NULL;
         /*
          * push the return address
          */
@@ -182,18 +433,31 @@ handle_interrupt(int sig, siginfo_t *si, ucontext_t *ucontext)
          */
 #define ROUND(X,Y)   (((unsigned long)X) & ~(Y-1)) /* Y must be a power of 2 */
         newsp = (unsigned long *) ROUND(newsp, 16);
+        /*
+         * the trampoline restores the fp state from this copy. The kernel
+         * keeps restoring from its own frame: it would read the extended
+         * state past the end of the copy, which may be past the end of
+         * the stack.
+         */
         if(ucontext->uc_mcontext.fpregs!=0){
             newsp -= sizeof(struct _fpstate)/sizeof(long);
             memcpy(newsp,ucontext->uc_mcontext.fpregs,sizeof(struct _fpstate));
-            ucontext->uc_mcontext.fpregs = (void *)newsp;
+            fpcopy = (void *)newsp;
         }
 
         *--newsp = (unsigned long)ucontext->uc_mcontext.gregs[RSP] - sizeof(unsigned long); /*address of RIP*/
         newsp -= sizeof(struct sigcontext)/sizeof(long);
         memcpy(newsp,&ucontext->uc_mcontext,sizeof(struct sigcontext));
-        *--newsp = (unsigned long)ucontext->uc_mcontext.fpregs;
+        *--newsp = (unsigned long)fpcopy;
         *--newsp = (unsigned long)minithread_trampoline; /*return address*/
 
+        /*
+         * interrupt_wait takes interrupts with them blocked outside
+         * the suspend; the handler must not keep them blocked.
+         */
+        sigdelset(&ucontext->uc_sigmask,SIGRTMAX-1);
+        sigdelset(&ucontext->uc_sigmask,SIGRTMAX-2);
+
         /*
          * set the context so that we end up in the student's clock handler
          * and our stack pointer is at the return address we just pushed onto
@@ -201,14 +465,18 @@ handle_interrupt(int sig, siginfo_t *si, ucontext_t *ucontext)
          */
         if(sig==SIGRTMAX-2){
             ucontext->uc_mcontext.gregs[RSP]=(unsigned long)newsp;
-            ucontext->uc_mcontext.gregs[RIP]=(unsigned long)((interrupt_t*)si->si_value.sival_ptr)->handler;
-            ucontext->uc_mcontext.gregs[RDI]=(unsigned long)((interrupt_t*)si->si_value.sival_ptr)->arg;
+            ucontext->uc_mcontext.gregs[RIP]=(unsigned long)interrupt_drain;
+            ucontext->uc_mcontext.gregs[RDI]=(unsigned long)0;
             set_interrupt_level(DISABLED);
         }
         else if(sig==SIGRTMAX-1){
             ucontext->uc_mcontext.gregs[RSP]=(unsigned long)newsp;
             ucontext->uc_mcontext.gregs[RIP]=(unsigned long)mini_clock_handler;
             ucontext->uc_mcontext.gregs[RDI]=(unsigned long)0;
+            if(si->si_value.sival_ptr==&alarm_timer){
+                alarm_when = 0;
+                ucontext->uc_mcontext.gregs[RDI]=(unsigned long)CLOCK_ALARM;
+            }
             if(DEBUG)
                 printf("SP=%p\n",newsp);
         }
@@ -217,46 +485,244 @@ handle_interrupt(int sig, siginfo_t *si, ucontext_t *ucontext)
             fflush(stdout);
             abort();
         }
-        if(sig==SIGRTMAX-2)
-            signal_handled = 1;
     }
+    else if(sig==SIGRTMAX-2){
+        /* the handlers cannot run here now; they stay in the ring */
+        interrupt_retry();
+    }
+    else if(sig==SIGRTMAX-1 && si->si_value.sival_ptr==&alarm_timer){
+        /* unlike a clock tick, there is no next one to wait for */
+        alarm_retry();
+    }
+}
 
-    if(sig==SIGRTMAX-2){
-        if(DEBUG)
-            printf("Signal received\n");
-        sem_post(&interrupt_received_sema);
+static void
+event_push(interrupt_handler_t handler, void *arg) {
+    interrupt_event *slot;
+    uint64_t pos;
+    uint64_t lap;
+
+    for (;;) {
+        pos = event_head;
+        slot = &event_ring[pos % EVENT_RING_SIZE];
+        lap = pos - pos % EVENT_RING_SIZE;
+        if (slot->stamp == lap) {
+            if (__sync_bool_compare_and_swap(&event_head, pos, pos + 1))
+                break;
+        }
+        else if (slot->stamp < lap) {
+            /* full: the processors are behind, give them time */
+            sched_yield();
+        }
     }
+    slot->handler = handler;
+    slot->arg = arg;
+    __sync_synchronize();
+    slot->stamp = lap + 1;
 }
 
-void send_interrupt(int interrupt_type, interrupt_handler_t handler, void* arg){
+/*
+ * Takes the next event off the ring into event. Returns 1, or 0 if
+ * there is none. The caller must hold the kernel lock.
+ */
+static int
+event_pop(interrupt_event *event) {
+    interrupt_event *slot = &event_ring[event_tail % EVENT_RING_SIZE];
+    uint64_t lap = event_tail - event_tail % EVENT_RING_SIZE;
+
+    if (slot->stamp != lap + 1)
+        return 0;
+    __sync_synchronize();
+    event->handler = slot->handler;
+    event->arg = slot->arg;
+    __sync_synchronize();
+    slot->stamp = lap + EVENT_RING_SIZE;
+    event_tail++;
+    return 1;
+}
 
-    interrupt_t interrupt;
-    pthread_mutex_lock(&signal_mutex);
-    for (;;){
-        signal_handled = 0;
-
-        interrupt.arg = arg;
-        if(interrupt_type==NETWORK_INTERRUPT_TYPE)
-            interrupt.handler = mini_network_handler;
-        else if(interrupt_type==READ_INTERRUPT_TYPE)
-            interrupt.handler = mini_read_handler;
-        else if(interrupt_type==DISK_INTERRUPT_TYPE)
-            interrupt.handler = mini_disk_handler;
-        else
-            abort();
+static void
+interrupt_retry() {
+    struct itimerspec its;
+
+    if (!retry_timer_made)
+        return;
+    its.it_value.tv_sec = 0;
+    its.it_value.tv_nsec = EVENT_RETRY_DELAY;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+    timer_settime(retry_timer, 0, &its, NULL);
+}
+
+/*
+ * Where handle_interrupt sends a processor that takes SIGRTMAX-2, with
+ * interrupts disabled: runs the handlers of the interrupts in the ring,
+ * up to a ring's worth so that a flood of them cannot starve the threads.
+ * Handlers that enable interrupts get them disabled again for the next.
+ */
+static void
+interrupt_drain(void *arg) {
+    interrupt_event event;
+    int count = 0;
+
+    /* interrupts pushed from here on send another signal */
+    event_signalled = 0;
+    __sync_synchronize();
+    for (;;) {
+        set_interrupt_level(DISABLED);
+        if (count == EVENT_RING_SIZE || !event_pop(&event))
+            break;
+        event.handler(event.arg);
+        count++;
+    }
+    if (count == EVENT_RING_SIZE &&
+            __sync_bool_compare_and_swap(&event_signalled, 0, 1))
+        interrupt_retry();
+    /* last, since it may switch threads */
+    if (mini_drain_handler != NULL)
+        mini_drain_handler(NULL);
+}
+
+void
+install_drain_handler(interrupt_handler_t drain_handler) {
+    mini_drain_handler = drain_handler;
+}
 
+void send_interrupt(int interrupt_type, interrupt_handler_t handler, void* arg){
+    if(interrupt_type==NETWORK_INTERRUPT_TYPE)
+        handler = mini_network_handler;
+    else if(interrupt_type==READ_INTERRUPT_TYPE)
+        handler = mini_read_handler;
+    else if(interrupt_type==DISK_INTERRUPT_TYPE)
+        handler = mini_disk_handler;
+    else
+        abort();
+
+    event_push(handler, arg);
+    if (__sync_bool_compare_and_swap(&event_signalled, 0, 1)) {
         /* Repeat if signal is not delivered. */
-        while(sigqueue(getpid(),SIGRTMAX-2, (union sigval)(void*)&interrupt)==-1);
+        while(sigqueue(getpid(),SIGRTMAX-2,(union sigval)(void*)NULL)==-1);
+    }
+}
 
-        /* semaphore_P to wait for main thread signal */
-        sem_wait(&interrupt_received_sema);
+/*
+ * The I/O thread. Device interrupts come from here: each readable
+ * source's poll function turns what it reads into send_interrupt calls.
+ */
+static void *
+io_loop(void *arg) {
+    struct epoll_event events[MAXEVENTS];
+    interrupt_source *source;
+    int n;
+    int i;
+
+    for (;;) {
+        n = epoll_wait(io_epoll, events, MAXEVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            errExit("epoll_wait");
+        }
+        for (i = 0; i < n; i++) {
+            source = (interrupt_source *)events[i].data.ptr;
+            source->poll(source->fd, source->arg);
+        }
+    }
+    return NULL;
+}
 
-        /* Check if interrupt was handled */
-        if(signal_handled)
-            break;
+static void
+io_start() {
+    pthread_t io_thread;
+    sigset_t set;
+    sigset_t old_set;
+    struct sigaction sa;
+    cpu_set_t cpus;
+
+    io_epoll = epoll_create(MAXEVENTS);
+    if (io_epoll == -1)
+        errExit("epoll_create");
+
+    sa.sa_handler = (void*)handle_interrupt;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    sa.sa_sigaction= (void*)handle_interrupt;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask,SIGRTMAX-2);
+    sigaddset(&sa.sa_mask,SIGRTMAX-1);
+    if (sigaction(SIGRTMAX-2, &sa, NULL) == -1)
+        errExit("sigaction");
+
+    /* the I/O thread never takes interrupts */
+    sigemptyset(&set);
+    sigaddset(&set,SIGRTMAX-1);
+    sigaddset(&set,SIGRTMAX-2);
+    sigprocmask(SIG_BLOCK,&set,&old_set);
+    AbortOnCondition(pthread_create(&io_thread, NULL, io_loop, NULL) != 0,
+        "pthread");
+    if (io_cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(io_cpu, &cpus);
+        pthread_setaffinity_np(io_thread, sizeof(cpus), &cpus);
+    }
+    pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+}
+
+int
+interrupt_layer_init() {
+    pthread_once(&io_once, io_start);
+    return 0;
+}
+
+void
+interrupt_set_io_cpu(int cpu) {
+    io_cpu = cpu;
+}
 
-        sleep(0);
-        /* resend if necessary */
+int
+interrupt_add_source(int fd, device_poll_t poll, void *arg) {
+    interrupt_source *source;
+    struct epoll_event event;
+
+    interrupt_layer_init();
+    source = (interrupt_source *)malloc(sizeof(interrupt_source));
+    if (source == NULL)
+        return -1;
+    source->fd = fd;
+    source->poll = poll;
+    source->arg = arg;
+
+    pthread_mutex_lock(&io_mutex);
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(io_epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+        pthread_mutex_unlock(&io_mutex);
+        free(source);
+        return -1;
+    }
+    source->next = io_sources;
+    io_sources = source;
+    pthread_mutex_unlock(&io_mutex);
+    return 0;
+}
+
+int
+interrupt_remove_source(int fd) {
+    interrupt_source **prev;
+    interrupt_source *source;
+
+    pthread_mutex_lock(&io_mutex);
+    for (prev = &io_sources; *prev != NULL; prev = &(*prev)->next) {
+        if ((*prev)->fd == fd)
+            break;
+    }
+    source = *prev;
+    if (source == NULL) {
+        pthread_mutex_unlock(&io_mutex);
+        return -1;
     }
-    pthread_mutex_unlock(&signal_mutex);
+    *prev = source->next;
+    epoll_ctl(io_epoll, EPOLL_CTL_DEL, fd, NULL);
+    pthread_mutex_unlock(&io_mutex);
+    free(source);
+    return 0;
 }
@@ -22,7 +22,9 @@
 #ifndef __INTERRUPTS_H__
 #define __INTERRUPTS_H__ 1
 
+#include <pthread.h>
 #include "defs.h"
+#include "inttypes.h"
 
 /* set_interrupt_level(interrupt_level_t level)
  *      Set the interrupt level to newlevel, return the old interrupt level
@@ -54,10 +56,15 @@
  * Interrupts that occur while interrupts are disabled are dropped, so you
  * should minimize the amount of time interrupts are disabled in order to
  * reduce the number of dropped interrupts.
+ *
+ * Each processor has its own interrupt level. So that disabling interrupts
+ * still gives mutual exclusion when there is more than one processor, a
+ * processor holds a single kernel lock for as long as its interrupts are
+ * disabled; minithread_switch drops it for the thread it switches to.
  */
 
 typedef int interrupt_level_t;
-extern interrupt_level_t interrupt_level;
+extern __thread interrupt_level_t interrupt_level;
 
 #define DISABLED 0
 #define ENABLED 1
@@ -80,5 +87,76 @@ extern interrupt_level_t set_interrupt_level(interrupt_level_t newlevel);
 typedef void(*interrupt_handler_t)(void*);
 extern void minithread_clock_init(int period, interrupt_handler_t h);
 
+/*
+ * install_drain_handler(h)
+ *     installs h to be called, with interrupts disabled and a NULL
+ *     argument, after each batch of network, read and disk interrupt
+ *     handlers has run. Like the clock handler, h may switch to another
+ *     thread, in which case interrupts are enabled again when the
+ *     interrupted thread is next switched to.
+ */
+extern void install_drain_handler(interrupt_handler_t h);
+
+/*
+ * interrupt_processor_init(period)
+ *     sets up the calling kernel thread as an additional processor: starts a
+ *     clock on it that calls the handler given to minithread_clock_init every
+ *     [period] nanoseconds, and returns with its interrupts disabled, ready
+ *     to minithread_switch to its first thread.
+ */
+extern void interrupt_processor_init(int period);
+
+/*
+ * clock_now()
+ *     returns the time on the monotonic clock that the clocks run on, in
+ *     nanoseconds.
+ */
+extern uint64_t clock_now();
+
+/*
+ * clock_set_periodic(first)
+ *     makes the calling processor's clock go off at time [first] and every
+ *     period nanoseconds after that, as it does after minithread_clock_init.
+ */
+extern void clock_set_periodic(uint64_t first);
+
+/*
+ * clock_set_oneshot(when)
+ *     makes the calling processor's clock go off once, at time [when], and
+ *     then stop. A [when] of 0 stops it now. Used while the processor is
+ *     idle, so that it is not woken up when there is nothing to do.
+ */
+extern void clock_set_oneshot(uint64_t when);
+
+/*
+ * clock_set_alarm(when)
+ *     makes the alarm timer go off once, at time [when], in place of the
+ *     last time it was given; a [when] of 0 stops it. The alarm timer
+ *     belongs to the first processor but is separate from its clock: when
+ *     it goes off, the clock handler runs there with CLOCK_ALARM as its
+ *     argument (clock ticks pass NULL), whether or not the processor is
+ *     idle. It can be set from any processor.
+ */
+#define CLOCK_ALARM ((void*)1)
+extern void clock_set_alarm(uint64_t when);
+
+/*
+ * interrupt_wait(cond)
+ *     puts the calling processor to sleep in the kernel until it takes an
+ *     interrupt or is woken up by interrupt_wake, unless *cond is already
+ *     nonzero. Must be called with interrupts enabled. There is no lost
+ *     wakeup: to make *cond nonzero and then wake this processor is safe
+ *     at any time, as long as the processor shows it is about to wait
+ *     (behind a memory barrier) before calling this.
+ */
+extern void interrupt_wait(volatile int* cond);
+
+/*
+ * interrupt_wake(processor)
+ *     wakes the processor running on kernel thread [processor] if it is in
+ *     interrupt_wait.
+ */
+extern void interrupt_wake(pthread_t processor);
+
 #endif /* __INTERRUPTS_H__ */
 
@@ -11,11 +11,38 @@
 
 
 /*
- * Set up the interrupt layer by starting the epoll loop.
- * This is called when the clock handler is installed.
+ * Set up the interrupt layer by starting the epoll loop: a single I/O
+ * thread that waits on every device source and runs its poll function
+ * when it is readable. This is called when the first source is added.
  */
 extern int interrupt_layer_init();
 
+/*
+ * Called on the I/O thread when fd is readable. It reads what is there
+ * and hands it to the minithreads with send_interrupt; it must not block,
+ * and must not touch kernel objects.
+ */
+typedef void (*device_poll_t)(int fd, void* arg);
+
+/*
+ * Have the I/O thread call poll(fd, arg) whenever fd is readable (level
+ * triggered). Returns 0 (success) or -1 (failure, e.g. fd is a regular
+ * file, which epoll cannot wait on).
+ */
+extern int interrupt_add_source(int fd, device_poll_t poll, void* arg);
+
+/*
+ * Stop polling fd. Only a source's own poll function may remove it.
+ * Returns 0 (success) or -1 (fd is not a source).
+ */
+extern int interrupt_remove_source(int fd);
+
+/*
+ * Run the I/O thread only on the given CPU. Must be called before
+ * the first source is added.
+ */
+extern void interrupt_set_io_cpu(int cpu);
+
 /*
  * Handle the signal on the main thread, check the safety
  * conditions and if satisfied, manipulate the stack
@@ -12,6 +12,7 @@
 #include "minithread.h"
 #include "machineprimitives.h"
 #include <sys/mman.h>
+#include <unistd.h>
 
 /*
  * Used to initialize a thread's stack for the first context switch
@@ -46,28 +47,65 @@ struct initial_stack_state
 };
 
 #define STACK_GROWS_DOWN        1
-#define STACKSIZE               (256 * 1024)
+#define STACKSIZE               DEFAULT_STACKSIZE
 #define STACKALIGN              0xf
 
+static long
+page_size()
+{
+    static long size = 0;
+
+    if (size == 0)
+        size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+static size_t
+page_round(size_t n)
+{
+    return (n + page_size() - 1) & ~(page_size() - 1);
+}
+
 /*
- * Allocate a new stack.
+ * Allocate a new stack, mapped on its own with the guard pages at the
+ * end it grows towards. The mapping only reserves address space: the
+ * kernel commits each page the first time the thread touches it.
+ * stackbase is the start of the mapping, guard pages included.
  */
 void
-minithread_allocate_stack(stack_pointer_t *stackbase, stack_pointer_t *stacktop)
+minithread_allocate_stack_size(stack_pointer_t *stackbase, stack_pointer_t *stacktop,
+                               size_t size, size_t guard)
 {
-    *stackbase = (stack_pointer_t) malloc(STACKSIZE);
-    if (!*stackbase)  {
+    char *mapping;
+
+    size = page_round(size);
+    guard = page_round(guard);
+    *stackbase = NULL;
+    mapping = mmap(NULL, size + guard, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED)  {
         return;
     }
 
-    if (STACK_GROWS_DOWN)
-      /* Stacks grow down, but malloc grows up. Compensate and word align
-         (turn off low 2 bits by anding with ~3). */
-      *stacktop = (stack_pointer_t) ((long)((char*)*stackbase + STACKSIZE - 1) & ~STACKALIGN);
+    if (STACK_GROWS_DOWN) {
+      if (guard > 0)
+        mprotect(mapping, guard, PROT_NONE);
+      /* Stacks grow down from the end of the mapping; word align. */
+      *stacktop = (stack_pointer_t) ((long)(mapping + guard + size - 1) & ~STACKALIGN);
+    }
     else {
+      if (guard > 0)
+        mprotect(mapping + size, guard, PROT_NONE);
       /* Word align (turn off low 2 bits by anding with ~3) */
-      *stacktop = (stack_pointer_t)(((long)*stackbase + 3)&~STACKALIGN);
+      *stacktop = (stack_pointer_t)(((long)mapping + 3)&~STACKALIGN);
     }
+    *stackbase = (stack_pointer_t) mapping;
+}
+
+void
+minithread_allocate_stack(stack_pointer_t *stackbase, stack_pointer_t *stacktop)
+{
+    minithread_allocate_stack_size(stackbase, stacktop, STACKSIZE, page_size());
 }
 
 /*
@@ -75,10 +113,17 @@ minithread_allocate_stack(stack_pointer_t *stackbase, stack_pointer_t *stacktop)
  *
  * The stack cannot be used after this call.
  */
+void
+minithread_free_stack_size(stack_pointer_t stackbase, size_t size, size_t guard)
+{
+    if (stackbase != NULL)
+        munmap(stackbase, page_round(size) + page_round(guard));
+}
+
 void
 minithread_free_stack(stack_pointer_t stackbase)
 {
-    free(stackbase);
+    minithread_free_stack_size(stackbase, STACKSIZE, page_size());
 }
 
 /*
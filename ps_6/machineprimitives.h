@@ -16,6 +16,9 @@
 
 typedef void *stack_pointer_t;
 
+#define DEFAULT_STACKSIZE (256 * 1024)
+#define MIN_STACKSIZE (16 * 1024)
+
 typedef int tas_lock_t;       /* test-and-set locks.  */
 typedef int *arg_t;           /* function argument */
 typedef int (*proc_t)(arg_t); /* generic function pointer */
@@ -33,11 +36,24 @@ typedef int (*proc_t)(arg_t); /* generic function pointer */
  *  |               |
  *  |  stackbase    |  <- bottom of stack.
  *  -----------------
+ *
+ *  Each stack has a guard page past its bottom, so overflowing it faults.
+ *  *stackbase is NULL if no stack could be allocated.
  */
 
 extern void minithread_allocate_stack(stack_pointer_t *stackbase,
                                       stack_pointer_t *stacktop);
 
+/*
+ * Like minithread_allocate_stack, but the stack is [size] bytes and has
+ * [guard] bytes of guard pages, which may be 0; both are rounded up to
+ * whole pages. Only address space is allocated up front, and memory
+ * for each page of the stack when it is first used.
+ */
+extern void minithread_allocate_stack_size(stack_pointer_t *stackbase,
+                                           stack_pointer_t *stacktop,
+                                           size_t size, size_t guard);
+
 /*
  * minithread_free_stack(stack_pointer_t stackbase)
  *
@@ -46,6 +62,13 @@ extern void minithread_allocate_stack(stack_pointer_t *stackbase,
  */
 extern void minithread_free_stack(stack_pointer_t stackbase);
 
+/*
+ * Frees a stack from minithread_allocate_stack_size, which was given
+ * size and guard.
+ */
+extern void minithread_free_stack_size(stack_pointer_t stackbase,
+                                       size_t size, size_t guard);
+
 /*
  *  Initialize the stackframe pointed to by *stacktop so that
  *  the thread running off of *stacktop will invoke:
@@ -106,6 +129,14 @@ extern void atomic_clear(tas_lock_t *l);
  */
 extern int swap(int* x, int newval);
 
+/*
+ * Atomically set the calling processor's interrupt level to newval, and
+ * return the old value. Unlike swap(&interrupt_level, newval), the thread
+ * cannot be moved to another processor between finding the variable and
+ * swapping it.
+ */
+extern int swap_interrupt_level(int newval);
+
 /*
  * Atomic compare and swap.
  * If the value pointed to by x is equal to oldval, then replace it with
@@ -0,0 +1,270 @@
+/* microbench.c
+   Times the basic operations of the thread system, to compare scheduler,
+   allocator and queue changes over time.
+   Usage: microbench [runs] [case ...]
+   Runs each case (all of them if none are named) once to warm up and
+   then runs times, and prints a line of comma separated values per case:
+   its name, operations per run, runs, and the fastest, median, mean and
+   slowest run in nanoseconds per operation. Lines starting with # are
+   comments.
+   yield: two threads yield to each other; an op is a round trip, a
+   yield by each of them.
+   semaphore: two threads pass a turn back and forth with a pair of
+   semaphores; an op is one pass.
+   fork: fork a thread that exits at once and wait for it.
+   sleep: sleep for SLEEP_NS; an op is how late the sleeper wakes up.
+   alarm: set an alarm and cancel it.
+   mlq: enqueue and dequeue on a multilevel queue holding a few items.
+*/
+#include "minithread.h"
+#include "synch.h"
+#include "interrupts.h"
+#include "alarm.h"
+#include "multilevel_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_RUNS 5
+#define MAX_RUNS 100
+#define SLEEP_NS (200 * 1000)
+#define MLQ_LEVELS 4
+#define RESIDENT_ITEMS 8
+
+/*
+ * A case runs ops operations, an even number, and returns the
+ * nanoseconds they took. What an operation is depends on the case (see
+ * above).
+ */
+typedef uint64_t (*bench_t)(long ops);
+
+typedef struct {
+  char* name;
+  bench_t run;
+  long ops;
+} bench_case;
+
+int runs = DEFAULT_RUNS;
+char** names;
+int num_names = 0;
+semaphore_t ping;
+semaphore_t pong;
+semaphore_t done;
+volatile int stop = 0;
+
+int
+yielder(int* arg) {
+  while (!stop) minithread_yield();
+  semaphore_V(done);
+  return 0;
+}
+
+uint64_t
+bench_yield(long ops) {
+  uint64_t start;
+  long i;
+
+  stop = 0;
+  minithread_fork(yielder, NULL);
+  minithread_yield();
+  start = minithread_time_ns();
+  for (i = 0; i < ops; i++) minithread_yield();
+  start = minithread_time_ns() - start;
+  stop = 1;
+  semaphore_P(done);
+  return start;
+}
+
+int
+ponger(int* arg) {
+  long rounds = (long)(intptr_t)arg;
+  long i;
+
+  for (i = 0; i < rounds; i++) {
+    semaphore_P(ping);
+    semaphore_V(pong);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+uint64_t
+bench_semaphore(long ops) {
+  uint64_t start;
+  long rounds = ops / 2;
+  long i;
+
+  minithread_fork(ponger, (arg_t)(intptr_t)rounds);
+  minithread_yield();
+  start = minithread_time_ns();
+  for (i = 0; i < rounds; i++) {
+    semaphore_V(ping);
+    semaphore_P(pong);
+  }
+  start = minithread_time_ns() - start;
+  semaphore_P(done);
+  return start;
+}
+
+int
+child(int* arg) {
+  semaphore_V(done);
+  return 0;
+}
+
+uint64_t
+bench_fork(long ops) {
+  uint64_t start = minithread_time_ns();
+  long i;
+
+  for (i = 0; i < ops; i++) {
+    minithread_fork(child, NULL);
+    semaphore_P(done);
+  }
+  return minithread_time_ns() - start;
+}
+
+uint64_t
+bench_sleep(long ops) {
+  uint64_t late = 0;
+  uint64_t start;
+  long i;
+
+  for (i = 0; i < ops; i++) {
+    start = minithread_time_ns();
+    minithread_sleep_ns(SLEEP_NS);
+    late += minithread_time_ns() - start - SLEEP_NS;
+  }
+  return late;
+}
+
+void
+never(void* arg) {
+}
+
+uint64_t
+bench_alarm(long ops) {
+  interrupt_level_t l;
+  uint64_t start = minithread_time_ns();
+  alarm_id id;
+  long i;
+
+  for (i = 0; i < ops; i++) {
+    l = set_interrupt_level(DISABLED);
+    id = register_alarm(1000, never, NULL);
+    deregister_alarm(id);
+    set_interrupt_level(l);
+  }
+  return minithread_time_ns() - start;
+}
+
+uint64_t
+bench_mlq(long ops) {
+  multilevel_queue_t q = multilevel_queue_new(MLQ_LEVELS);
+  uint64_t start;
+  void* item;
+  long i;
+
+  for (i = 0; i < RESIDENT_ITEMS; i++) {
+    multilevel_queue_enqueue(q, i % MLQ_LEVELS, (void*)i);
+  }
+  start = minithread_time_ns();
+  for (i = 0; i < ops; i++) {
+    multilevel_queue_enqueue(q, (i * 7) % MLQ_LEVELS, (void*)i);
+    multilevel_queue_dequeue(q, i % MLQ_LEVELS, &item);
+  }
+  start = minithread_time_ns() - start;
+  multilevel_queue_free(q);
+  return start;
+}
+
+bench_case cases[] = {
+  { "yield", bench_yield, 100000 },
+  { "semaphore", bench_semaphore, 200000 },
+  { "fork", bench_fork, 50000 },
+  { "sleep", bench_sleep, 200 },
+  { "alarm", bench_alarm, 1000000 },
+  { "mlq", bench_mlq, 2000000 },
+};
+
+int
+compare_times(const void* a, const void* b) {
+  double x = *(double*)a;
+  double y = *(double*)b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * Returns 1 if the case called name was asked for.
+ */
+int
+wanted(char* name) {
+  int i;
+
+  if (num_names == 0) return 1;
+  for (i = 0; i < num_names; i++) {
+    if (strcmp(names[i], name) == 0) return 1;
+  }
+  return 0;
+}
+
+int
+run_microbench(int* arg) {
+  double times[MAX_RUNS];
+  double mean;
+  bench_case* c;
+  int i;
+  int j;
+
+  printf("# %d processors, %d runs after a warmup\n",
+      minithread_num_processors(), runs);
+  printf("case,ops,runs,min_ns,median_ns,mean_ns,max_ns\n");
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    c = &cases[i];
+    if (!wanted(c->name)) continue;
+    c->run(c->ops / 10 > 0 ? c->ops / 10 : 1);
+    mean = 0;
+    for (j = 0; j < runs; j++) {
+      times[j] = (double)c->run(c->ops) / c->ops;
+      mean += times[j] / runs;
+    }
+    qsort(times, runs, sizeof(double), compare_times);
+    printf("%s,%ld,%d,%.1f,%.1f,%.1f,%.1f\n", c->name, c->ops, runs,
+        times[0], times[runs / 2], mean, times[runs - 1]);
+  }
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  int i;
+  int j;
+
+  if (argc > 1) {
+    runs = atoi(argv[1]);
+  }
+  if (runs < 1) runs = 1;
+  if (runs > MAX_RUNS) runs = MAX_RUNS;
+  names = argv + 2;
+  num_names = argc > 2 ? argc - 2 : 0;
+  for (i = 0; i < num_names; i++) {
+    for (j = 0; j < sizeof(cases) / sizeof(cases[0]); j++) {
+      if (strcmp(cases[j].name, names[i]) == 0) break;
+    }
+    if (j == sizeof(cases) / sizeof(cases[0])) {
+      fprintf(stderr, "microbench: no case called %s\n", names[i]);
+      return 1;
+    }
+  }
+  ping = semaphore_create();
+  semaphore_initialize(ping, 0);
+  pong = semaphore_create();
+  semaphore_initialize(pong, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_microbench, NULL);
+  return 0;
+}
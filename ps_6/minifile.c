@@ -125,7 +125,7 @@ enum { READ = 1, WRITE, READ_WRITE, APPEND, READ_APPEND };
 
 const char* disk_name; 
 block_ctrl_t* block_array = NULL; 
-semaphore_t disk_op_lock = NULL; 
+mutex_t disk_op_lock = NULL; 
 disk_t* my_disk = NULL; 
 semaphore_t* inode_lock_table; 
 
@@ -599,7 +599,7 @@ void minifile_fix_fs() {
 }
 
 void minifile_disk_error_handler(disk_interrupt_arg_t* block_arg) {
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
 
   printf("enter minifile_disk_error_handler\n");
   switch (block_arg->reply) {
@@ -624,7 +624,7 @@ void minifile_disk_error_handler(disk_interrupt_arg_t* block_arg) {
     break;
   }
   free(block_arg);
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
 }
 
 /*
@@ -1361,11 +1361,11 @@ minifile_t minifile_creat(char *filename){
   //printf("Parent directory: %s\n", parent_dir);
   parent_block = (inode_block*)calloc(1, sizeof(inode_block));
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   
   //printf("calling get block on %s\n", filename);
   if (minifile_get_block_from_path(filename) != -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("error. file exists\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1374,7 +1374,7 @@ minifile_t minifile_creat(char *filename){
   }
   parent_block_num = minifile_get_block_from_path(parent_dir);
   if (parent_block_num == -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("Directory not found: %s\n", parent_dir);
     free(parent_dir);
     free(new_dir_name);
@@ -1390,7 +1390,7 @@ minifile_t minifile_creat(char *filename){
   new_dir = minifile_create_handle(parent_block_num);
   if (!new_dir){
     printf("NULL ON MINIFILE_CREATE\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     free(parent_dir);
     free(new_dir_name);
     free(parent_block);
@@ -1398,7 +1398,7 @@ minifile_t minifile_creat(char *filename){
   }
   child_block_num = minifile_new_inode(new_dir, new_dir_name, FILE_t);
   if (child_block_num == -1) {
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("failed on getting new inode! aaaahhhhhh\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1418,7 +1418,7 @@ minifile_t minifile_creat(char *filename){
   }
   
   semaphore_P(inode_lock_table[child_file_ptr->inode_num]);
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   free(parent_dir);
   free(new_dir_name);
   free(parent_block);
@@ -1435,28 +1435,28 @@ minifile_t minifile_open(char *filename, char *mode){
     return NULL;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   printf("enter minifile_open\n");
 
   inode_num = minifile_get_block_from_path(filename);
   if (inode_num == -1) {
     printf("%s", filename);
     printf(": No such file or directory\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL;
   }
 
   handle = minifile_create_handle(inode_num);
   if (!handle) {
     printf("minifile_create_handle failed. abort!\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL;
   }
   //printf("created handle for the file requested\n");
   //check if it is FILE_t
   
   if (handle->i_block.u.hdr.type != FILE_t){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("%s: Is a directory\n", filename);
     free(handle);
     return NULL;
@@ -1471,7 +1471,7 @@ minifile_t minifile_open(char *filename, char *mode){
     if (minifile_truncate(handle) == -1){
       free(handle);
       printf("truncate file failed\n");
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       return NULL;
     }
   }
@@ -1481,7 +1481,7 @@ minifile_t minifile_open(char *filename, char *mode){
     if (minifile_truncate(handle) == -1){
       free(handle);
       printf("truncate file failed\n");
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       return NULL;
     }
   }
@@ -1505,12 +1505,12 @@ minifile_t minifile_open(char *filename, char *mode){
     printf("could not get next block\n");
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL;
   }*/
     
 
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit minifile_open on success\n\n");
   return handle;
 }
@@ -1532,13 +1532,13 @@ int minifile_read(minifile_t file, char *data, int maxlen){
   //take the smaller of the maxlen or the remaining bytes in file after cursor
   read_cap = maxlen<((file->i_block.u.hdr.count)-(file->byte_cursor))?
               maxlen : (file->i_block.u.hdr.count)-(file->byte_cursor);
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   printf("maxlen %i\n", maxlen);
   printf("count: %i, bytes_read: %i, read_cap: %i\n",file->i_block.u.hdr.count, bytes_read, read_cap);
   while (bytes_read < read_cap){
     printf("bytes_read: %i, read_cap: %i\n", bytes_read, read_cap);
     if (minifile_get_next_block(file) == -1){
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       printf("read encountered an error\n");
       return -1;
     }
@@ -1557,7 +1557,7 @@ int minifile_read(minifile_t file, char *data, int maxlen){
       file->byte_cursor += read_cap - bytes_read;
     }
   }
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit minifile_read on success\n\n");
   return 0;
 }
@@ -1600,14 +1600,14 @@ int minifile_write(minifile_t file, char *data, int len){
     return -1;
   }
   
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
 
   //if there was a previous block first use it
   if ( ((file->byte_cursor) % DATA_BLOCK_SIZE != 0)){
     printf("FOUND A PREVIOUS BLOCK!!");
     curr_data_block = minifile_get_next_block(file);
     if (curr_data_block == -1){ //load up the next block
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       printf("Could not get the next block!\n");
       return -1;
     }
@@ -1627,7 +1627,7 @@ int minifile_write(minifile_t file, char *data, int len){
       semaphore_P(block_array[curr_data_block]->block_sem);
       printf("len larger case, now:%.*s", file->byte_cursor, file->d_block.u.file_hdr.data);
       /*if ( minifile_new_dblock(file, &(file->d_block), len) == -1){
-        semaphore_V(disk_op_lock);
+        mutex_unlock(disk_op_lock);
         printf("Could not get new dblock\n");
         return -1;
       }*/
@@ -1663,12 +1663,12 @@ int minifile_write(minifile_t file, char *data, int len){
       file->block_cursor += 1;
     }
     if ( minifile_new_dblock(file, &(file->d_block), cap) == -1){
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       printf("Could not get new dblock\n");
       return -1;
     }
   }
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit minifile_write on success\n\n");
 
   return 0;
@@ -1682,10 +1682,10 @@ int minifile_close(minifile_t file){
     return -1;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   semaphore_V(inode_lock_table[file->inode_num]);
   free(file);
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit minifile_close on success\n\n");
   return 0;
 }
@@ -1703,20 +1703,20 @@ int minifile_unlink(char *filename){
     return -1;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   printf("enter minifile_unlink\n");
 
   inode_num = minifile_get_block_from_path(filename);
   if (inode_num == -1) {
     printf("error: %s not a file or directory\n", filename);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
   handle = minifile_create_handle(inode_num);
   if (!handle) {
     printf("minifile_create_handle failed. abort!\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
 
@@ -1728,7 +1728,7 @@ int minifile_unlink(char *filename){
     printf("unlink called on non-file type\n");
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1736,7 +1736,7 @@ int minifile_unlink(char *filename){
     printf("minifile_get_parent_child_paths failed. abort!\n");
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1748,7 +1748,7 @@ int minifile_unlink(char *filename){
     printf("error: %s not a file or directory\n", parent_name);
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1758,7 +1758,7 @@ int minifile_unlink(char *filename){
     printf("minifile_create_handle failed. abort!\n");
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
 
@@ -1768,7 +1768,7 @@ int minifile_unlink(char *filename){
     free(parent);
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
        
@@ -1778,7 +1778,7 @@ int minifile_unlink(char *filename){
     free(parent);
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1788,12 +1788,12 @@ int minifile_unlink(char *filename){
     free(parent);
     free(handle);
     semaphore_V(inode_lock_table[handle->inode_num]);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
   semaphore_V(inode_lock_table[handle->inode_num]);
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   free(handle);
   printf("exit minifile_unlink on success\n");
   return 0;
@@ -1831,10 +1831,10 @@ int minifile_mkdir(char *dirname){
   //printf("Parent directory: %s\n", parent_dir);
   parent_block = (inode_block*)calloc(1, sizeof(inode_block));
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   
   if (minifile_get_block_from_path(dirname) != -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("error. file exists\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1843,7 +1843,7 @@ int minifile_mkdir(char *dirname){
   }
   parent_block_num = minifile_get_block_from_path(parent_dir);
   if (parent_block_num == -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("Directory not found\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1859,7 +1859,7 @@ int minifile_mkdir(char *dirname){
   new_dir = minifile_create_handle(parent_block_num);
   if (!new_dir) {
     printf("create handle failed. abort!\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     free(parent_dir);
     free(new_dir_name);
     free(parent_block);
@@ -1867,7 +1867,7 @@ int minifile_mkdir(char *dirname){
   }    
   child_block_num = minifile_new_inode(new_dir, new_dir_name, DIR_t);
   if (child_block_num == -1) {
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("failed on getting new inode! aaaahhhhhh\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1896,7 +1896,7 @@ int minifile_mkdir(char *dirname){
   new_block->u.dir_hdr.data[1].type = DIR_t;
   //printf("calling get new block to store . and ..\n");
   if ( minifile_new_dblock(child_file_ptr, new_block, 2) == -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("failed on getting new d_block! aaaahhhhhh\n");
     free(parent_dir);
     free(new_dir_name);
@@ -1907,7 +1907,7 @@ int minifile_mkdir(char *dirname){
     return -1;
   }
   
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   free(parent_dir);
   free(new_dir_name);
   free(parent_block);
@@ -1931,40 +1931,40 @@ int minifile_rmdir(char *dirname){
     return -1;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   
   inode_num = minifile_get_block_from_path(dirname);
   if (inode_num == -1) {
     printf("%s not a valid file or directory\n", dirname);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
   handle = minifile_create_handle(inode_num); 
   if (!handle) {
     printf("minifile_create_handle failed. abort!\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
   
   if (handle->i_block.u.hdr.type != DIR_t) {
     printf("rmdir: failed to remove '%s': Not a directory\n", dirname);
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
       
   if (handle->i_block.u.hdr.count > 2) {
     printf("rmdir: failed to remove '%s': Directory not empty\n", dirname);
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
 
   if (minifile_get_parent_child_paths(&parent_name, &child_name, dirname) == -1) {
     printf("minifile_get_parent_child_paths failed. abort!\n");
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1975,7 +1975,7 @@ int minifile_rmdir(char *dirname){
   if (parent_block_num == -1) {
     printf("error: %s not a file or directory\n", parent_name);
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -1984,7 +1984,7 @@ int minifile_rmdir(char *dirname){
   if (!parent) {
     printf("minifile_create_handle failed. abort!\n");
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1; 
   }
 
@@ -1993,7 +1993,7 @@ int minifile_rmdir(char *dirname){
     printf("huh? parent is not a directory\n");
     free(parent);
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
@@ -2002,11 +2002,11 @@ int minifile_rmdir(char *dirname){
     printf("minifile_free_inode failed. abort!\n");
     free(parent);
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
 
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
 
   printf("exit minifile_rmdir on success\n\n");
   return 0;
@@ -2016,21 +2016,21 @@ int minifile_stat(char *path){
   minifile_t file_ptr;
   printf("enter minifile_stat\n");
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
 
   file_ptr = minifile_create_handle(minifile_get_block_from_path(path));
   if (!file_ptr){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return -1;
   }
   if (file_ptr->i_block.u.hdr.type != FILE_t){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     free(file_ptr);
     printf("Is a directory\n");
     return -2;
   }
 
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit minifile_stat on success\n");
   return file_ptr->i_block.u.hdr.count;
 }
@@ -2053,17 +2053,17 @@ int minifile_cd(char *path){
       return -1;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   dir_block_num = minifile_get_block_from_path(path);
   if (dir_block_num == -1){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("Directory not found\n");
     return -1;
   }
   //check if it is DIR_t
   dir_ptr = minifile_create_handle(dir_block_num);
   if (dir_ptr->i_block.u.hdr.type != DIR_t){
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     printf("%s: not a directory\n", path);
     free(dir_ptr);
     return -1;
@@ -2073,7 +2073,7 @@ int minifile_cd(char *path){
   curr_dir = minifile_absolute_path(path);
 
   minithread_set_curr_dir(minifile_simplify_path(curr_dir));
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   free(dir_ptr);
   //free(curr_dir);
   printf("exit minifile_cd on success\n\n");
@@ -2091,21 +2091,21 @@ char **minifile_ls(char *path){
     return NULL;
   }
 
-  semaphore_P(disk_op_lock);
+  mutex_lock(disk_op_lock);
   printf("enter minifile_ls\n");
 
   inode_num = minifile_get_block_from_path(path);
 
   if (inode_num == -1) {
     printf("ls: cannot access %s: No such file or directory\n", path);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL;
   }  
 
   handle = minifile_create_handle(inode_num);
   if (!handle) {
     printf("minifile_create_handle failed. abort!\n");
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL; 
   }
 
@@ -2113,14 +2113,14 @@ char **minifile_ls(char *path){
     printf("ls called on a file type\n");
     file_list = (char**)calloc(2, sizeof(char*));
     file_list[0] = path; 
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return file_list;
   }
   
   if (minifile_get_next_block(handle) == -1) {
     printf("get next block failed\n");
     free(handle);
-    semaphore_V(disk_op_lock);
+    mutex_unlock(disk_op_lock);
     return NULL;
   }
     
@@ -2140,13 +2140,13 @@ char **minifile_ls(char *path){
     if (((j+i) < handle->i_block.u.hdr.count) 
          && minifile_get_next_block(handle) == -1) {
       free(handle);
-      semaphore_V(disk_op_lock);
+      mutex_unlock(disk_op_lock);
       return file_list; 
     }
   } 
 
   free(handle);
-  semaphore_V(disk_op_lock);
+  mutex_unlock(disk_op_lock);
   printf("exit ls on success\n\n");
   return file_list; 
 }
@@ -2157,10 +2157,10 @@ char **minifile_ls(char *path){
 char* minifile_pwd(void){
   char* user_curr_dir;
 
-  semaphore_P(disk_op_lock); 
+  mutex_lock(disk_op_lock); 
   user_curr_dir = (char*)calloc(strlen(minithread_get_curr_dir()) + 1, sizeof(char));
   strcpy(user_curr_dir, minithread_get_curr_dir());
-  semaphore_V(disk_op_lock); 
+  mutex_unlock(disk_op_lock); 
   return user_curr_dir;
 }
 
@@ -2175,7 +2175,7 @@ void minifile_test_make_fs() {
   
   out = calloc(DISK_BLOCK_SIZE, sizeof(char));
  
-  semaphore_P(disk_op_lock); 
+  mutex_lock(disk_op_lock); 
   printf("enter minifile_test_make_fs\n");
   
   disk_read_block(my_disk, 0, out);
@@ -2227,7 +2227,7 @@ void minifile_test_make_fs() {
     block_num = data->u.file_hdr.next; 
   }
   
-  semaphore_V(disk_op_lock); 
+  mutex_unlock(disk_op_lock); 
   free(out);
   printf("File System creation tested\n");
 }
@@ -2244,7 +2244,7 @@ void minifile_make_fs(void) {
   inode = (inode_block*)calloc(1, sizeof(inode_block));
   data = (data_block*)calloc(1, sizeof(inode_block));
  
-  semaphore_P(disk_op_lock); 
+  mutex_lock(disk_op_lock); 
   memcpy(super->u.hdr.magic_num, magic, 4);
   super->u.hdr.block_count = BLOCK_COUNT;
   super->u.hdr.free_iblock_hd = INODE_START;
@@ -2312,7 +2312,7 @@ void minifile_make_fs(void) {
   free(inode);
   free(data);
   printf("File System created.\n");
-  semaphore_V(disk_op_lock); 
+  mutex_unlock(disk_op_lock); 
 }
 
 
@@ -2348,8 +2348,7 @@ int minifile_initialize(){
   //install a handler
   install_disk_handler(minifile_disk_handler);
 
-  disk_op_lock = semaphore_create();
-  semaphore_initialize(disk_op_lock, 1);
+  disk_op_lock = mutex_create();
   return 0;
 }
 
@@ -17,7 +17,7 @@ union port_union{
   {
     queue_t port_pkt_q;//queue for packets
     semaphore_t port_pkt_available_sem;//counting semaphore for thread blocking
-    semaphore_t q_lock;//binary semaphore for mutual exclusion
+    mutex_t q_lock;//lock for mutual exclusion
   } unbound;
   struct bound
   {
@@ -40,9 +40,9 @@ network_address_t my_addr;      // my address
 miniport_t* miniport_array;     // this array contains pointers to miniports
                                 // where the index corresponds to the port number
                                 // null if the port at that index has not been created
-semaphore_t bound_ports_lock;   // this lock ensures mutual exclusion for creating
+mutex_t bound_ports_lock;       // this lock ensures mutual exclusion for creating
                                 // or destroying bound ports
-semaphore_t unbound_ports_lock; // this lock ensures mutual exclusion for creating
+mutex_t unbound_ports_lock;     // this lock ensures mutual exclusion for creating
                                 // or destroying unbound ports
 
 queue_t pkt_q;                  // buffer for holding recieved packets for the system
@@ -70,33 +70,31 @@ minimsg_initialize() {
     miniport_array[i] = NULL;
   }
   
-  bound_ports_lock = semaphore_create();
+  bound_ports_lock = mutex_create();
   if (!bound_ports_lock){
     return;
   }
-  unbound_ports_lock = semaphore_create();
+  unbound_ports_lock = mutex_create();
   if (!unbound_ports_lock){
-    semaphore_destroy(bound_ports_lock);
+    mutex_destroy(bound_ports_lock);
     return;
   }
   
   pkt_available_sem = semaphore_create();
   if (!pkt_available_sem){
-    semaphore_destroy(bound_ports_lock);
-    semaphore_destroy(unbound_ports_lock);
+    mutex_destroy(bound_ports_lock);
+    mutex_destroy(unbound_ports_lock);
     return;
   }
 
   pkt_q = queue_new();
   if (!pkt_q){
-    semaphore_destroy(bound_ports_lock);
-    semaphore_destroy(unbound_ports_lock);
+    mutex_destroy(bound_ports_lock);
+    mutex_destroy(unbound_ports_lock);
     semaphore_destroy(pkt_available_sem);
     return;
   }
 
-  semaphore_initialize(bound_ports_lock,1);
-  semaphore_initialize(unbound_ports_lock,1);
   semaphore_initialize(pkt_available_sem,0);  
 }
 
@@ -137,15 +135,15 @@ int process_packets() {
     set_interrupt_level(l);
 
     //perform checks on packet, free & return if invalid
-    protocol = pkt->buffer[0];
+    protocol = pkt->data[0];
     if (protocol != PROTOCOL_MINIDATAGRAM &&
           protocol != PROTOCOL_MINISTREAM){
-      free(pkt);
+      network_free_pkt(pkt);
       continue;
     } 
     else {
       // JUMP ON IT
-      header = (mini_header_t)(&pkt->buffer);
+      header = (mini_header_t)pkt->data;
       unpack_address(header->source_address, src_addr);
       src_port_num = unpack_unsigned_short(header->source_port);
       unpack_address(header->destination_address, dst_addr);
@@ -156,24 +154,24 @@ int process_packets() {
         if (!network_compare_network_addresses(my_addr, dst_addr) ||
               src_port_num >= BOUND_PORT_START ||
               dst_port_num >= BOUND_PORT_START ) {
-          free(pkt);
+          network_free_pkt(pkt);
           continue;
         }
         //if port DNE or not an unbound port, fail
         if (miniport_array[dst_port_num] == NULL ||
             miniport_array[dst_port_num]->p_type != UNBOUND_PORT) {
-          free(pkt);
+          network_free_pkt(pkt);
           continue;
         }
         dst_port = miniport_array[dst_port_num]; 
-        semaphore_P(dst_port->u.unbound.q_lock);
+        mutex_lock(dst_port->u.unbound.q_lock);
         queue_append(dst_port->u.unbound.port_pkt_q,pkt);
-        semaphore_V(dst_port->u.unbound.q_lock);
+        mutex_unlock(dst_port->u.unbound.q_lock);
         semaphore_V(dst_port->u.unbound.port_pkt_available_sem);
         continue;
       }
       else if (protocol == PROTOCOL_MINISTREAM) {
-        free(pkt);
+        network_free_pkt(pkt);
         continue; //for now, ignore tcp packets
       }
     }
@@ -201,10 +199,10 @@ miniport_create_unbound(int port_number) {
   if (miniport_array[port_number]) {
     return miniport_array[port_number];
   }
-  semaphore_P(unbound_ports_lock);
+  mutex_lock(unbound_ports_lock);
   new_port = (miniport_t)malloc(sizeof(struct miniport)); 
   if (new_port == NULL) {
-    semaphore_V(unbound_ports_lock);
+    mutex_unlock(unbound_ports_lock);
     return NULL;
   }
   new_port->p_type = UNBOUND_PORT;
@@ -212,28 +210,27 @@ miniport_create_unbound(int port_number) {
   new_port->u.unbound.port_pkt_q = queue_new();
   if (!new_port->u.unbound.port_pkt_q) {
     free(new_port);
-    semaphore_V(unbound_ports_lock);
+    mutex_unlock(unbound_ports_lock);
     return NULL;
   }
   new_port->u.unbound.port_pkt_available_sem = semaphore_create();
   if (!new_port->u.unbound.port_pkt_available_sem) {
     queue_free(new_port->u.unbound.port_pkt_q);
     free(new_port);
-    semaphore_V(unbound_ports_lock);
+    mutex_unlock(unbound_ports_lock);
     return NULL;
   } 
-  new_port->u.unbound.q_lock = semaphore_create();
+  new_port->u.unbound.q_lock = mutex_create();
   if (!new_port->u.unbound.q_lock) {
     queue_free(new_port->u.unbound.port_pkt_q);
     semaphore_destroy(new_port->u.unbound.port_pkt_available_sem);
     free(new_port);
-    semaphore_V(unbound_ports_lock);
+    mutex_unlock(unbound_ports_lock);
     return NULL;
   }
   semaphore_initialize(new_port->u.unbound.port_pkt_available_sem,0);
-  semaphore_initialize(new_port->u.unbound.q_lock,1);
   miniport_array[port_number] = new_port;
-  semaphore_V(unbound_ports_lock);
+  mutex_unlock(unbound_ports_lock);
   return new_port;
    
 }
@@ -252,7 +249,7 @@ miniport_create_bound(network_address_t addr, int remote_unbound_port_number)
   unsigned int start;
   miniport_t new_port;
 
-  semaphore_P(bound_ports_lock);
+  mutex_lock(bound_ports_lock);
   start = curr_bound_index;
   while (miniport_array[curr_bound_index] != NULL){
     curr_bound_index++;
@@ -260,13 +257,13 @@ miniport_create_bound(network_address_t addr, int remote_unbound_port_number)
       curr_bound_index = BOUND_PORT_START;
     }
     if (curr_bound_index == start){ //bound port array full
-      semaphore_V(bound_ports_lock);
+      mutex_unlock(bound_ports_lock);
       return NULL;
     }
   }
   new_port = (miniport_t)malloc(sizeof(struct miniport)); 
   if (new_port == NULL) {
-    semaphore_V(bound_ports_lock);
+    mutex_unlock(bound_ports_lock);
     return NULL;
   }
   new_port->p_type = BOUND_PORT;
@@ -278,7 +275,7 @@ miniport_create_bound(network_address_t addr, int remote_unbound_port_number)
   if (curr_bound_index >= MAX_PORT_NUM){
     curr_bound_index = BOUND_PORT_START;
   }
-  semaphore_V(bound_ports_lock);
+  mutex_unlock(bound_ports_lock);
   return new_port;
 }
 
@@ -294,19 +291,19 @@ miniport_destroy(miniport_t miniport)
     return;
   }
   if (miniport->p_type == UNBOUND_PORT) {
-    semaphore_P(unbound_ports_lock);
+    mutex_lock(unbound_ports_lock);
     miniport_array[miniport->p_num] = NULL;
     queue_free(miniport->u.unbound.port_pkt_q);
     semaphore_destroy(miniport->u.unbound.port_pkt_available_sem);
-    semaphore_destroy(miniport->u.unbound.q_lock);
+    mutex_destroy(miniport->u.unbound.q_lock);
     free(miniport);
-    semaphore_V(unbound_ports_lock);
+    mutex_unlock(unbound_ports_lock);
   } 
   else {
-    semaphore_P(bound_ports_lock);
+    mutex_lock(bound_ports_lock);
     miniport_array[miniport->p_num] = NULL;
     free(miniport);
-    semaphore_V(bound_ports_lock);
+    mutex_unlock(bound_ports_lock);
   }
 }
 
@@ -316,13 +313,14 @@ miniport_destroy(miniport_t miniport)
  * system, it needs to know the sender's listening port (specified by local_unbound_port).
  * The msg parameter is a pointer to a data payload that the user wishes to send and does not
  * include a network header; your implementation of minimsg_send must construct the header
- * before calling miniroute_send_pkt(). The return value of this function is the number of
+ * before calling miniroute_send_pktv(). The return value of this function is the number of
  * data payload bytes sent not inclusive of the header. Returns -1 on error.
  * Fails if msg is too long. 
  */
 int
 minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, minimsg_t msg, int len) {
   struct mini_header hdr;
+  struct iovec iov[2];
   network_address_t dst_addr;
   
   if (len > MINIMSG_MAX_MSG_SIZE) {
@@ -351,7 +349,12 @@ minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, minimsg
   pack_address(hdr.destination_address, local_bound_port->u.bound.dest_addr);
   pack_unsigned_short(hdr.destination_port, local_bound_port->u.bound.dest_num);
   
-  if (miniroute_send_pkt(dst_addr, sizeof(hdr), (char*)&hdr, len, msg)) {
+  //the message goes out from the caller's buffer, behind the header
+  iov[0].iov_base = (char*)&hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = msg;
+  iov[1].iov_len = len;
+  if (miniroute_send_pktv(dst_addr, iov, 2) == -1) {
     return -1;
   }
   return len;
@@ -384,14 +387,14 @@ int minimsg_receive(miniport_t local_unbound_port, miniport_t* new_local_bound_p
   //block until packet arrives
   semaphore_P(local_unbound_port->u.unbound.port_pkt_available_sem);
 
-  semaphore_P(local_unbound_port->u.unbound.q_lock);
+  mutex_lock(local_unbound_port->u.unbound.q_lock);
   if( queue_dequeue(local_unbound_port->u.unbound.port_pkt_q,
                   (void**)&pkt)){
     return -1;
   }
-  semaphore_V(local_unbound_port->u.unbound.q_lock);
+  mutex_unlock(local_unbound_port->u.unbound.q_lock);
 
-  pkt_header = (mini_header_t)(&pkt->buffer);
+  pkt_header = (mini_header_t)pkt->data;
   protocol = pkt_header->protocol;
   unpack_address(pkt_header->source_address, src_addr);
   src_port = unpack_unsigned_short(pkt_header->source_port);
@@ -411,13 +414,12 @@ int minimsg_receive(miniport_t local_unbound_port, miniport_t* new_local_bound_p
                   *len : pkt->size-sizeof(struct mini_header);
     *new_local_bound_port = miniport_create_bound(pkt->sender, src_port);
     //copy payload
-    buff = (char*)&(pkt->buffer);
-    buff += sizeof(struct mini_header);
+    buff = network_pkt_pull(pkt, sizeof(struct mini_header));
     for (i = 0; i < *len; i++){
       msg[i] = *buff;
       buff++;
     }
-    free(pkt); 
+    network_free_pkt(pkt); 
     return *len;
   }
 }
@@ -7,6 +7,8 @@
 #include "miniheader.h"
 #include "network.h"
 
+#define DISCOVERY_RESEND_TIME 12000 //milliseconds
+
 /* TYPE DEFS
  */
 typedef struct resend_arg* resend_arg_t;
@@ -16,7 +18,7 @@ typedef struct resend_arg* resend_arg_t;
  */
 typedef struct discover_control_block {
   int count; //how many threads request this ip addr
-  semaphore_t mutex;
+  mutex_t mutex;
   semaphore_t route_ready;
   alarm_t resend_alarm;
   resend_arg_t alarm_arg;
@@ -77,7 +79,9 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
     return 0;
   }
   
-  pkt_hdr = (struct routing_header*)pkt->buffer;
+  //step past the routing header; a forwarded packet gets it back
+  pkt_hdr = (struct routing_header*)pkt->data;
+  network_pkt_pull(pkt, sizeof(struct routing_header));
   unpack_address(pkt_hdr->destination, dst_addr);
   discovery_pkt_id = unpack_unsigned_int(pkt_hdr->id);
   pkt_ttl = unpack_unsigned_int(pkt_hdr->ttl);
@@ -96,7 +100,7 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
       }
       new_route = (network_address_t*)calloc(path_len, sizeof(network_address_t));
       if (new_route == NULL) {
-        free(pkt);
+        network_free_pkt(pkt);
         //printf("exiting miniroute_process_packet on CALLOC ERROR\n");
         return 0;
       }
@@ -106,7 +110,7 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
       }
       new_path = (miniroute_t)calloc(1, sizeof(struct miniroute));
       if (new_path == NULL) {
-        free(pkt);
+        network_free_pkt(pkt);
         free(new_route);
         //printf("exiting miniroute_process_packet on CALLOC ERROR\n");
         return 0;
@@ -117,7 +121,7 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
     } //added new route to cache
   }
   else if (pkt_ttl <= 0) {
-    free(pkt);
+    network_free_pkt(pkt);
     //printf("exiting miniroute_process_packet on TTL ERROR\n");
     return 0;
   }
@@ -135,7 +139,7 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
       }
     }
     if (!found) {
-      free(pkt);
+      network_free_pkt(pkt);
       return 0;
     }
   }
@@ -153,7 +157,9 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
       //skip destination, shouldn't change
       //skip id, shouldn't change
       pack_unsigned_int(pkt_hdr->ttl, pkt_ttl - 1); //subtract ttl
-      network_send_pkt(nxt_addr, sizeof(struct routing_header), (char*)pkt_hdr, 0, &tmp);
+      //pass the whole packet on, header, data and all
+      network_pkt_push(pkt, sizeof(struct routing_header));
+      network_send_pkt(nxt_addr, pkt->size, pkt->data, 0, &tmp);
     }
     break;
 
@@ -185,7 +191,7 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
       for (i = 0; i < path_len - 1; i++) {
         unpack_address(pkt_hdr->path[i], tmp_addr);
         if (network_compare_network_addresses(my_addr, tmp_addr)) {
-          free(pkt);
+          network_free_pkt(pkt);
          // printf("exiting miniroute_process_packet on BROADCAST LOOP\n");
           return 0;
         }
@@ -239,16 +245,20 @@ int miniroute_process_packet(network_interrupt_arg_t* pkt) {
     break;
   }    
   //printf("exiting miniroute_process_packet on SUCCESS\n"); 
-  free(pkt);
+  network_free_pkt(pkt);
   return 0;
 }
 
-/* Note: alarm function, so called with interrupts disabled.
+/* Note: alarm function, so called with interrupts enabled. It disables
+ * them for all of its run: params is on the stack of the thread discovering
+ * the route.
  */
 void miniroute_resend(void* arg) {
   char tmp;
+  interrupt_level_t l;
   resend_arg_t params = (resend_arg_t)arg;
 
+  l = set_interrupt_level(DISABLED);
   //printf("entering miniroute_resend\n");
   params->try_count++;
   if (params->try_count >= 3) {
@@ -256,14 +266,16 @@ void miniroute_resend(void* arg) {
     params->control_block->resend_alarm = NULL;
     params->control_block->alarm_arg = NULL;
     semaphore_V(params->control_block->route_ready); 
+    set_interrupt_level(l);
     return; 
   }
   //assign fresh id
   pack_unsigned_int(params->hdr->id, curr_discovery_pkt_id++);
   //printf("sending another DISCOVERY pkt\n");
   network_bcast_pkt(sizeof(struct routing_header), (char*)(params->hdr), 0, &tmp);
-  params->control_block->resend_alarm = set_alarm(120, miniroute_resend, 
-      params->control_block->alarm_arg, minithread_time());  
+  params->control_block->resend_alarm = register_alarm(DISCOVERY_RESEND_TIME, miniroute_resend, 
+      params->control_block->alarm_arg);  
+  set_interrupt_level(l);
 }
 
 /* Returns the route to dest or NULL on failure.
@@ -291,7 +303,7 @@ miniroute_t miniroute_discover_route(network_address_t dest) {
       return NULL;
     }
     control_block->count = 0;
-    control_block->mutex = semaphore_create();
+    control_block->mutex = mutex_create();
     if (!control_block->mutex) {
       free(control_block);
       set_interrupt_level(l);
@@ -299,12 +311,11 @@ miniroute_t miniroute_discover_route(network_address_t dest) {
     }
     control_block->route_ready = semaphore_create();
     if (!control_block->route_ready) {
+      mutex_destroy(control_block->mutex);
       free(control_block);
-      semaphore_destroy(control_block->mutex);
       set_interrupt_level(l);
       return NULL;
     }
-    semaphore_initialize(control_block->mutex, 1);
     semaphore_initialize(control_block->route_ready, 0);
     control_block->resend_alarm = NULL;
     control_block->alarm_arg = NULL;
@@ -321,12 +332,12 @@ miniroute_t miniroute_discover_route(network_address_t dest) {
   control_block->count++;
   set_interrupt_level(l);
   
-  semaphore_P(control_block->mutex);
+  mutex_lock(control_block->mutex);
   path = miniroute_cache_get(route_cache, dest);
   if (path) {
     l = set_interrupt_level(DISABLED);
     control_block->count--;
-    semaphore_V(control_block->mutex);
+    mutex_unlock(control_block->mutex);
     set_interrupt_level(l);
     //printf("exiting miniroute_discover_route on SUCCESS\n"); 
     return path;
@@ -349,19 +360,19 @@ miniroute_t miniroute_discover_route(network_address_t dest) {
     if (network_bcast_pkt(sizeof(struct routing_header), (char*)(&hdr), 0, &tmp) == -1) {
       //error
       control_block->count--;
-      semaphore_V(control_block->mutex);
+      mutex_unlock(control_block->mutex);
       set_interrupt_level(l);
       return NULL;
     } 
-    control_block->resend_alarm = set_alarm(120, miniroute_resend, 
-        control_block->alarm_arg, minithread_time());  
+    control_block->resend_alarm = register_alarm(DISCOVERY_RESEND_TIME, miniroute_resend, 
+        control_block->alarm_arg);  
     set_interrupt_level(l);
     semaphore_P(control_block->route_ready); 
     //got a reply pkt or timed out
     path = miniroute_cache_get(route_cache, dest);
     l = set_interrupt_level(DISABLED);
     control_block->count--;
-    semaphore_V(control_block->mutex);
+    mutex_unlock(control_block->mutex);
     set_interrupt_level(l);
     //printf("exiting miniroute_discover_route on SUCCESS\n"); 
     return path;
@@ -373,19 +384,29 @@ miniroute_t miniroute_discover_route(network_address_t dest) {
  */
 int miniroute_send_pkt(network_address_t dest_address, int hdr_len, 
                         char* hdr, int data_len, char* data) {
+  struct iovec iov[2];
+
+  if (hdr_len < 0 || data_len < 0 || hdr == NULL || data == NULL) {
+    return -1;
+  }
+  iov[0].iov_base = hdr;
+  iov[0].iov_len = hdr_len;
+  iov[1].iov_base = data;
+  iov[1].iov_len = data_len;
+  return miniroute_send_pktv(dest_address, iov, 2);
+}
+
+int miniroute_send_pktv(network_address_t dest_address, struct iovec* iov, int iovcnt) {
   interrupt_level_t l;
   miniroute_t path;
   dcb_t control_block;
   struct routing_header new_hdr;
+  struct iovec pktv[NETWORK_MAX_IOV];
   int i;
   int path_len;
-  int new_data_len;
-  char* new_data;
   int bytes_sent;
   
-  //printf("entering miniroute_send_pkt\n");
-  if (hdr_len < 0 || data_len < 0 || hdr == NULL || data == NULL) {
-    //printf("invalid params\n");
+  if (iov == NULL || iovcnt < 0 || iovcnt >= NETWORK_MAX_IOV) {
     return -1;
   }
   path = miniroute_discover_route(dest_address);
@@ -398,7 +419,7 @@ int miniroute_send_pkt(network_address_t dest_address, int hdr_len,
   control_block = hash_table_get(dcb_table, dest_address);
   if (control_block != NULL && control_block->count == 0) {
     //no threads are blocked on route. cleanup
-    semaphore_destroy(control_block->mutex); 
+    mutex_destroy(control_block->mutex); 
     semaphore_destroy(control_block->route_ready);
     hash_table_remove(dcb_table, dest_address);
     free(control_block);
@@ -421,21 +442,17 @@ int miniroute_send_pkt(network_address_t dest_address, int hdr_len,
   for (i = 0; i < path_len; i++) {
     pack_address(new_hdr.path[i], path->route[i]);
   }
-  new_data_len = hdr_len + data_len;
-  new_data = (char*)malloc(new_data_len);
-  memcpy(new_data, hdr, hdr_len);
-  memcpy(new_data+hdr_len, data, data_len);
-  bytes_sent = network_send_pkt(path->route[1], sizeof(struct routing_header), 
-      (char*)&new_hdr, new_data_len, new_data);
-  free(new_data);
-  if ((bytes_sent - hdr_len) < 0) {
-    //printf("exiting miniroute_send_pkt on FAILURE\n");
-    return -1;
+  //the routing header goes in front, the rest is sent from where it is
+  pktv[0].iov_base = (char*)&new_hdr;
+  pktv[0].iov_len = sizeof(struct routing_header);
+  for (i = 0; i < iovcnt; i++) {
+    pktv[i + 1] = iov[i];
   }
-  else {
-    //printf("exiting miniroute_send_pkt on SUCCESS\n");
-    return (bytes_sent - hdr_len);
+  bytes_sent = network_send_pktv(path->route[1], pktv, iovcnt + 1);
+  if (bytes_sent < (int)sizeof(struct routing_header)) {
+    return -1;
   }
+  return bytes_sent - sizeof(struct routing_header);
 }
 
 
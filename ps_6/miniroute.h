@@ -51,10 +51,17 @@ void miniroute_initialize();
  */
 int miniroute_send_pkt(network_address_t dest_address, int hdr_len, char* hdr, int data_len, char* data);
 
+/* The same, for a packet in iovcnt fragments (at most NETWORK_MAX_IOV - 1, since the routing header
+ * goes in front of them), which are handed to the network as they are, without being copied together.
+ * Returns the number of bytes in the fragments if they were sent, -1 otherwise.
+ */
+int miniroute_send_pktv(network_address_t dest_address, struct iovec* iov, int iovcnt);
+
 
 /* Takes in a routing packet and does error checking.
  * Adds it to the cache if this packet was destined for us. 
- * Returns 1 if this packet has data to be passed along,
+ * Returns 1 if this packet has data to be passed along, with the
+ * routing header pulled off it (see network_pkt_pull),
  * O otherwise.
  */
 int miniroute_process_packet(network_interrupt_arg_t* pkt);
@@ -2,8 +2,9 @@
 #include "miniroute_cache.h"
 #include "interrupts.h"
 #include "minithread.h"
+#include "slab.h"
 
-#define CACHE_TIME 30.0f //3 seconds = 100 milliseconds(cycle time) * 30
+#define CACHE_TIME 3000 //3 seconds, in milliseconds
 
 //node type for storing addresses
 typedef struct dlink_node{
@@ -12,6 +13,8 @@ typedef struct dlink_node{
   network_address_t key; //making specific data type to avoid casting void*'s
 }* dlink_node_t;
 
+static slab_cache dlink_node_cache = SLAB_CACHE_INIT("route cache node", struct dlink_node);
+
 //doubly linked list type
 struct dlink_list{
   dlink_node_t hd;
@@ -78,7 +81,7 @@ void miniroute_cache_destroy(miniroute_cache_t route_cache){
     free(hash_table_get(route_cache->cache_table, curr_node->key));
     hash_table_remove(route_cache->cache_table, curr_node->key);
     tmp = curr_node->next;
-    free(curr_node);
+    slab_free(&dlink_node_cache, curr_node);
     curr_node = tmp;
   }
   hash_table_destroy(route_cache->cache_table);
@@ -94,13 +97,17 @@ int miniroute_cache_size(miniroute_cache_t route_cache){
 
 /* destroys an entry from the hashtable,
  * removes the node in the cache's list
- * with it.*/
+ * with it. It is an alarm function, so it
+ * disables interrupts itself.*/
 void destroy_entry(void* arg){
+  interrupt_level_t l;
   cache_alarm_arg_t entry_alarm;
   dlink_node_t delete_node;
   cache_entry_t delete_entry;
   //printf("cache entry being deleted\n");
 
+  l = set_interrupt_level(DISABLED);
+
   entry_alarm = (cache_alarm_arg_t)arg; //alarm info stored
   delete_node = entry_alarm->node; //node to be removed from cache list
   delete_entry = hash_table_get(entry_alarm->route_cache->cache_table, delete_node->key);
@@ -110,7 +117,7 @@ void destroy_entry(void* arg){
   if (delete_node->next == NULL || delete_node->prev == NULL){
     //check if this is a single node list
     if (entry_alarm->route_cache->cache_list.len == 1){
-      free(delete_node);
+      slab_free(&dlink_node_cache, delete_node);
       free(delete_entry->route->route);
       free(delete_entry->route);
       free(delete_entry);
@@ -121,7 +128,7 @@ void destroy_entry(void* arg){
       if (delete_node->next == NULL){ //tail
         delete_node->prev->next = NULL;
         entry_alarm->route_cache->cache_list.tl = delete_node->prev;
-        free(delete_node);
+        slab_free(&dlink_node_cache, delete_node);
         free(delete_entry->route->route);
         free(delete_entry->route);
         free(delete_entry);
@@ -129,7 +136,7 @@ void destroy_entry(void* arg){
       else { //head
         delete_node->next->prev = NULL;
         entry_alarm->route_cache->cache_list.hd = delete_node->next;
-        free(delete_node);
+        slab_free(&dlink_node_cache, delete_node);
         free(delete_entry->route->route);
         free(delete_entry->route);
         free(delete_entry);
@@ -139,13 +146,14 @@ void destroy_entry(void* arg){
   else { //node is somewhere in middle of list
     delete_node->prev->next = delete_node->next;
     delete_node->next->prev = delete_node->prev;
-    free(delete_node);
+    slab_free(&dlink_node_cache, delete_node);
     free(delete_entry->route->route);
     free(delete_entry->route);
     free(delete_entry);
   }
   (entry_alarm->route_cache->cache_list.len)--;
   free(entry_alarm);
+  set_interrupt_level(l);
   return;
 }
 
@@ -196,7 +204,7 @@ int miniroute_cache_put(miniroute_cache_t route_cache, network_address_t key, mi
   }
   //create new node
   tmp = NULL;
-  tmp = (dlink_node_t)calloc(1, sizeof(struct dlink_node));
+  tmp = (dlink_node_t)slab_alloc(&dlink_node_cache);
   if (!tmp){
     free(new_entry);
     set_interrupt_level(l);
@@ -207,7 +215,7 @@ int miniroute_cache_put(miniroute_cache_t route_cache, network_address_t key, mi
   new_alarm = (cache_alarm_arg_t)calloc(1, sizeof(struct cache_alarm_arg));
   if (!new_alarm){
     free(new_entry);
-    free(tmp);
+    slab_free(&dlink_node_cache, tmp);
     set_interrupt_level(l);
     return -1;
   }
@@ -230,10 +238,10 @@ int miniroute_cache_put(miniroute_cache_t route_cache, network_address_t key, mi
   new_alarm->node = tmp; //save node info to arg
 
   //register the alarm
-  new_entry->route_alarm = set_alarm(CACHE_TIME, destroy_entry, (void*)new_alarm, minithread_time());
+  new_entry->route_alarm = register_alarm(CACHE_TIME, destroy_entry, (void*)new_alarm);
   if (!(new_entry->route_alarm)){
     free(new_entry);
-    free(tmp);
+    slab_free(&dlink_node_cache, tmp);
     free(new_alarm);
     set_interrupt_level(l);
     return -1;
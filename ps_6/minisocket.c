@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "miniroute.h"
+#include "slab.h"
 
 typedef enum state {LISTEN = 1, CONNECTING, CONNECT_WAIT, MSG_WAIT, 
     CLOSE_SEND, CLOSE_RCV, CONNECTED, EXIT} state;
@@ -19,7 +20,7 @@ struct minisocket
   alarm_t resend_alarm; 
   semaphore_t pkt_ready_sem; 
   semaphore_t ack_ready_sem;
-  semaphore_t sock_lock; //all mighty sock lock
+  mutex_t sock_lock; //all mighty sock lock
   queue_t pkt_q;
   unsigned short src_port;
   network_address_t dst_addr;
@@ -34,9 +35,11 @@ typedef struct resend_arg {
   minisocket_error *error;
 }* resend_arg_t;
 
+static slab_cache socket_cache = SLAB_CACHE_INIT("minisocket", struct minisocket);
+
 minisocket_t* sock_array;
-semaphore_t client_lock;
-semaphore_t server_lock;
+mutex_t client_lock;
+mutex_t server_lock;
 network_address_t my_addr;
 unsigned int curr_client_idx;
 
@@ -49,13 +52,13 @@ void self_destruct(void* arg);
  * This function will be passed in to an alarm to be called later.
  * If the alarm is called, we will increment try_count, resend and set another alarm 
  * unless we have reached 7 tries, in which case we fail.
- * Note: Interrupts are disabled whenever this function is called,
- * since it is passed in as an alarm func.
+ * Note: alarm funcs run with interrupts enabled, so it disables them itself.
  */
 void minisocket_resend(void* arg);
 
 void minisocket_send_ctrl_to(char type, minisocket_t sock, minisocket_error* error, network_address_t to_addr, unsigned short to_port) {
   struct mini_header_reliable pkt;
+  struct iovec iov;
   pkt.protocol = PROTOCOL_MINISTREAM;
   pack_address(pkt.source_address, my_addr);
   pack_unsigned_short(pkt.source_port, sock->src_port);
@@ -65,8 +68,9 @@ void minisocket_send_ctrl_to(char type, minisocket_t sock, minisocket_error* err
   pack_unsigned_int(pkt.seq_number, sock->curr_seq);
   pack_unsigned_int(pkt.ack_number, sock->curr_ack);
   
-  if (miniroute_send_pkt(to_addr, sizeof(pkt), 
-      (char*)&pkt, 0, (char*)&pkt) == -1) {
+  iov.iov_base = (char*)&pkt;
+  iov.iov_len = sizeof(pkt);
+  if (miniroute_send_pktv(to_addr, &iov, 1) == -1) {
     *error = SOCKET_SENDERROR;
   }  
 }
@@ -76,11 +80,10 @@ void minisocket_send_ctrl_to(char type, minisocket_t sock, minisocket_error* err
  * This ack packet is sent over the network.
  * If there is an underlying network failure, error is updated
  * but the pkt is not resent.
- * The address of pkt is given as the data buffer, 
- * but no data from pkt is written since the data_len is 0.
  */ 
 void minisocket_send_ctrl(char type, minisocket_t sock, minisocket_error* error) {
   struct mini_header_reliable pkt;
+  struct iovec iov;
   pkt.protocol = PROTOCOL_MINISTREAM;
   pack_address(pkt.source_address, my_addr);
   pack_unsigned_short(pkt.source_port, sock->src_port);
@@ -90,14 +93,16 @@ void minisocket_send_ctrl(char type, minisocket_t sock, minisocket_error* error)
   pack_unsigned_int(pkt.seq_number, sock->curr_seq);
   pack_unsigned_int(pkt.ack_number, sock->curr_ack);
   
-  if (miniroute_send_pkt(sock->dst_addr, sizeof(pkt), 
-      (char*)&pkt, 0, (char*)&pkt) == -1) {
+  iov.iov_base = (char*)&pkt;
+  iov.iov_len = sizeof(pkt);
+  if (miniroute_send_pktv(sock->dst_addr, &iov, 1) == -1) {
     *error = SOCKET_SENDERROR;
   }  
 }
 
 /* minisocket_send_data creates a header pkt with fields taken from sock parameter.
- * The header and the data payload are sent over the network.
+ * The header and the data payload are sent over the network,
+ * the payload straight from data, without being copied.
  * If there is an underlying network failure, error is updated
  * but the pkt is not resent at this level.
  * Since this function may be called on a resend, seq_number is not automatically updated. 
@@ -105,6 +110,7 @@ void minisocket_send_ctrl(char type, minisocket_t sock, minisocket_error* error)
  */
 void minisocket_send_data(minisocket_t sock, unsigned int data_len, char* data, minisocket_error* error) {
   struct mini_header_reliable pkt;
+  struct iovec iov[2];
   pkt.protocol = PROTOCOL_MINISTREAM;
   pack_address(pkt.source_address, my_addr);
   pack_unsigned_short(pkt.source_port, sock->src_port);
@@ -114,8 +120,11 @@ void minisocket_send_data(minisocket_t sock, unsigned int data_len, char* data,
   pack_unsigned_int(pkt.seq_number, sock->curr_seq);
   pack_unsigned_int(pkt.ack_number, sock->curr_ack);
   
-  if (miniroute_send_pkt(sock->dst_addr, sizeof(pkt), 
-      (char*)&pkt, data_len, data)  == -1) {
+  iov[0].iov_base = (char*)&pkt;
+  iov[0].iov_len = sizeof(pkt);
+  iov[1].iov_base = data;
+  iov[1].iov_len = data_len;
+  if (miniroute_send_pktv(sock->dst_addr, iov, 2) == -1) {
     *error = SOCKET_SENDERROR;
   }
 }
@@ -127,12 +136,16 @@ void minisocket_send_data(minisocket_t sock, unsigned int data_len, char* data,
  * This function will be passed in to an alarm to be called later.
  * If the alarm is called, we will increment try_count, resend and set another alarm 
  * unless we have reached 7 tries, in which case we fail.
- * Note: Interrupts are disabled whenever this function is called,
- * since it is passed in as an alarm func.
+ * Note: alarm funcs run with interrupts enabled, but this one disables them
+ * for all of its run: params is on the stack of the thread waiting for the ack,
+ * which may go on as soon as the ack comes in.
  */
 void minisocket_resend(void* arg) {
-  int wait_cycles;
+  int wait_time;
+  interrupt_level_t l;
   resend_arg_t params = (resend_arg_t)arg;
+
+  l = set_interrupt_level(DISABLED);
   //printf("resend called during state %i on try %d\n", params->sock->curr_state, params->sock->try_count);
   params->sock->try_count++;
   if (params->sock->try_count >= 7) {
@@ -142,10 +155,11 @@ void minisocket_resend(void* arg) {
     semaphore_V(params->sock->ack_ready_sem);//notify to unblock
     //semaphore_V(params->sock->ack_ready_sem);//notify to unblock sender
     //semaphore_V(params->sock->ack_ready_sem);//notify to unblock close
+    set_interrupt_level(l);
     return; 
   }
   //printf("in resend_alarm, still have tries left.\n"); 
-  wait_cycles = (1 << params->sock->try_count) * RESEND_TIME_UNIT;
+  wait_time = (1 << params->sock->try_count) * RESEND_TIME_UNIT;
   switch (params->msg_type) {
   case MSG_SYN:
     minisocket_send_ctrl(MSG_SYN, params->sock, params->error);
@@ -161,11 +175,13 @@ void minisocket_resend(void* arg) {
     break;
   default:
     // error
+    set_interrupt_level(l);
     return;
   }
   //printf("Failing right after here?\n");
-  params->sock->resend_alarm = set_alarm(wait_cycles, 
-      minisocket_resend, arg, minithread_time());
+  params->sock->resend_alarm = register_alarm(wait_time, 
+      minisocket_resend, arg);
+  set_interrupt_level(l);
   //printf("exit resend. No seg fault here. Try %d\n", params->sock->try_count);
 }
 
@@ -181,19 +197,17 @@ void minisocket_initialize()
   for (i = 0; i < NUM_SOCKETS; i++) {
     sock_array[i] = NULL;
   }
-  client_lock = semaphore_create();
+  client_lock = mutex_create();
   if (!client_lock) {
     free(sock_array);
     return;
   }
-  server_lock = semaphore_create();
+  server_lock = mutex_create();
   if (!server_lock) {
     free(sock_array);
-    semaphore_destroy(client_lock);
+    mutex_destroy(client_lock);
     return;
   }
-  semaphore_initialize(client_lock, 1);
-  semaphore_initialize(server_lock, 1);
   network_get_my_address(my_addr);
   curr_client_idx = CLIENT_START;
   //printf("minisocket_initialize complete\n");
@@ -202,21 +216,21 @@ void minisocket_initialize()
 void minisocket_destroy(minisocket_t sock, minisocket_error* error){
   network_interrupt_arg_t* pkt;
 
-  semaphore_P(server_lock);
+  mutex_lock(server_lock);
   sock_array[sock->src_port] = NULL;
-  semaphore_V(server_lock);
+  mutex_unlock(server_lock);
   *error = SOCKET_NOERROR;
   //free all queued packets. interrupts not disabled
   //because socket in array set to null, network
   //handler cannot access queue
   while (queue_dequeue(sock->pkt_q,(void**)&pkt) != -1){
-    free(pkt);
+    network_free_pkt(pkt);
   }
   queue_free(sock->pkt_q);
   semaphore_destroy(sock->pkt_ready_sem);
   semaphore_destroy(sock->ack_ready_sem);
-  semaphore_destroy(sock->sock_lock);
-  free(sock);
+  mutex_destroy(sock->sock_lock);
+  slab_free(&socket_cache, sock);
 }
 
 void self_destruct(void* arg) {
@@ -251,7 +265,7 @@ minisocket_t minisocket_server_create(int port, minisocket_error *error)
   }
 
   //check port in use
-  semaphore_P(server_lock);
+  mutex_lock(server_lock);
 
   //printf("calling server_create at port %d.\n", port);
   //printf("value at port %d is %li.\n", port, (long)sock_array[port]);
@@ -259,49 +273,48 @@ minisocket_t minisocket_server_create(int port, minisocket_error *error)
     *error = SOCKET_PORTINUSE;
     return NULL;
   }
-  new_sock = (minisocket_t)malloc(sizeof(struct minisocket));
+  new_sock = (minisocket_t)slab_alloc(&socket_cache);
   if (!new_sock){
-    semaphore_V(server_lock);
+    mutex_unlock(server_lock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->pkt_ready_sem = semaphore_create();
   if (!(new_sock->pkt_ready_sem)){
-    semaphore_V(server_lock);
-    free(new_sock);
+    mutex_unlock(server_lock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->pkt_q = queue_new();
   if (!(new_sock->pkt_q)){
-    semaphore_V(server_lock);
+    mutex_unlock(server_lock);
     semaphore_destroy(new_sock->pkt_ready_sem);
-    free(new_sock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
-  new_sock->sock_lock = semaphore_create();
+  new_sock->sock_lock = mutex_create();
   if (!(new_sock->sock_lock)){
-    semaphore_V(server_lock);
-    free(new_sock->pkt_ready_sem);
+    mutex_unlock(server_lock);
+    semaphore_destroy(new_sock->pkt_ready_sem);
     queue_free(new_sock->pkt_q);
-    free(new_sock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->ack_ready_sem = semaphore_create();
   if (!(new_sock->ack_ready_sem)){
-    semaphore_V(server_lock);
+    mutex_unlock(server_lock);
     semaphore_destroy(new_sock->pkt_ready_sem);
     queue_free(new_sock->pkt_q);
-    semaphore_destroy(new_sock->sock_lock);
-    free(new_sock);
+    mutex_destroy(new_sock->sock_lock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   semaphore_initialize(new_sock->pkt_ready_sem, 0);
   semaphore_initialize(new_sock->ack_ready_sem, 0);
-  semaphore_initialize(new_sock->sock_lock, 1);
 
   new_sock->curr_state = LISTEN;
   new_sock->try_count = 0;
@@ -313,7 +326,7 @@ minisocket_t minisocket_server_create(int port, minisocket_error *error)
   network_address_blankify(new_sock->dst_addr); // not paired with client
 
   sock_array[port] = new_sock;
-  semaphore_V(server_lock);
+  mutex_unlock(server_lock);
  
   while (1) {
     // wait for MSG_SYN
@@ -329,7 +342,7 @@ minisocket_t minisocket_server_create(int port, minisocket_error *error)
       resend_alarm_arg.data_len = 0;
       resend_alarm_arg.data = &tmp; //placeholder
       resend_alarm_arg.error = error; 
-      new_sock->resend_alarm = set_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg, minithread_time());
+      new_sock->resend_alarm = register_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg);
       
       new_sock->curr_state = MSG_WAIT;
       set_interrupt_level(l);
@@ -351,7 +364,7 @@ minisocket_t minisocket_server_create(int port, minisocket_error *error)
       *error = SOCKET_SENDERROR;
       // clean out the queue
       while (queue_dequeue(new_sock->pkt_q,(void**)&pkt) != -1){
-        free(pkt);
+        network_free_pkt(pkt);
       }
       new_sock->curr_state = LISTEN;
       new_sock->curr_ack = 0;
@@ -390,7 +403,7 @@ minisocket_t minisocket_client_create(network_address_t addr, int port, minisock
     return NULL;
   }
 
-  semaphore_P(client_lock);
+  mutex_lock(client_lock);
   start = curr_client_idx;
   while (sock_array[curr_client_idx] != NULL){
     curr_client_idx++;
@@ -398,56 +411,55 @@ minisocket_t minisocket_client_create(network_address_t addr, int port, minisock
       curr_client_idx = CLIENT_START;
     }
     if (curr_client_idx == start){ // client sockets full
-      semaphore_V(client_lock);
+      mutex_unlock(client_lock);
       *error = SOCKET_NOMOREPORTS; 
       return NULL;
     }
   }
  
-  new_sock = (minisocket_t)malloc(sizeof(struct minisocket));
+  new_sock = (minisocket_t)slab_alloc(&socket_cache);
   if (!new_sock){
-    semaphore_V(client_lock);
+    mutex_unlock(client_lock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->pkt_ready_sem = semaphore_create();
   if (!(new_sock->pkt_ready_sem)){
-    semaphore_V(client_lock);
-    free(new_sock);
+    mutex_unlock(client_lock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->pkt_q = queue_new();
   if (!(new_sock->pkt_q)){
-    semaphore_V(client_lock);
+    mutex_unlock(client_lock);
     semaphore_destroy(new_sock->pkt_ready_sem);
-    free(new_sock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
-  new_sock->sock_lock = semaphore_create();
+  new_sock->sock_lock = mutex_create();
   if (!(new_sock->sock_lock)){
-    semaphore_V(client_lock);
+    mutex_unlock(client_lock);
     semaphore_destroy(new_sock->pkt_ready_sem);
     queue_free(new_sock->pkt_q);
-    free(new_sock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   new_sock->ack_ready_sem = semaphore_create();
   if (!(new_sock->ack_ready_sem)){
-    semaphore_V(client_lock);
+    mutex_unlock(client_lock);
     semaphore_destroy(new_sock->pkt_ready_sem);
     queue_free(new_sock->pkt_q);
-    semaphore_destroy(new_sock->sock_lock);
-    free(new_sock);
+    mutex_destroy(new_sock->sock_lock);
+    slab_free(&socket_cache, new_sock);
     *error = SOCKET_OUTOFMEMORY;
     return NULL;
   }
   
   semaphore_initialize(new_sock->pkt_ready_sem, 0);
   semaphore_initialize(new_sock->ack_ready_sem, 0);
-  semaphore_initialize(new_sock->sock_lock, 1);
 
   new_sock->curr_state = CONNECT_WAIT;
   new_sock->try_count = 0;
@@ -459,7 +471,7 @@ minisocket_t minisocket_client_create(network_address_t addr, int port, minisock
   network_address_copy(addr, new_sock->dst_addr);
 
   sock_array[curr_client_idx] = new_sock;
-  semaphore_V(client_lock);
+  mutex_unlock(client_lock);
  
   l = set_interrupt_level(DISABLED);
   minisocket_send_ctrl(MSG_SYN, new_sock, error);
@@ -468,7 +480,7 @@ minisocket_t minisocket_client_create(network_address_t addr, int port, minisock
   resend_alarm_arg.data_len = 0;
   resend_alarm_arg.data = &tmp; //placeholder
   resend_alarm_arg.error = error; 
-  new_sock->resend_alarm = set_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg, minithread_time());
+  new_sock->resend_alarm = register_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg);
   set_interrupt_level(l);
 
   semaphore_P(new_sock->ack_ready_sem);
@@ -591,7 +603,7 @@ int minisocket_send(minisocket_t socket, minimsg_t msg, int len, minisocket_erro
     deregister_alarm(socket->resend_alarm);
     socket->resend_alarm = NULL;
   }
-  socket->resend_alarm = set_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg, minithread_time());
+  socket->resend_alarm = register_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg);
   socket->curr_state = MSG_WAIT;
   set_interrupt_level(l);
 
@@ -637,7 +649,7 @@ int minisocket_send(minisocket_t socket, minimsg_t msg, int len, minisocket_erro
         deregister_alarm(socket->resend_alarm);
         socket->resend_alarm = NULL;
       }
-      socket->resend_alarm = set_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg, minithread_time());
+      socket->resend_alarm = register_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg);
       socket->curr_state = MSG_WAIT;
       set_interrupt_level(l);
       break;
@@ -672,37 +684,38 @@ int minisocket_receive(minisocket_t socket, minimsg_t msg, int max_len, minisock
   interrupt_level_t l;
   
   //printf("in receive!\n");
-  semaphore_P(socket->sock_lock);
+  mutex_lock(socket->sock_lock);
   semaphore_P(socket->pkt_ready_sem);
 
   l = set_interrupt_level(DISABLED);
   if (queue_dequeue(socket->pkt_q, (void**)&pkt) == -1) {
     *error = SOCKET_SENDERROR;
-    semaphore_V(socket->sock_lock);
+    mutex_unlock(socket->sock_lock);
     set_interrupt_level(l);
     return -1;
   }
 
   //printf("got my packet yo!\n");
   if (socket->curr_state == CONNECTED || socket->curr_state == MSG_WAIT) {
-    data = (char*)(pkt->buffer) + sizeof(struct mini_header_reliable);
-    data_len = pkt->size - sizeof(struct mini_header_reliable);
+    //minisocket_process_packet took the header off
+    data = pkt->data;
+    data_len = pkt->size;
     //printf("my data has len %d\n", data_len);
     if (data_len > max_len) {
       data_len = max_len;
     }
     memcpy(msg, data, data_len);
-    free(pkt);
+    network_free_pkt(pkt);
     *error = SOCKET_NOERROR; 
-    semaphore_V(socket->sock_lock);
+    mutex_unlock(socket->sock_lock);
     set_interrupt_level(l);
     //printf("got my data...VICTORY!\n");
     return data_len;
   }
   else {
-    free(pkt);
+    network_free_pkt(pkt);
     *error = SOCKET_RECEIVEERROR;
-    semaphore_V(socket->sock_lock);
+    mutex_unlock(socket->sock_lock);
     set_interrupt_level(l);
     return -1;
   }
@@ -758,7 +771,7 @@ void minisocket_close(minisocket_t socket)
     deregister_alarm(socket->resend_alarm);
   }
   socket->resend_alarm = NULL;
-  socket->resend_alarm = set_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg, minithread_time());
+  socket->resend_alarm = register_alarm(RESEND_TIME_UNIT, minisocket_resend, &resend_alarm_arg);
   //printf("in minisocket_close, set my alarm.\n");
   set_interrupt_level(l);
 
@@ -803,12 +816,12 @@ void minisocket_process_packet(void* packet) {
   int data_len;
 
   pkt = (network_interrupt_arg_t*)packet;
-  pkt_hdr = (mini_header_reliable_t)(&pkt->buffer);
+  pkt_hdr = (mini_header_reliable_t)pkt->data;
  
   //printf("in minisocket_process_packet\n");
   // error checking
   if (pkt->size < sizeof(struct mini_header_reliable)) {
-    free(pkt);
+    network_free_pkt(pkt);
     return;
   }
 
@@ -819,17 +832,19 @@ void minisocket_process_packet(void* packet) {
   seq_num = unpack_unsigned_int(pkt_hdr->seq_number);
   ack_num = unpack_unsigned_int(pkt_hdr->ack_number);
   data_len = pkt->size - sizeof(struct mini_header_reliable);
+  //leave the data for minisocket_receive, the header stays readable
+  network_pkt_pull(pkt, sizeof(struct mini_header_reliable));
   if (src_port < 0 || dst_port < 0 
         || src_port >= NUM_SOCKETS || dst_port >= NUM_SOCKETS
         || !network_compare_network_addresses(dst_addr, my_addr)){
-    free(pkt);
+    network_free_pkt(pkt);
     return;
   }
 
   error = SOCKET_NOERROR;
   sock = sock_array[dst_port];
   if (sock == NULL) {
-    free(pkt);
+    network_free_pkt(pkt);
     return;
   }
 
@@ -847,7 +862,7 @@ void minisocket_process_packet(void* packet) {
     if (type == MSG_SYN){
       minisocket_send_ctrl_to(MSG_FIN, sock, &error, src_addr, src_port);
     }
-    free(pkt);
+    network_free_pkt(pkt);
     return;
   }
 
@@ -860,7 +875,7 @@ void minisocket_process_packet(void* packet) {
         sock->dst_port = src_port;
         network_address_copy(src_addr, sock->dst_addr);
       }
-      free(pkt);
+      network_free_pkt(pkt);
       break;
     
     case CONNECTING:
@@ -876,11 +891,11 @@ void minisocket_process_packet(void* packet) {
           sock->curr_ack++;
         }
         else {
-          free(pkt);
+          network_free_pkt(pkt);
         }
       }
       else {
-        free(pkt);
+        network_free_pkt(pkt);
       }
       break;
     
@@ -897,7 +912,7 @@ void minisocket_process_packet(void* packet) {
           semaphore_V(sock->ack_ready_sem);
         }
       }       
-      free(pkt); 
+      network_free_pkt(pkt); 
       break;
     
     case MSG_WAIT:
@@ -910,10 +925,9 @@ void minisocket_process_packet(void* packet) {
           deregister_alarm(sock->resend_alarm);
           sock->resend_alarm = NULL;
         }
-        sock->resend_alarm = set_alarm(RESEND_TIME_UNIT * 150, 
+        sock->resend_alarm = register_alarm(RESEND_TIME_UNIT * 150, 
                                           self_destruct, 
-                                          (void*)sock, 
-                                          minithread_time());
+                                          (void*)sock);
         semaphore_V(sock->ack_ready_sem);//notify blocked guy
       }
       else if (type == MSG_ACK) {
@@ -930,11 +944,11 @@ void minisocket_process_packet(void* packet) {
           semaphore_V(sock->pkt_ready_sem);
         }
         else {
-          free(pkt);
+          network_free_pkt(pkt);
         }
       }
       else {
-        free(pkt);
+        network_free_pkt(pkt);
       }        
       break;
 
@@ -951,10 +965,9 @@ void minisocket_process_packet(void* packet) {
           deregister_alarm(sock->resend_alarm);
           sock->resend_alarm = NULL;
         }
-        sock->resend_alarm = set_alarm(RESEND_TIME_UNIT * 150, 
+        sock->resend_alarm = register_alarm(RESEND_TIME_UNIT * 150, 
                                           self_destruct, 
-                                          (void*)sock, 
-                                          minithread_time());
+                                          (void*)sock);
         //minisocket_send_ctrl(MSG_ACK, sock, &error);
       }
       //free(pkt);
@@ -965,7 +978,7 @@ void minisocket_process_packet(void* packet) {
         minisocket_send_ctrl(MSG_ACK, sock, &error);
         //semaphore_V(sock->ack_ready_sem);
       }
-      free(pkt);
+      network_free_pkt(pkt);
       break;
 
     case CONNECTED:
@@ -978,10 +991,9 @@ void minisocket_process_packet(void* packet) {
           deregister_alarm(sock->resend_alarm);
           sock->resend_alarm = NULL;
         }
-        sock->resend_alarm = set_alarm(RESEND_TIME_UNIT * 150, 
+        sock->resend_alarm = register_alarm(RESEND_TIME_UNIT * 150, 
                                           self_destruct, 
-                                          (void*)sock, 
-                                          minithread_time());
+                                          (void*)sock);
       }
       if (type == MSG_ACK) {
         if (ack_num == sock->curr_seq) {
@@ -1000,16 +1012,16 @@ void minisocket_process_packet(void* packet) {
           minisocket_send_ctrl(MSG_ACK, sock, &error);
         }
         else {
-          free(pkt);
+          network_free_pkt(pkt);
         }
       }
       else {
-        free(pkt);
+        network_free_pkt(pkt);
       }
       break;
 
     case EXIT: default:
-      free(pkt);
+      network_free_pkt(pkt);
       break;
     }
 }
@@ -40,7 +40,7 @@ enum minisocket_error {
 #define NUM_SOCKETS 65536
 #define SERVER_START 0
 #define CLIENT_START 32768
-#define RESEND_TIME_UNIT 1
+#define RESEND_TIME_UNIT 100 //milliseconds
 
 void minisocket_process_packet(void* packet);
 
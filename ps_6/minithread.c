@@ -14,6 +14,7 @@
 #include "synch.h"
 #include <assert.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "alarm.h"
 #include "network.h"
 #include "minimsg.h"
@@ -23,101 +24,536 @@
 #include "read_private.h"
 #include "minifile.h"
 
-#define LOWEST_PRIORITY 3
-
 typedef struct minithread {
   int id;
-  int priority;
-  int rem_quanta;
+  sched_entity sched; //scheduling state, used by the run queues
   stack_pointer_t stackbase;
   stack_pointer_t stacktop;
+  stack_pointer_t stackinit; //stacktop of the empty stack, to reuse it
+  size_t stack_size;
+  size_t guard_size;
+  char name[MINITHREAD_NAME_LEN];
   int status;
+  int processor; //processor whose run queue this thread goes on
+  struct minithread* wait_next; //links on a minithread_queue
+  struct minithread* wait_prev;
+  minithread_queue_t wait_q; //the minithread_queue this thread is on, or NULL
   char* curr_dir; //path of current directory
+  struct minithread* all_next; //on the list of all threads, for the stats
+  struct minithread* all_prev;
+  uint64_t ran_at; //stats_clock() when it last started running
+  uint64_t runnable_at; //when it went on a run queue, or 0
+  uint64_t blocked_at;
+  uint64_t cpu_time;
+  uint64_t run_wait;
+  long runs;
+  long preemptions;
+  long wakeups;
 } minithread;
 
+/*
+ * A processor is a kernel thread running minithreads. Each one has
+ * its own run queue and an idle thread to run when there is nothing
+ * else, which is never put on a run queue. An idle processor sleeps
+ * in the kernel with its clock stopped until there is work for it.
+ */
+typedef struct processor {
+  int id;
+  int runnable_count; //on runnable_q; the handoff and resume slots are not counted
+  sched_rq_t runnable_q;
+  minithread_t idle_thread;
+  pthread_t kernel_thread;
+  volatile int sleeping; //in interrupt_wait, or about to be
+  int clock_idle; //clock stopped by the idle thread
+  minithread_t handoff; //runs next, ahead of the run queue, or NULL
+  minithread_t resume; //interrupted for handoff, runs after it, or NULL
+  long switches; //context switches made on this processor
+  minithread_t running; //the thread running on it, for the stats
+  int need_resched; //a system thread was woken up here, see processor_resched
+} processor;
+
+typedef processor* processor_t;
+
 int current_id = 0; // the next thread id to be assigned
 semaphore_t id_lock = NULL;
-int runnable_count = 0;
-minithread_t current_thread = NULL;
-multilevel_queue_t runnable_q = NULL;
-queue_t blocked_q = NULL;
-semaphore_t blocked_q_lock = NULL;
-queue_t dead_q = NULL;
-semaphore_t dead_q_lock = NULL;
+volatile int runnable_count = 0; //total over all run queues, the threads idle processors can take
+int num_processors = 1;
+sched_policy_t sched_policy = SCHED_MLFQ;
+processor_t* processors = NULL;
+__thread processor_t this_processor = NULL;
+__thread minithread_t current_thread = NULL;
+minithread_queue blocked_q;
+minithread_queue dead_q;
 semaphore_t dead_sem = NULL;
+minithread_t alarm_thread = NULL; //the alarm worker
+
+/*
+ * Every thread that has not exited, and the scheduler's counters.
+ * Protected by disabling interrupts.
+ */
+minithread_t all_threads = NULL;
+int thread_count = 0;
+scheduler_stats sched_stats;
+uint64_t stats_since = 0; //clock_now() when sched_stats were last reset
+long switches_since = 0; //minithread_context_switches() then
+double stats_ns_per_tick = 1; //see stats_calibrate
+
+/*
+ * Threads that have exited, kept with their stacks for minithread_create
+ * to reuse, most recently exited (so most likely still in cache) first.
+ * Only threads that exit while this is full go to clean_up to be freed.
+ * Protected by disabling interrupts.
+ */
+#define THREAD_CACHE_SIZE 256
+#define THREAD_CACHE_PREFILL 8
+minithread_t thread_cache[THREAD_CACHE_SIZE];
+int thread_cache_len = 0;
+minithread_attr default_attr; //only threads made with these are cached
 int sys_time = 0;
+uint64_t boot_time = 0; //clock_now() at tick 0
 const int TIME_QUANTA = 100 * MILLISECOND;
 network_address_t my_addr;
 
+int scheduler();
+
 
 //getter for priority
 int minithread_priority(){
-  return current_thread->priority;
+  return current_thread->sched.level;
 }
 
 int minithread_time(){
   return sys_time;
 }
 
-int random_number(int max_num) {
-  srand(time(NULL));
-  return rand() % max_num;
+uint64_t minithread_time_ns(){
+  return clock_now() - boot_time;
+}
+
+int minithread_processor(){
+  return this_processor == NULL ? 0 : this_processor->id;
 }
 
-int choose_priority_level() {
-  int num;
-  num = random_number(100);
+long minithread_context_switches(){
+  long switches = 0;
+  int i;
 
-  if (num < 50) return 0;
-  else if (num < 75) return 1;
-  else if (num < 90) return 2;
-  else return 3;
+  for (i = 0; processors != NULL && i < num_processors; i++) {
+    switches += processors[i]->switches;
+  }
+  return switches;
 }
 
 int clean_up(){
+  interrupt_level_t l;
   minithread_t dead = NULL;
   while (1){
     semaphore_P(dead_sem);
-    semaphore_P(dead_q_lock);
-    if (queue_dequeue(dead_q, (void**)(&dead)) == -1){
-      semaphore_V(dead_q_lock);
+    l = set_interrupt_level(DISABLED);
+    dead = minithread_queue_dequeue(&dead_q);
+    if (dead == NULL){
+      set_interrupt_level(l);
       return -1;
     }
     else {
-      semaphore_V(dead_q_lock);
-      minithread_free_stack(dead->stackbase);
+      set_interrupt_level(l);
+      minithread_free_stack_size(dead->stackbase, dead->stack_size, dead->guard_size);
       free(dead);
     }
   }
   return -1;
 } 
 
+/*
+ * Wakes up a processor to run a thread just put on cpu's run queue:
+ * cpu itself if it is asleep, or else any sleeping processor, which
+ * will steal the thread.
+ */
+void processor_wake(processor_t cpu) {
+  int i;
+
+  //pairs with the barrier between setting sleeping and checking runnable_count
+  __sync_synchronize();
+  if (cpu->sleeping) {
+    interrupt_wake(cpu->kernel_thread);
+    return;
+  }
+  for (i = 0; i < num_processors; i++) {
+    if (processors[i]->sleeping) {
+      interrupt_wake(processors[i]->kernel_thread);
+      return;
+    }
+  }
+}
+
+/*
+ * The clock the stats time switches and waits with: the cycle counter
+ * where there is one, since reading the monotonic clock on every switch
+ * and wakeup costs tens of nanoseconds each time.
+ */
+static inline uint64_t stats_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int lo;
+  unsigned int hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+#else
+  return clock_now();
+#endif
+}
+
+/*
+ * Converts an interval on stats_clock to nanoseconds. Processors may
+ * read slightly different cycle counts, so an interval measured across
+ * two of them can come out negative; those count as 0.
+ */
+static inline uint64_t stats_ns(uint64_t ticks) {
+  if ((int64_t)ticks < 0) return 0;
+  return (uint64_t)(ticks * stats_ns_per_tick);
+}
+
+/*
+ * Measures stats_ns_per_tick against the monotonic clock.
+ */
+void stats_calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+  uint64_t start = clock_now();
+  uint64_t ticks = stats_clock();
+  uint64_t now;
+
+  while ((now = clock_now()) - start < MILLISECOND);
+  stats_ns_per_tick = (double)(now - start) / (stats_clock() - ticks);
+#endif
+}
+
+/*
+ * Counts a wait of t nanoseconds in one of the decade buckets.
+ */
+void stats_bucket(long* buckets, uint64_t t) {
+  uint64_t bound = MICROSECOND;
+  int bucket;
+
+  for (bucket = 0; bucket < MINITHREAD_LATENCY_BUCKETS - 1; bucket++) {
+    if (t < bound) break;
+    bound *= 10;
+  }
+  buckets[bucket]++;
+}
+
+/*
+ * Counts the wakeup of t, which is blocked and about to be made
+ * runnable, for the stats. Interrupts must be disabled.
+ */
+void stats_wakeup(minithread_t t) {
+  uint64_t now = stats_clock();
+
+  t->wakeups++;
+  sched_stats.wakeups++;
+  stats_bucket(sched_stats.block_time, stats_ns(now - t->blocked_at));
+  t->runnable_at = now;
+}
+
+/*
+ * Puts t on the run queue of its processor. why is passed on to the
+ * scheduling policy (see sched_policy.h). A system thread goes on this
+ * processor's run queue instead, and if it was woken up by a device
+ * interrupt, this processor switches to it once the handlers are done.
+ * Interrupts must be disabled.
+ */
+void processor_enqueue(minithread_t t, int why) {
+  processor_t cpu;
+
+  if (t->sched.sched_class == SCHED_SYSTEM && this_processor != NULL) {
+    t->processor = this_processor->id;
+    if (why == SCHED_WAKEUP || why == SCHED_NEW) {
+      this_processor->need_resched = 1;
+    }
+  }
+  cpu = processors[t->processor];
+  //scheduler() times the current thread, and stats_wakeup woken ones
+  if (t != current_thread && t->runnable_at == 0) {
+    t->runnable_at = stats_clock();
+  }
+  if (sched_enqueue(cpu->runnable_q, &t->sched, why) == 0) {
+    cpu->runnable_count++;
+    runnable_count++;
+    processor_wake(cpu);
+  }
+}
+
+/*
+ * Preempts the current thread if it is a user thread and a system thread
+ * is waiting on this processor's run queue, so that kernel threads woken
+ * by interrupts do not wait out a user thread's slice. Interrupts must be
+ * disabled, and are enabled on return if it switched.
+ */
+void processor_resched() {
+  if (!this_processor->need_resched) return;
+  this_processor->need_resched = 0;
+  if (current_thread == NULL || current_thread == this_processor->idle_thread ||
+      current_thread->sched.sched_class == SCHED_SYSTEM ||
+      !sched_system_waiting(this_processor->runnable_q)) {
+    return;
+  }
+  //it did not use up its slice, so it is not demoted
+  processor_enqueue(current_thread, SCHED_YIELD);
+  scheduler();
+}
+
+/*
+ * Takes the next thread off cpu's run queue and hands it to this
+ * processor, or returns NULL if cpu has nothing runnable.
+ * Interrupts must be disabled.
+ */
+minithread_t processor_dequeue(processor_t cpu) {
+  minithread_t next = NULL;
+  sched_entity_t se = NULL;
+
+  if (cpu->runnable_count == 0 ||
+      (se = sched_dequeue(cpu->runnable_q)) == NULL) {
+    return NULL;
+  }
+  next = se->thread;
+  cpu->runnable_count--;
+  runnable_count--;
+  next->processor = this_processor->id;
+  return next;
+}
+
+/*
+ * Makes t, which is blocked and on no run queue, the next thread this
+ * processor runs, ahead of its run queue, or puts it on the run queue
+ * if another thread already is, or if this processor is idle (an
+ * interrupt handler is running on its idle thread), since only threads
+ * on run queues wake it up. Interrupts must be disabled.
+ */
+void processor_handoff(minithread_t t) {
+  t->status = RUNNABLE;
+  t->processor = this_processor->id;
+  if (t->runnable_at == 0) {
+    t->runnable_at = stats_clock();
+  }
+  if (this_processor->handoff != NULL ||
+      current_thread == this_processor->idle_thread) {
+    processor_enqueue(t, SCHED_WAKEUP);
+    return;
+  }
+  this_processor->handoff = t;
+}
+
+/*
+ * Takes t out of wherever it is waiting to run: the handoff or resume
+ * slot of its processor, or that processor's run queue. Returns 0
+ * (success), or -1 if t is not waiting to run (it is running, blocked,
+ * dead or not started). Interrupts must be disabled.
+ */
+int processor_remove(minithread_t t) {
+  processor_t cpu = processors[t->processor];
+
+  if (t->status != RUNNABLE) return -1;
+  if (cpu->handoff == t) {
+    cpu->handoff = NULL;
+    return 0;
+  }
+  if (cpu->resume == t) {
+    cpu->resume = NULL;
+    return 0;
+  }
+  if (sched_remove(cpu->runnable_q, &t->sched) == -1) {
+    return -1;
+  }
+  cpu->runnable_count--;
+  runnable_count--;
+  return 0;
+}
+
+/*
+ * Picks what this processor runs next: the thread handed to it, if any,
+ * else the thread that one interrupted, unless a system thread is waiting
+ * (the handed thread may have woken it), else a thread from its own run
+ * queue, else one stolen from the other processors in turn, else its
+ * idle thread. Interrupts must be disabled.
+ */
+minithread_t processor_next_thread() {
+  minithread_t next = NULL;
+  int i;
+
+  if (this_processor->handoff != NULL) {
+    next = this_processor->handoff;
+    this_processor->handoff = NULL;
+  }
+  else if (this_processor->resume != NULL &&
+           !sched_system_waiting(this_processor->runnable_q)) {
+    next = this_processor->resume;
+    this_processor->resume = NULL;
+  }
+  if (next != NULL) {
+    return next;
+  }
+  next = processor_dequeue(this_processor);
+  for (i = 1; next == NULL && i < num_processors; i++) {
+    next = processor_dequeue(processors[(this_processor->id + i) % num_processors]);
+  }
+  if (next == NULL) {
+    next = this_processor->idle_thread;
+  }
+  return next;
+}
+
+/*
+ * Switches this processor to the next thread. The caller must already
+ * have put current_thread wherever it belongs (a run queue, a wait queue,
+ * dead_q), and interrupts must stay disabled from then until here, or
+ * another processor could start running it while it is still on our stack.
+ */
 int scheduler() {
-  int next_priority = 0;
   minithread_t next = NULL;
   minithread_t temp = NULL;
-   
+  uint64_t now;
+  uint64_t wait;
+
+  set_interrupt_level(DISABLED);
+  next = processor_next_thread();
+  temp = current_thread;
+  if (next != temp) {
+    now = stats_clock();
+    this_processor->switches++;
+    temp->cpu_time += stats_ns(now - temp->ran_at);
+    //it starts waiting now, to be woken up or to run again
+    if (temp->status == BLOCKED) temp->blocked_at = now;
+    else temp->runnable_at = now;
+    next->ran_at = now;
+    next->runs++;
+    if (next->runnable_at != 0) {
+      wait = stats_ns(now - next->runnable_at);
+      next->run_wait += wait;
+      sched_stats.total_run_wait += wait;
+      if (wait > sched_stats.max_run_wait) sched_stats.max_run_wait = wait;
+      stats_bucket(sched_stats.run_wait, wait);
+    }
+  }
+  next->runnable_at = 0;
+  this_processor->running = next;
+  current_thread = next;
+  minithread_switch(&(temp->stacktop),&(next->stacktop));
+  return 0;
+}
+
+/*
+ * Body of the alarm worker. It runs the functions of the alarms that
+ * went off with interrupts enabled, and gives up the processor whenever
+ * it has used up its budget. Once there are none left it stops, until
+ * advance_time hands it the processor again.
+ */
+int alarm_worker(int* arg) {
+  interrupt_level_t l;
+
+  while (1) {
+    if (alarm_run_due() > 0) {
+      minithread_yield();
+      continue;
+    }
+    l = set_interrupt_level(DISABLED);
+    if (alarm_due_count() == 0) {
+      minithread_stop();
+    }
+    set_interrupt_level(l);
+  }
+  return 0;
+}
+
+/*
+ * Brings sys_time up to date with the monotonic clock, and sets off the
+ * alarms due by now. If any went off and the alarm worker is stopped, it
+ * is handed this processor, like a softirq run on the way out of the
+ * interrupt. Ticks are not counted one per clock interrupt,
+ * since the clock does not tick while the processor sleeps. Only the
+ * first processor keeps time. Interrupts must be disabled.
+ */
+void advance_time() {
+  uint64_t now = clock_now();
+  int ticks = (now - boot_time) / TIME_QUANTA;
+
+  if (sys_time < ticks) {
+    sys_time = ticks;
+  }
+  if (run_alarms(now) > 0 && alarm_thread != NULL &&
+      alarm_thread->status == BLOCKED) {
+    minithread_queue_remove(alarm_thread->wait_q, alarm_thread);
+    stats_wakeup(alarm_thread);
+    processor_handoff(alarm_thread);
+  }
+}
+
+/*
+ * Runs after the device interrupt handlers, which may have woken up the
+ * packet processor or another system thread.
+ */
+void drain_handler(void* arg) {
+  processor_resched();
+}
+
+/*
+ * Stops this processor's clock ticking while it has nothing to run.
+ * Alarms still go off: the alarm timer is separate from the clock.
+ * Interrupts must be disabled.
+ */
+void processor_clock_idle() {
+  clock_set_oneshot(0);
+  this_processor->clock_idle = 1;
+}
+
+/*
+ * Starts this processor's clock ticking again, on the tick boundaries.
+ * Interrupts must be disabled.
+ */
+void processor_clock_busy() {
+  uint64_t ticks = (clock_now() - boot_time) / TIME_QUANTA;
+
+  clock_set_periodic(boot_time + (ticks + 1) * TIME_QUANTA);
+  this_processor->clock_idle = 0;
+}
+
+/*
+ * Body of a processor's idle thread: sleep in the kernel with the clock
+ * stopped until a thread is put on some processor's run queue, then go
+ * take it. Interrupts that come in while it sleeps are taken as usual
+ * (handlers run on this thread), and wake it up so it can check again.
+ */
+int idle(int* arg) {
+  interrupt_level_t l;
+
   while (1) {
-    while (runnable_count == 0) {
-      set_interrupt_level(ENABLED);
-    };
-    
-    set_interrupt_level(DISABLED);
-    //dequeue from runnable threads
-    next_priority = choose_priority_level();
-    if (multilevel_queue_dequeue(runnable_q,
-        next_priority,(void**)(&next)) != -1) {
-      runnable_count--;
-      temp = current_thread;
-      current_thread = next;
-      minithread_switch(&(temp->stacktop),&(next->stacktop));
-      return 0;
+    if (runnable_count == 0) {
+      l = set_interrupt_level(DISABLED);
+      processor_clock_idle();
+      set_interrupt_level(l);
+
+      this_processor->sleeping = 1;
+      __sync_synchronize();
+      interrupt_wait(&runnable_count);
+      this_processor->sleeping = 0;
+
+      if (this_processor->id == 0) {
+        l = set_interrupt_level(DISABLED);
+        advance_time();
+        set_interrupt_level(l);
+      }
+    }
+    if (runnable_count > 0) {
+      if (this_processor->clock_idle) {
+        l = set_interrupt_level(DISABLED);
+        processor_clock_busy();
+        set_interrupt_level(l);
+      }
+      scheduler();
     }
-    //if dead/runnable queue is empty, do nothing (idle thread)
   }
   return 0;
 }
 
+
 /*
  * A minithread should be defined either in this file or in a private
  * header file.  Minithreads have a stack pointer with to make procedure
@@ -129,11 +565,25 @@ int scheduler() {
 
 int
 minithread_exit(minithread_t completed) {
+  //stay disabled until we are off this stack, no one can reuse
+  //or free it before then
+  set_interrupt_level(DISABLED);
   current_thread->status = DEAD;
-  semaphore_P(dead_q_lock);
-  queue_append(dead_q, current_thread);
-  semaphore_V(dead_q_lock);
-  semaphore_V(dead_sem);
+  if (current_thread->all_prev == NULL) all_threads = current_thread->all_next;
+  else current_thread->all_prev->all_next = current_thread->all_next;
+  if (current_thread->all_next != NULL) {
+    current_thread->all_next->all_prev = current_thread->all_prev;
+  }
+  thread_count--;
+  if (thread_cache_len < THREAD_CACHE_SIZE &&
+      current_thread->stack_size == default_attr.stack_size &&
+      current_thread->guard_size == default_attr.guard_size) {
+    thread_cache[thread_cache_len++] = current_thread;
+  }
+  else {
+    minithread_queue_append(&dead_q, current_thread);
+    semaphore_V(dead_sem);
+  }
   scheduler();
   while(1);
   return 0;
@@ -141,40 +591,174 @@ minithread_exit(minithread_t completed) {
  
 minithread_t
 minithread_fork(proc_t proc, arg_t arg) {
+  return minithread_fork_ex(proc, arg, NULL);
+}
+
+minithread_t
+minithread_fork_ex(proc_t proc, arg_t arg, minithread_attr_t attr) {
   interrupt_level_t l;
-  minithread_t new_thread = minithread_create(proc,arg);
+  minithread_t new_thread = minithread_create_ex(proc, arg, attr);
+  if (new_thread == NULL){
+    return NULL;
+  }
   
   l = set_interrupt_level(DISABLED);
-  if(multilevel_queue_enqueue(runnable_q,
-      new_thread->priority,new_thread) == 0) {
-    runnable_count++; //add to queue
-  }
+  new_thread->processor = this_processor->id;
+  processor_enqueue(new_thread, SCHED_NEW);
   set_interrupt_level(l);
   return new_thread;
 }
 
+/*
+ * Allocates a thread and its stack, for minithread_create_ex to set up.
+ */
 minithread_t
-minithread_create(proc_t proc, arg_t arg) {
+minithread_allocate(size_t stack_size, size_t guard_size) {
   minithread_t new_thread = (minithread_t)malloc(sizeof(minithread));
   if (new_thread == NULL){
     return NULL;
   }
+
+  minithread_allocate_stack_size(&(new_thread->stackbase), &(new_thread->stacktop),
+                                 stack_size, guard_size);
+  if (new_thread->stackbase == NULL){
+    free(new_thread);
+    return NULL;
+  }
+  new_thread->stackinit = new_thread->stacktop;
+  new_thread->stack_size = stack_size;
+  new_thread->guard_size = guard_size;
+  return new_thread;
+}
+
+void
+minithread_attr_init(minithread_attr_t attr) {
+  attr->stack_size = DEFAULT_STACKSIZE;
+  attr->guard_size = sysconf(_SC_PAGESIZE);
+  attr->priority = 0;
+  attr->name = NULL;
+}
+
+minithread_t
+minithread_create(proc_t proc, arg_t arg) {
+  return minithread_create_ex(proc, arg, NULL);
+}
+
+minithread_t
+minithread_create_ex(proc_t proc, arg_t arg, minithread_attr_t attr) {
+  interrupt_level_t l;
+  minithread_t new_thread = NULL;
+
+  if (attr == NULL) {
+    attr = &default_attr;
+  }
+  if (attr->stack_size < MIN_STACKSIZE ||
+      attr->priority < 0 || attr->priority >= SCHED_LEVELS) {
+    return NULL;
+  }
+
+  if (attr->stack_size == default_attr.stack_size &&
+      attr->guard_size == default_attr.guard_size) {
+    l = set_interrupt_level(DISABLED);
+    if (thread_cache_len > 0) {
+      new_thread = thread_cache[--thread_cache_len];
+    }
+    set_interrupt_level(l);
+  }
+  if (new_thread == NULL) {
+    new_thread = minithread_allocate(attr->stack_size, attr->guard_size);
+    if (new_thread == NULL){
+      return NULL;
+    }
+  }
   
   semaphore_P(id_lock);
   new_thread->id = current_id++;
   semaphore_V(id_lock);
-  new_thread->priority = 0;
-  new_thread->rem_quanta = 1;
-  new_thread->stackbase = NULL;
-  new_thread->stacktop =  NULL;
+  sched_entity_init(&new_thread->sched, new_thread);
+  new_thread->sched.priority = attr->priority;
+  new_thread->sched.level = attr->priority;
+  new_thread->stacktop = new_thread->stackinit;
   new_thread->status = RUNNABLE;
+  new_thread->processor = 0;
+  new_thread->wait_q = NULL;
   new_thread->curr_dir = "/";
-  minithread_allocate_stack(&(new_thread->stackbase), &(new_thread->stacktop) );
+  new_thread->name[0] = '\0';
+  if (attr->name != NULL) {
+    strncpy(new_thread->name, attr->name, MINITHREAD_NAME_LEN - 1);
+    new_thread->name[MINITHREAD_NAME_LEN - 1] = '\0';
+  }
+  new_thread->ran_at = 0;
+  new_thread->runnable_at = 0;
+  new_thread->cpu_time = 0;
+  new_thread->run_wait = 0;
+  new_thread->runs = 0;
+  new_thread->preemptions = 0;
+  new_thread->wakeups = 0;
   minithread_initialize_stack(&(new_thread->stacktop), proc, arg,
                               (proc_t)minithread_exit, NULL);
+
+  l = set_interrupt_level(DISABLED);
+  new_thread->all_prev = NULL;
+  new_thread->all_next = all_threads;
+  if (all_threads != NULL) all_threads->all_prev = new_thread;
+  all_threads = new_thread;
+  thread_count++;
+  set_interrupt_level(l);
   return new_thread; 
 }
 
+void
+minithread_queue_init(minithread_queue_t q) {
+  q->head = NULL;
+  q->tail = NULL;
+  q->length = 0;
+}
+
+void
+minithread_queue_append(minithread_queue_t q, minithread_t t) {
+  t->wait_q = q;
+  t->wait_next = NULL;
+  t->wait_prev = q->tail;
+  if (q->tail == NULL) q->head = t;
+  else q->tail->wait_next = t;
+  q->tail = t;
+  q->length++;
+}
+
+/*
+ * Takes t off q, which it must be on, wherever it is.
+ */
+void
+minithread_queue_remove(minithread_queue_t q, minithread_t t) {
+  if (t->wait_prev == NULL) q->head = t->wait_next;
+  else t->wait_prev->wait_next = t->wait_next;
+  if (t->wait_next == NULL) q->tail = t->wait_prev;
+  else t->wait_next->wait_prev = t->wait_prev;
+  t->wait_q = NULL;
+  q->length--;
+}
+
+int
+minithread_queue_contains(minithread_queue_t q, minithread_t t) {
+  return t->wait_q == q;
+}
+
+minithread_t
+minithread_queue_dequeue(minithread_queue_t q) {
+  minithread_t t = q->head;
+
+  if (t != NULL) {
+    minithread_queue_remove(q, t);
+  }
+  return t;
+}
+
+int
+minithread_queue_length(minithread_queue_t q) {
+  return q->length;
+}
+
 minithread_t
 minithread_self() {
   return current_thread;
@@ -185,6 +769,11 @@ minithread_id() {
   return current_thread->id;
 }
 
+char*
+minithread_name(minithread_t t) {
+  return t->name;
+}
+
 char* minithread_get_curr_dir(){
   return current_thread->curr_dir;
 }
@@ -204,26 +793,30 @@ char* minithread_set_curr_dir(char* new_dir){
 
 void
 minithread_stop() { 
+  set_interrupt_level(DISABLED);
   current_thread->status = BLOCKED;
-  semaphore_P(blocked_q_lock);
-  queue_append(blocked_q,current_thread);
-  semaphore_V(blocked_q_lock);
+  sched_stats.blocks++;
+  minithread_queue_append(&blocked_q, current_thread);
   scheduler();
 }
 
 void
 minithread_start(minithread_t t) {
   interrupt_level_t l;
+  int why;
 
-  t->status = RUNNABLE;
-  t->priority = 0;
-  t->rem_quanta = 1;
-  
   l = set_interrupt_level(DISABLED);
-  if (multilevel_queue_enqueue(runnable_q,
-      t->priority,t) == 0) {
-    runnable_count++;
+  //threads from minithread_create have not run yet
+  why = t->status == BLOCKED ? SCHED_WAKEUP : SCHED_NEW;
+  if (t->status == BLOCKED) {
+    stats_wakeup(t);
+  }
+  t->status = RUNNABLE;
+  //stopped threads are still on blocked_q
+  if (t->wait_q != NULL) {
+    minithread_queue_remove(t->wait_q, t);
   }
+  processor_enqueue(t, why);
   set_interrupt_level(l);
 }
 
@@ -232,9 +825,10 @@ minithread_start(minithread_t t) {
  * from within a semaphore P, during which interrupts are disabled.
  * */
 void
-minithread_enqueue_and_schedule(queue_t q) {
+minithread_enqueue_and_schedule(minithread_queue_t q) {
   current_thread->status = BLOCKED;
-  queue_append(q, current_thread);
+  sched_stats.blocks++;
+  minithread_queue_append(q, current_thread);
   scheduler();
 }
 
@@ -243,88 +837,300 @@ minithread_enqueue_and_schedule(queue_t q) {
  * from within a semaphore V, during which interrupts are disabled.
  * */
 void
-minithread_dequeue_and_run(queue_t q) {
-  minithread_t blocked_thread = NULL;
-  queue_dequeue(q, (void**)(&blocked_thread) );
+minithread_dequeue_and_run(minithread_queue_t q) {
+  minithread_t blocked_thread = minithread_queue_dequeue(q);
+
   if (blocked_thread->status != BLOCKED) {
     printf("thread %d should have status BLOCKED\n", minithread_id());
   }
   minithread_start(blocked_thread);
 }
 
+/*
+ * Like minithread_dequeue_and_run, but switches to the woken thread
+ * right away, and puts current_thread on the run queue as if it had
+ * yielded. Interrupts must be disabled, and are enabled on return.
+ */
+void
+minithread_dequeue_and_switch(minithread_queue_t q) {
+  minithread_t blocked_thread = minithread_queue_dequeue(q);
+
+  stats_wakeup(blocked_thread);
+  processor_enqueue(current_thread, SCHED_YIELD);
+  processor_handoff(blocked_thread);
+  scheduler();
+}
+
 /**
- * minithread_demote_priority is called from the clock handler.
+ * minithread_preempt is called from the clock handler once the current
+ * thread has used up its slice (over is 1), or a system thread is waiting
+ * to run ahead of it (over is 0).
  * Interrupts are already disabled when this function is called so mutual exclusion gauranteed.
- * This threads priority is decreased, its quanta replenished, placed back on runnable queue
- * and the scheduler is invoked.
+ * The thread is placed back on runnable queue (where the policy may demote it,
+ * under mlfq, but only if its slice was over) and the scheduler is invoked.
  **/
 void
-minithread_demote_priority() {
-  if (current_thread->priority == LOWEST_PRIORITY);
-  else current_thread->priority++;
-  current_thread->rem_quanta = 1 << current_thread->priority;
+minithread_preempt(int over) {
+  current_thread->preemptions++;
+  sched_stats.preemptions++;
+  processor_enqueue(current_thread, over ? SCHED_PREEMPT : SCHED_YIELD);
+  scheduler();
+}
 
-  if (multilevel_queue_enqueue(runnable_q,
-      current_thread->priority,current_thread) == 0) {
-    runnable_count++;
+void
+minithread_yield() {
+  //scheduler switches away before interrupts come back on
+  set_interrupt_level(DISABLED);
+  sched_stats.yields++;
+  processor_enqueue(current_thread, SCHED_YIELD);
+  scheduler();
+}
+
+int
+minithread_yield_to(minithread_t t) {
+  //scheduler switches away before interrupts come back on
+  set_interrupt_level(DISABLED);
+  sched_stats.yields++;
+  processor_enqueue(current_thread, SCHED_YIELD);
+  if (t == current_thread || processor_remove(t) == -1) {
+    scheduler();
+    return -1;
   }
+  processor_handoff(t);
   scheduler();
+  return 0;
+}
+
+int
+minithread_set_priority(minithread_t t, int priority) {
+  interrupt_level_t l;
+
+  if (priority < 0 || priority >= SCHED_LEVELS) return -1;
+  l = set_interrupt_level(DISABLED);
+  //the system class is for kernel threads only
+  if (t->sched.sched_class == SCHED_SYSTEM) {
+    set_interrupt_level(l);
+    return -1;
+  }
+  t->sched.priority = priority;
+  set_interrupt_level(l);
+  return 0;
+}
+
+int
+minithread_get_priority(minithread_t t) {
+  return t->sched.sched_class == SCHED_SYSTEM ? MINITHREAD_PRIORITY_SYSTEM :
+      t->sched.priority;
+}
+
+int
+minithread_nice(int inc) {
+  int priority = current_thread->sched.priority + inc;
+
+  if (priority < 0) priority = 0;
+  if (priority > SCHED_LEVELS - 1) priority = SCHED_LEVELS - 1;
+  if (minithread_set_priority(current_thread, priority) == -1) return -1;
+  return priority;
 }
 
 void
-minithread_yield() {
-  interrupt_level_t l;  
+minithread_set_tickets(minithread_t t, int tickets) {
+  interrupt_level_t l;
 
-  //put current thread at end of runnable
-  current_thread->priority = 0;
-  current_thread->rem_quanta = 1;
+  if (tickets < 1) return;
+  l = set_interrupt_level(DISABLED);
+  t->sched.tickets = tickets;
+  set_interrupt_level(l);
+}
+
+void
+minithread_set_deadline(minithread_t t, int delay) {
+  interrupt_level_t l;
 
   l = set_interrupt_level(DISABLED);
-  if (multilevel_queue_enqueue(runnable_q,
-      current_thread->priority,current_thread) == 0) {
-    runnable_count++;
+  if (delay < 0) {
+    t->sched.deadline = SCHED_NO_DEADLINE;
+  }
+  else {
+    t->sched.deadline = sys_time + delay / (TIME_QUANTA/MILLISECOND);
   }
   set_interrupt_level(l);
-  //call scheduler here
-  scheduler();
+}
+
+int
+minithread_get_scheduler_stats(scheduler_stats_t stats) {
+  interrupt_level_t l;
+
+  if (stats == NULL) return -1;
+  l = set_interrupt_level(DISABLED);
+  *stats = sched_stats;
+  stats->uptime = clock_now() - stats_since;
+  stats->switches = minithread_context_switches() - switches_since;
+  set_interrupt_level(l);
+  return 0;
+}
+
+void
+minithread_reset_scheduler_stats() {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  memset(&sched_stats, 0, sizeof(sched_stats));
+  stats_since = clock_now();
+  switches_since = minithread_context_switches();
+  set_interrupt_level(l);
+}
+
+int
+minithread_get_thread_stats(thread_stats_t stats, int max) {
+  interrupt_level_t l;
+  minithread_t t;
+  int n = 0;
+  int i;
+
+  l = set_interrupt_level(DISABLED);
+  for (t = all_threads; t != NULL && n < max; t = t->all_next, n++) {
+    stats[n].id = t->id;
+    strcpy(stats[n].name, t->name);
+    stats[n].state = t->status == BLOCKED ? 'B' : 'W';
+    if (t == processors[t->processor]->idle_thread) stats[n].state = 'I';
+    for (i = 0; i < num_processors; i++) {
+      if (processors[i]->running == t) stats[n].state = 'R';
+    }
+    stats[n].processor = t->processor;
+    stats[n].priority = minithread_get_priority(t);
+    stats[n].level = t->sched.level;
+    stats[n].rem_quanta = t->sched.rem_quanta;
+    stats[n].cpu_time = t->cpu_time;
+    stats[n].run_wait = t->run_wait;
+    stats[n].runs = t->runs;
+    stats[n].preemptions = t->preemptions;
+    stats[n].wakeups = t->wakeups;
+  }
+  set_interrupt_level(l);
+  return n;
+}
+
+static int
+stats_busier(const void* a, const void* b) {
+  uint64_t x = ((thread_stats_t)a)->cpu_time;
+  uint64_t y = ((thread_stats_t)b)->cpu_time;
+
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void
+minithread_print_stats() {
+  scheduler_stats stats;
+  thread_stats_t threads;
+  char* bounds[MINITHREAD_LATENCY_BUCKETS] =
+      { "<1us", "<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s" };
+  long waits = 0;
+  int n;
+  int i;
+
+  minithread_get_scheduler_stats(&stats);
+  printf("up %.1f s on %d processors: %ld switches, %ld preemptions, "
+      "%ld yields, %ld blocks, %ld wakeups\n", stats.uptime / 1e9,
+      num_processors, stats.switches, stats.preemptions, stats.yields,
+      stats.blocks, stats.wakeups);
+  printf("ticks:");
+  for (i = 0; i < SCHED_LEVELS; i++) {
+    printf(" level %d %ld,", i, stats.ticks[i]);
+  }
+  printf(" system %ld, idle %ld\n", stats.system_ticks, stats.idle_ticks);
+  for (i = 0; i < MINITHREAD_LATENCY_BUCKETS; i++) {
+    waits += stats.run_wait[i];
+  }
+  printf("run wait: %lu us average, %lu us at worst\n",
+      (unsigned long)(waits > 0 ? stats.total_run_wait / waits / MICROSECOND : 0),
+      (unsigned long)(stats.max_run_wait / MICROSECOND));
+  printf("%8s %10s %10s\n", "", "run wait", "blocked");
+  for (i = 0; i < MINITHREAD_LATENCY_BUCKETS; i++) {
+    printf("%8s %10ld %10ld\n", bounds[i], stats.run_wait[i], stats.block_time[i]);
+  }
+
+  threads = (thread_stats_t)malloc(thread_count * sizeof(thread_stats));
+  if (threads == NULL) return;
+  n = minithread_get_thread_stats(threads, thread_count);
+  qsort(threads, n, sizeof(thread_stats), stats_busier);
+  printf("%5s %-15s %2s %3s %3s %3s %10s %5s %8s %8s %8s %10s\n", "ID", "NAME",
+      "S", "CPU", "PRI", "LVL", "TIME(ms)", "%CPU", "RUNS", "PREEMPT",
+      "WAKEUPS", "WAIT(ms)");
+  for (i = 0; i < n; i++) {
+    printf("%5d %-15s %2c %3d %3d %3d %10.1f %5.1f %8ld %8ld %8ld %10.1f\n",
+        threads[i].id, threads[i].name, threads[i].state, threads[i].processor,
+        threads[i].priority, threads[i].level, threads[i].cpu_time / 1e6,
+        100.0 * threads[i].cpu_time / (clock_now() - boot_time),
+        threads[i].runs, threads[i].preemptions, threads[i].wakeups,
+        threads[i].run_wait / 1e6);
+  }
+  free(threads);
 }
 
 /*
  * This is the clock interrupt handling routine.
  * You have to call minithread_clock_init with this
  * function as parameter in minithread_system_initialize.
- * If this thread has exhausted its quanta, this its priority is decreased
- * and the scheduler is invoked. In this case, interrupts are not re-enabled in this function
+ * Every processor has a clock, but only the first one keeps the system time,
+ * and it goes by the monotonic clock rather than by counting interrupts.
+ * The first processor also takes the alarm timer's interrupts here, with
+ * arg CLOCK_ALARM.
+ * If advance_time handed the processor to the alarm worker, the worker
+ * runs now, and the current thread carries on with its slice after it,
+ * unless the slot for that is taken (it is a system thread run ahead of
+ * the thread in it), in which case it goes back on the run queue.
+ * If the scheduling policy says this thread's slice is over, or a system
+ * thread is waiting to run ahead of it, it is preempted (demoted only in
+ * the first case) and the scheduler is invoked. In this case, interrupts are not re-enabled in this function
  * but when the scheduler switches to another thread.
  */
 void 
 clock_handler(void* arg) {
   interrupt_level_t l;
+  int tick;
 
   l = set_interrupt_level(DISABLED);
-  sys_time += 1;
-  execute_alarms(sys_time);
-  if (--(current_thread->rem_quanta) == 0) {
-    minithread_demote_priority();
+  if (this_processor->id == 0) {
+    advance_time();
+  }
+  if (this_processor->handoff != NULL &&
+      current_thread != this_processor->idle_thread) {
+    //a system thread may be running ahead of the one already in resume
+    if (this_processor->resume == NULL) {
+      this_processor->resume = current_thread;
+    }
+    else {
+      processor_enqueue(current_thread, SCHED_YIELD);
+    }
+    scheduler();
+    return;
+  }
+  //the alarm timer only runs alarms, it is not a tick of the slice
+  if (arg == CLOCK_ALARM) {
+    set_interrupt_level(l);
+    return;
+  }
+  this_processor->need_resched = 0;
+  if (current_thread == this_processor->idle_thread) {
+    sched_stats.idle_ticks++;
+  }
+  else if (current_thread->sched.sched_class == SCHED_SYSTEM) {
+    sched_stats.system_ticks++;
+  }
+  else {
+    sched_stats.ticks[current_thread->sched.level]++;
+  }
+  if (current_thread != this_processor->idle_thread &&
+      (tick = sched_tick(this_processor->runnable_q, &current_thread->sched))
+      != SCHED_TICK_RUN) {
+    minithread_preempt(tick == SCHED_TICK_OVER);
   }
   else {
     set_interrupt_level(l);
   }
 }
 
-/*
- * shift contents of buf to the LEFT by offset bytes.
- * The number of contents shifted is denoted by
- * bytes_shifted
- * */
-void shift_by_n(char* buf, int offset, int bytes_shifted){
-  int i;
-  
-  for (i = 0; i < bytes_shifted; i++){
-    buf[i] = buf[i+offset];
-  }
-  return;
-}
 
 /**
  *  Network handler function which gets called whenever packet
@@ -337,7 +1143,6 @@ network_handler(network_interrupt_arg_t* pkt){
   interrupt_level_t l;
   mini_header_t pkt_hdr;
   char protocol;
-  char* buf_ptr;
   
   l = set_interrupt_level(DISABLED);
   //printf("in network_handler\n");
@@ -351,13 +1156,8 @@ network_handler(network_interrupt_arg_t* pkt){
   if (miniroute_process_packet(pkt)){
     //printf("PACKET IS HURRR\n");
  
-    //pass packet on to tcp/udp 
-    buf_ptr = pkt->buffer;
-    //shift contents of pkt buf to overwrite router headers
-    shift_by_n(buf_ptr, sizeof(struct routing_header ), (pkt->size - sizeof(struct routing_header)) );
-    (pkt->size) -= sizeof(struct routing_header);
-    
-    pkt_hdr = (mini_header_t)(&pkt->buffer);
+    //pass packet on to tcp/udp, already past the router header
+    pkt_hdr = (mini_header_t)pkt->data;
     protocol = pkt_hdr->protocol;
    
     if (protocol == PROTOCOL_MINIDATAGRAM) {
@@ -376,7 +1176,7 @@ network_handler(network_interrupt_arg_t* pkt){
       set_interrupt_level(l);
     }
     else {
-      free(pkt);
+      network_free_pkt(pkt);
       set_interrupt_level(l);
     }   
   }
@@ -396,17 +1196,74 @@ wake_up(void* sem){
  */
 void 
 minithread_sleep_with_timeout(int delay){
-  semaphore_t thread_sem;
-  int num_cycles;
+  minithread_sleep_ns((uint64_t)delay * MILLISECOND);
+}
 
-  num_cycles = delay % (TIME_QUANTA/MILLISECOND) == 0? delay/(TIME_QUANTA/MILLISECOND) : delay / (TIME_QUANTA/MILLISECOND) + 1;
+void
+minithread_sleep_ns(uint64_t delay){
+  semaphore_t thread_sem;
 
   thread_sem = semaphore_create();
-  set_alarm(num_cycles, wake_up, (void*)thread_sem, sys_time);
+  set_alarm_at(clock_now() + delay, wake_up, (void*)thread_sem);
   semaphore_P(thread_sem);
   semaphore_destroy(thread_sem);
 }
 
+void
+minithread_set_processors(int n) {
+  if (n >= 1) {
+    num_processors = n;
+  }
+}
+
+int
+minithread_num_processors() {
+  return num_processors;
+}
+
+void
+minithread_set_scheduler(sched_policy_t policy) {
+  if (policy >= SCHED_MLFQ && policy <= SCHED_EDF) {
+    sched_policy = policy;
+  }
+}
+
+/*
+ * Makes a kernel thread named name, in the system class, and starts it.
+ */
+minithread_t
+minithread_fork_system(proc_t proc, char* name) {
+  minithread_attr attr;
+  minithread_t t;
+
+  minithread_attr_init(&attr);
+  attr.name = name;
+  t = minithread_create_ex(proc, NULL, &attr);
+  if (t != NULL) {
+    t->sched.sched_class = SCHED_SYSTEM;
+    processor_enqueue(t, SCHED_NEW);
+  }
+  return t;
+}
+
+/*
+ * Entry point of the kernel thread behind every processor but the first.
+ * It starts out in its idle thread, which soon steals work.
+ */
+void*
+processor_start(void* arg) {
+  int a = 0;
+  void* dummy_ptr = (void*)&a;
+
+  this_processor = (processor_t)arg;
+  current_thread = this_processor->idle_thread;
+  current_thread->ran_at = stats_clock();
+  this_processor->running = current_thread;
+  interrupt_processor_init(TIME_QUANTA);
+  minithread_switch(&dummy_ptr, &(current_thread->stacktop));
+  return NULL;
+}
+
 /* Initialization.
  *
  *      minithread_system_initialize:
@@ -415,52 +1272,79 @@ minithread_sleep_with_timeout(int delay){
  *       program.
  *
  *       Initialize any private data structures.
- *       Create the idle thread.
+ *       Create the idle threads.
  *       Fork the thread which should call mainproc(mainarg)
- *       Start scheduling.
+ *       Start scheduling, then start the other processors.
  *
- *       Note that the runnable_q is protected by disabling interrupts.
- *       All other data structures are protected with binary semaphores.
+ *       Note that the run queues, blocked_q, dead_q and the thread cache are
+ *       protected by disabling interrupts. All other data structures are protected
+ *       with binary semaphores.
  *
  */
 void
 minithread_system_initialize(proc_t mainproc, arg_t mainarg) {
-  minithread_t clean_up_thread = NULL;
-  minithread_t process_packets_thread = NULL;
+  int i;
   int a = 0;
   void* dummy_ptr = NULL;
   dummy_ptr = (void*)&a;
   current_id = 0; // the next thread id to be assigned
+  minithread_attr_init(&default_attr);
   network_get_my_address(my_addr);
   id_lock = semaphore_create();
   semaphore_initialize(id_lock,1); 
-  runnable_q = multilevel_queue_new(4);
-  blocked_q = queue_new();
-  blocked_q_lock = semaphore_create();
-  semaphore_initialize(blocked_q_lock,1);
-  dead_q = queue_new();
-  dead_q_lock = semaphore_create();
-  semaphore_initialize(dead_q_lock,1);
+  processors = (processor_t*)malloc(num_processors * sizeof(processor_t));
+  for (i = 0; i < num_processors; i++) {
+    processors[i] = (processor_t)malloc(sizeof(processor));
+    processors[i]->id = i;
+    processors[i]->runnable_count = 0;
+    processors[i]->runnable_q = sched_rq_new(sched_policy, currentTimeMillis() + i);
+    processors[i]->idle_thread = minithread_create(idle, NULL);
+    processors[i]->idle_thread->processor = i;
+    strcpy(processors[i]->idle_thread->name, "idle");
+    processors[i]->sleeping = 0;
+    processors[i]->clock_idle = 0;
+    processors[i]->handoff = NULL;
+    processors[i]->resume = NULL;
+    processors[i]->switches = 0;
+    processors[i]->need_resched = 0;
+    processors[i]->running = NULL;
+  }
+  processors[0]->kernel_thread = pthread_self();
+  this_processor = processors[0];
+  minithread_queue_init(&blocked_q);
+  minithread_queue_init(&dead_q);
   dead_sem = semaphore_create();
   semaphore_initialize(dead_sem,0);    
-  clean_up_thread = minithread_create(clean_up, NULL);
-  multilevel_queue_enqueue(runnable_q,
-    clean_up_thread->priority,clean_up_thread);
-  runnable_count++;
+  while (thread_cache_len < THREAD_CACHE_PREFILL) {
+    thread_cache[thread_cache_len] = minithread_allocate(default_attr.stack_size,
+                                                         default_attr.guard_size);
+    if (thread_cache[thread_cache_len] == NULL) break;
+    thread_cache_len++;
+  }
+  minithread_fork_system(clean_up, "clean up");
   minimsg_initialize();
   minisocket_initialize();
   miniroute_initialize();
   minifile_initialize();
   miniterm_initialize();
-  process_packets_thread =  minithread_create(process_packets, NULL);
-  multilevel_queue_enqueue(runnable_q,
-    process_packets_thread->priority,process_packets_thread);
-  runnable_count++;
+  minithread_fork_system(process_packets, "packets");
+  boot_time = clock_now();
   minithread_clock_init(TIME_QUANTA, (interrupt_handler_t)clock_handler);
   network_initialize((network_handler_t) network_handler);
+  install_drain_handler(drain_handler);
   init_alarm();
+  alarm_thread = minithread_fork_system(alarm_worker, "alarm worker");
+  alarm_set_deferred(1);
+  for (i = 1; i < num_processors; i++) {
+    AbortOnCondition(pthread_create(&(processors[i]->kernel_thread), NULL,
+        processor_start, processors[i]), "pthread");
+  }
+  stats_calibrate();
+  stats_since = clock_now();
   current_thread = minithread_create(mainproc, mainarg);
+  current_thread->ran_at = stats_clock();
+  current_thread->runs = 1;
+  this_processor->running = current_thread;
   minithread_switch(&dummy_ptr, &(current_thread->stacktop));
   return;
 }
-
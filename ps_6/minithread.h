@@ -13,6 +13,7 @@
 
 #include "machineprimitives.h"
 #include "multilevel_queue.h"
+#include "sched_policy.h"
 #include "disk.h"
 #define RUNNABLE 0
 #define BLOCKED 1
@@ -27,6 +28,21 @@ int minithread_priority();
 //simple getter function for system time
 int minithread_time();
 
+//the time since the system started, in nanoseconds
+uint64_t minithread_time_ns();
+
+//the monotonic clock's time at system tick 0, and the length of a tick
+extern uint64_t boot_time;
+extern const int TIME_QUANTA;
+
+//simple getter function for the processor the caller runs on,
+//0 before the system is initialized
+int minithread_processor();
+
+//the number of context switches made so far, on all processors together,
+//counting switches to and from the idle threads
+long minithread_context_switches();
+
 /*
  * struct minithread:
  *  This is the key data structure for the thread management package.
@@ -35,6 +51,50 @@ int minithread_time();
 
 typedef struct minithread *minithread_t;
 
+/*
+ * A FIFO of threads, linked through the threads themselves so that
+ * putting a thread on one or taking it off never allocates memory.
+ * A thread is on at most one minithread_queue at a time. These are
+ * protected by disabling interrupts.
+ */
+typedef struct minithread_queue {
+  minithread_t head;
+  minithread_t tail;
+  int length;
+} minithread_queue;
+
+typedef minithread_queue* minithread_queue_t;
+
+/*
+ * Make q empty.
+ */
+extern void minithread_queue_init(minithread_queue_t q);
+
+/*
+ * Put t at the end of q.
+ */
+extern void minithread_queue_append(minithread_queue_t q, minithread_t t);
+
+/*
+ * Take the first thread off q and return it, or return NULL if q is empty.
+ */
+extern minithread_t minithread_queue_dequeue(minithread_queue_t q);
+
+/*
+ * Take t off q, which it must be on, wherever it is.
+ */
+extern void minithread_queue_remove(minithread_queue_t q, minithread_t t);
+
+/*
+ * Return 1 if t is on q, 0 otherwise, in constant time.
+ */
+extern int minithread_queue_contains(minithread_queue_t q, minithread_t t);
+
+/*
+ * Return the number of threads on q.
+ */
+extern int minithread_queue_length(minithread_queue_t q);
+
 /*
  * minithread_t
  * minithread_fork(proc_t proc, arg_t arg)
@@ -45,16 +105,23 @@ typedef struct minithread *minithread_t;
 extern minithread_t minithread_fork(proc_t proc, arg_t arg);
 
 /*
- * minithread_enqueue_and_schedule(queue_t q)
+ * minithread_enqueue_and_schedule(minithread_queue_t q)
  * puts current_thread on q and runs the next available thread
  */
-extern void minithread_enqueue_and_schedule(queue_t q);
+extern void minithread_enqueue_and_schedule(minithread_queue_t q);
 
 /*
- *  minithread_dequeue_and_schedule(queue_t q)
+ *  minithread_dequeue_and_schedule(minithread_queue_t q)
  *  dequeues the first element of q, puts on runnable queue
  */
-extern void minithread_dequeue_and_run(queue_t q);
+extern void minithread_dequeue_and_run(minithread_queue_t q);
+
+/*
+ * minithread_dequeue_and_switch(minithread_queue_t q)
+ *  dequeues the first element of q and runs it at once, putting the
+ *  caller on the runnable queue as if it had yielded
+ */
+extern void minithread_dequeue_and_switch(minithread_queue_t q);
 
 /*
  * minithread_t
@@ -64,6 +131,52 @@ extern void minithread_dequeue_and_run(queue_t q);
  */
 extern minithread_t minithread_create(proc_t proc, arg_t arg);
 
+#define MINITHREAD_NAME_LEN 16
+
+/*
+ * Attributes of a new thread, for minithread_fork_ex and
+ * minithread_create_ex. Set one up with minithread_attr_init, then
+ * change the fields wanted.
+ *  stack_size  bytes of stack, at least MIN_STACKSIZE. The stack is only
+ *              reserved: a thread takes memory for the pages of its stack
+ *              it has used, not for all of it.
+ *  guard_size  bytes of inaccessible memory past the end of the stack, or
+ *              0 for none. A guarded stack takes two of the process's
+ *              memory mappings, of which there are about 65000, so
+ *              programs with tens of thousands of threads want 0.
+ *  priority    level to start at under SCHED_MLFQ, and to go back to
+ *              after blocking or yielding, from 0 (the highest) to
+ *              SCHED_LEVELS - 1. See minithread_set_priority.
+ *  name        for debugging, may be NULL. It is copied, and cut to
+ *              MINITHREAD_NAME_LEN - 1 characters.
+ */
+typedef struct minithread_attr {
+  size_t stack_size;
+  size_t guard_size;
+  int priority;
+  char* name;
+} minithread_attr;
+
+typedef minithread_attr* minithread_attr_t;
+
+/*
+ * minithread_attr_init(minithread_attr_t attr)
+ *  Set attr to what minithread_fork and minithread_create use: a
+ *  DEFAULT_STACKSIZE stack with a one page guard, priority 0 and no name.
+ */
+extern void minithread_attr_init(minithread_attr_t attr);
+
+/*
+ * minithread_t
+ * minithread_fork_ex(proc_t proc, arg_t arg, minithread_attr_t attr)
+ * minithread_create_ex(proc_t proc, arg_t arg, minithread_attr_t attr)
+ *  Like minithread_fork and minithread_create, but the thread is made
+ *  with attr, or the defaults if attr is NULL. Return NULL if attr is
+ *  invalid or the thread cannot be allocated.
+ */
+extern minithread_t minithread_fork_ex(proc_t proc, arg_t arg, minithread_attr_t attr);
+extern minithread_t minithread_create_ex(proc_t proc, arg_t arg, minithread_attr_t attr);
+
 
 
 /*
@@ -80,6 +193,12 @@ extern minithread_t minithread_self();
  */
 extern int minithread_id();
 
+/*
+ * char* minithread_name(minithread_t t):
+ *      Return the name t was made with, or "" if it has none.
+ */
+extern char* minithread_name(minithread_t t);
+
 /*
  * Gets the current directory of this thread
  * */
@@ -112,6 +231,16 @@ extern void minithread_start(minithread_t t);
  */
 extern void minithread_yield();
 
+/*
+ * int minithread_yield_to(minithread_t t)
+ *  Like minithread_yield, but if t is waiting on a run queue, it runs
+ *  next on this processor, ahead of everything else there. Return 0 if
+ *  it did, or -1 if t was not waiting to run (it is the caller, running
+ *  on another processor, blocked or finished), in which case this is an
+ *  ordinary yield.
+ */
+extern int minithread_yield_to(minithread_t t);
+
 /*
  * minithread_system_initialize(proc_t mainproc, arg_t mainarg)
  *  Initialize the system to run the first minithread at
@@ -121,6 +250,74 @@ extern void minithread_yield();
  */
 extern void minithread_system_initialize(proc_t mainproc, arg_t mainarg);
 
+/*
+ * minithread_set_processors(int n)
+ *  Run minithreads on n kernel threads instead of one. Each of these
+ *  processors has its own run queue, and one with nothing to run steals
+ *  threads from the others. Must be called before
+ *  minithread_system_initialize; the default is 1.
+ */
+extern void minithread_set_processors(int n);
+
+/*
+ * int minithread_num_processors()
+ *  Return the number of processors minithreads run on.
+ */
+extern int minithread_num_processors();
+
+/*
+ * minithread_set_scheduler(sched_policy_t policy)
+ *  Schedule every processor's run queue with policy, one of SCHED_MLFQ,
+ *  SCHED_STRIDE, SCHED_LOTTERY and SCHED_EDF (see sched_policy.h).
+ *  Must be called before minithread_system_initialize; the default is
+ *  SCHED_MLFQ.
+ */
+extern void minithread_set_scheduler(sched_policy_t policy);
+
+/*
+ * int minithread_set_priority(minithread_t t, int priority)
+ *  Under SCHED_MLFQ, t starts each slice it gets after blocking or
+ *  yielding at level priority, from 0 (the highest) to SCHED_LEVELS - 1,
+ *  and only drops below it by using up slices. Takes effect the next time
+ *  t is put on a run queue. Return 0 (success) or -1 (failure), if
+ *  priority is out of range or t is a kernel thread, which are in the
+ *  system class and always run ahead of every other thread.
+ */
+extern int minithread_set_priority(minithread_t t, int priority);
+
+/*
+ * int minithread_get_priority(minithread_t t)
+ *  Return the priority t was given, or MINITHREAD_PRIORITY_SYSTEM if t
+ *  is a kernel thread. minithread_priority gives the caller's current
+ *  level instead.
+ */
+#define MINITHREAD_PRIORITY_SYSTEM -1
+extern int minithread_get_priority(minithread_t t);
+
+/*
+ * int minithread_nice(int inc)
+ *  Add inc to the caller's priority, stopping at 0 and SCHED_LEVELS - 1,
+ *  so a positive inc makes it run less. Return the new priority, or -1
+ *  if the caller is a kernel thread.
+ */
+extern int minithread_nice(int inc);
+
+/*
+ * minithread_set_tickets(minithread_t t, int tickets)
+ *  Give t tickets shares of the processor under SCHED_STRIDE and
+ *  SCHED_LOTTERY. Every thread starts with SCHED_DEFAULT_TICKETS.
+ *  Under SCHED_LOTTERY, takes effect the next time t is put on a run queue.
+ */
+extern void minithread_set_tickets(minithread_t t, int tickets);
+
+/*
+ * minithread_set_deadline(minithread_t t, int delay)
+ *  Under SCHED_EDF, t is due [delay] milliseconds from now; a negative
+ *  delay clears its deadline. Takes effect the next time t is put on
+ *  a run queue.
+ */
+extern void minithread_set_deadline(minithread_t t, int delay);
+
 
 /*
  * minithread_sleep_with_timeout(int delay)
@@ -128,6 +325,87 @@ extern void minithread_system_initialize(proc_t mainproc, arg_t mainarg);
  */
 extern void minithread_sleep_with_timeout(int delay);
 
+/*
+ * minithread_sleep_ns(uint64_t delay)
+ *      Put the current thread to sleep for [delay] nanoseconds. It wakes
+ *      up within a millisecond of the time, not at the next clock tick.
+ */
+extern void minithread_sleep_ns(uint64_t delay);
+
+
+#define MINITHREAD_LATENCY_BUCKETS 8
+
+/*
+ * What the scheduler has done, for minithread_get_scheduler_stats. Run
+ * waits are from a thread going on a run queue to it running, and block
+ * times from it blocking to it being woken up, both in nanoseconds and
+ * counted in buckets of under 1us, 10us, ... 1s, and more.
+ */
+typedef struct scheduler_stats {
+  uint64_t uptime; //nanoseconds since the counts were last reset
+  long switches; //context switches, counting those to and from idle
+  long preemptions; //slices ended by the clock
+  long yields;
+  long blocks;
+  long wakeups;
+  long ticks[SCHED_LEVELS]; //clock ticks charged to user threads, by mlfq level
+  long system_ticks; //charged to kernel threads
+  long idle_ticks; //taken by idle processors
+  uint64_t total_run_wait;
+  uint64_t max_run_wait;
+  long run_wait[MINITHREAD_LATENCY_BUCKETS];
+  long block_time[MINITHREAD_LATENCY_BUCKETS];
+} scheduler_stats;
+
+typedef scheduler_stats* scheduler_stats_t;
+
+/*
+ * The scheduling state and counters of one thread, for
+ * minithread_get_thread_stats. Counters cover the thread's whole life.
+ */
+typedef struct thread_stats {
+  int id;
+  char name[MINITHREAD_NAME_LEN];
+  char state; //'R'unning, 'W'aiting to run, 'B'locked or 'I'dle
+  int processor; //that it last ran on, or is queued on
+  int priority; //as minithread_get_priority
+  int level; //mlfq level
+  int rem_quanta; //left in its mlfq slice
+  uint64_t cpu_time; //nanoseconds run, not counting the current run
+  uint64_t run_wait; //nanoseconds spent waiting to run
+  long runs; //times switched to
+  long preemptions;
+  long wakeups;
+} thread_stats;
+
+typedef thread_stats* thread_stats_t;
+
+/*
+ * int minithread_get_scheduler_stats(scheduler_stats_t stats)
+ *  Copy the scheduler's counters into stats. Return 0 (success) or -1
+ *  (failure).
+ */
+extern int minithread_get_scheduler_stats(scheduler_stats_t stats);
+
+/*
+ * minithread_reset_scheduler_stats()
+ *  Zero the scheduler's counters, but not the threads'.
+ */
+extern void minithread_reset_scheduler_stats();
+
+/*
+ * int minithread_get_thread_stats(thread_stats_t stats, int max)
+ *  Fill in stats for up to max of the threads that have not exited,
+ *  the idle threads included, and return how many were filled in.
+ */
+extern int minithread_get_thread_stats(thread_stats_t stats, int max);
+
+/*
+ * minithread_print_stats()
+ *  Print the scheduler's counters and a line per thread, busiest first,
+ *  like top.
+ */
+extern void minithread_print_stats();
 
 #endif /*__MINITHREAD_H__*/
 
@@ -1,20 +1,36 @@
 /* * Multilevel queue manipulation functions  */
-#include "multilevel_queue.h" 
-#include <stdlib.h> 
-#include <stdio.h> 
+#include "multilevel_queue.h"
+#include <stdlib.h>
+#include <stdio.h>
 
-typedef struct node { 
-  queue_t queue; 
-  struct node* next;
-} node;
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+#define LEVEL_INITIAL_CAPACITY 16
 
-typedef node* node_t;
+/*
+ * One level is a ring buffer of items. It only allocates when it fills
+ * up, so once it has grown to the number of items it holds at its busiest,
+ * enqueue and dequeue never call malloc or free. capacity is always a
+ * power of two, so indices wrap with a mask.
+ */
+typedef struct level {
+  void** items;
+  int head;
+  int len;
+  int capacity;
+} level;
 
+/*
+ * Bit i of occupied is set exactly when level i is nonempty, so the next
+ * nonempty level is found with a find-first-set over a word (or a few
+ * words, past 64 levels) instead of by visiting every level.
+ */
 typedef struct multilevel_queue {
-  node* head;
   int count;
   int num_levels;
-} multilevel_queue; 
+  int num_words;
+  unsigned long* occupied;
+  level* levels;
+} multilevel_queue;
 
 /*
  * Returns an empty multilevel queue with number_of_levels levels. On error should return NULL. An input of 0 levels is considered an error since such a queue could not hold any elements.
@@ -22,135 +38,181 @@ typedef struct multilevel_queue {
 multilevel_queue_t multilevel_queue_new(int number_of_levels)
 {
   int i = 0;
-  queue_t new_q = NULL;
-  node_t new_node = NULL;
   multilevel_queue_t new_multi_q = NULL;
-  node_t tail = NULL;
-  
+
   // check that number_of_level valid
   if (number_of_levels < 1) return NULL;
-  
+
   new_multi_q = (multilevel_queue_t)malloc(sizeof(multilevel_queue));
-  
+
   // check for error
   if (new_multi_q == NULL) return NULL;
 
   new_multi_q->num_levels = number_of_levels;
+  new_multi_q->num_words = (number_of_levels + BITS_PER_WORD - 1) / BITS_PER_WORD;
   new_multi_q->count = 0;
-  new_multi_q->head = NULL;
+  new_multi_q->occupied = (unsigned long*)calloc(new_multi_q->num_words, sizeof(unsigned long));
+  new_multi_q->levels = (level*)calloc(number_of_levels, sizeof(level));
+
+  // check for error
+  if (new_multi_q->occupied == NULL || new_multi_q->levels == NULL) {
+    multilevel_queue_free(new_multi_q);
+    return NULL;
+  }
 
   for (i = 0; i < number_of_levels; i++) {
-    new_node = (node_t)malloc(sizeof(node));
-    new_q = queue_new();
-  
+    new_multi_q->levels[i].items = (void**)malloc(LEVEL_INITIAL_CAPACITY * sizeof(void*));
+
     // check for error
-    if (new_node == NULL || new_q == NULL) return NULL;
-    
-    new_node->queue = new_q;
-
-    // check if currently no levels
-    if (new_multi_q->head == NULL) {
-      new_node->next = new_node;
-      new_multi_q->head = new_node;
+    if (new_multi_q->levels[i].items == NULL) {
+      multilevel_queue_free(new_multi_q);
+      return NULL;
     }
-    // otherwise are levels
-    else {
-      tail->next = new_node;
-      new_node->next = new_multi_q->head;
-    }
-    tail = new_node; 
+    new_multi_q->levels[i].capacity = LEVEL_INITIAL_CAPACITY;
   }
 
   return new_multi_q;
 }
 
+/*
+ * Doubles the capacity of a full level, unrolling the ring so the
+ * oldest item is at index 0. Return 0 (success) or -1 (failure).
+ */
+static int level_grow(level* lv)
+{
+  int i = 0;
+  void** new_items = NULL;
+
+  new_items = (void**)malloc(2 * lv->capacity * sizeof(void*));
+  if (new_items == NULL) return -1;
+
+  for (i = 0; i < lv->len; i++) {
+    new_items[i] = lv->items[(lv->head + i) & (lv->capacity - 1)];
+  }
+  free(lv->items);
+  lv->items = new_items;
+  lv->head = 0;
+  lv->capacity *= 2;
+  return 0;
+}
+
 /*
  * Appends an void* to the multilevel queue at the specified level. Return 0 (success) or -1 (failure).
  */
 int multilevel_queue_enqueue(multilevel_queue_t multi_q, int level, void* item)
-{ 
-  node_t curr_node = NULL;
-  int curr_level = 0;
+{
+  struct level* lv = NULL;
 
   // check for errors
   if (multi_q == NULL) return -1;
   if (level < 0 || level >= multi_q->num_levels) return -1;
-  
-  // we know this multi_q has at least one level
-  curr_node = multi_q->head;
-  while (curr_level++ < level) curr_node = curr_node->next;
-  
-  // enqueue at correct level and check for error
-  if (queue_append(curr_node->queue,item) == -1) return -1;
+
+  lv = &multi_q->levels[level];
+  if (lv->len == lv->capacity && level_grow(lv) == -1) return -1;
+
+  lv->items[(lv->head + lv->len) & (lv->capacity - 1)] = item;
+  lv->len++;
+  multi_q->occupied[level / BITS_PER_WORD] |= 1UL << (level % BITS_PER_WORD);
   multi_q->count++;
   return 0;
 }
 
 /*
- * Dequeue and return the first void* from the multilevel queue starting at the specified level. 
+ * Returns the first nonempty level at or after start, wrapping around
+ * past the last level. The queue must be nonempty.
+ */
+static int first_occupied_level(multilevel_queue_t multi_q, int start)
+{
+  int word = start / BITS_PER_WORD;
+  unsigned long bits = multi_q->occupied[word] & (~0UL << (start % BITS_PER_WORD));
+  int i = 0;
+
+  // levels start and up, then wrap around to level 0
+  for (i = 0; i <= multi_q->num_words; i++) {
+    if (bits != 0) {
+      return word * BITS_PER_WORD + __builtin_ctzl(bits);
+    }
+    word = (word + 1) % multi_q->num_words;
+    bits = multi_q->occupied[word];
+  }
+  return -1;
+}
+
+/*
+ * Dequeue and return the first void* from the multilevel queue starting at the specified level.
  * Levels wrap around so as long as there is something in the multilevel queue an item should be returned.
  * Return the level that the item was located on and that item if the multilevel queue is nonempty,
  * or -1 (failure) and NULL if queue is empty.
  */
 int multilevel_queue_dequeue(multilevel_queue_t multi_q, int level, void** item)
-{ 
-  int i = 0;
-  node_t curr_node = NULL;
-  
+{
+  struct level* lv = NULL;
+
   // check if queue empty
-  if (multi_q == NULL || multi_q->count == 0) {
+  if (multi_q == NULL || multi_q->count == 0 || level < 0) {
     *item = NULL;
     return -1;
   }
 
-  // multi_q must have at least one level, because contains elements
-  curr_node = multi_q->head;
+  // multi_q is nonempty, so some level is occupied
+  level = first_occupied_level(multi_q, level % multi_q->num_levels);
+  lv = &multi_q->levels[level];
 
-  for (i = 0; i < level; i++) curr_node = curr_node->next;
+  *item = lv->items[lv->head];
+  lv->head = (lv->head + 1) & (lv->capacity - 1);
+  if (--lv->len == 0) {
+    multi_q->occupied[level / BITS_PER_WORD] &= ~(1UL << (level % BITS_PER_WORD));
+  }
+  multi_q->count--;
+  return level;
+}
 
-  for (i = 0; i < multi_q->num_levels; i++) {
-    // no items at this level
-    if (queue_length(curr_node->queue) == 0) {  
-      level = (level + 1) % multi_q->num_levels;
-      curr_node = curr_node->next;
-      continue;
-    }
+/*
+ * Removes item from the given level of the multilevel queue, keeping the
+ * order of the items behind it. Return 0 (success) or -1 if it is not there.
+ */
+int multilevel_queue_delete(multilevel_queue_t multi_q, int level, void* item)
+{
+  struct level* lv = NULL;
+  int i = 0;
 
-    // failed dequeue
-    else if (queue_dequeue(curr_node->queue,item) == -1) {
-      return -1;
-    }
+  if (multi_q == NULL || level < 0 || level >= multi_q->num_levels) return -1;
 
-    // successful dequeue
-    else {
-      multi_q->count--;
-      return level;
-    }
+  lv = &multi_q->levels[level];
+  for (i = 0; i < lv->len; i++) {
+    if (lv->items[(lv->head + i) & (lv->capacity - 1)] == item) break;
   }
+  if (i == lv->len) return -1;
 
-  return -1;
+  // close the gap by moving the items behind it up
+  for (; i < lv->len - 1; i++) {
+    lv->items[(lv->head + i) & (lv->capacity - 1)] =
+        lv->items[(lv->head + i + 1) & (lv->capacity - 1)];
+  }
+  if (--lv->len == 0) {
+    multi_q->occupied[level / BITS_PER_WORD] &= ~(1UL << (level % BITS_PER_WORD));
+  }
+  multi_q->count--;
+  return 0;
 }
 
-/* 
+/*
  * Free the queue and return 0 (success) or -1 (failure). Do not free the queue nodes; this is
  * the responsibility of the programmer.
  */
 int multilevel_queue_free(multilevel_queue_t multi_q)
 {
   int i = 0;
-  node_t curr = NULL;
-  node_t temp = NULL;
 
   if (multi_q == NULL) return -1;
-  
-  curr = multi_q->head;
-  for (i = 0; i < multi_q->num_levels; i++) {
-    temp = curr;
-    curr = curr->next;
-    if (queue_free(temp->queue) == -1) return -1;
-    free(temp);
+
+  if (multi_q->levels != NULL) {
+    for (i = 0; i < multi_q->num_levels; i++) {
+      free(multi_q->levels[i].items);
+    }
   }
-  
-  free(multi_q);  
+  free(multi_q->levels);
+  free(multi_q->occupied);
+  free(multi_q);
   return 0;
 }
@@ -31,6 +31,12 @@ extern int multilevel_queue_enqueue(multilevel_queue_t queue, int level, void* i
  */
 extern int multilevel_queue_dequeue(multilevel_queue_t queue, int level, void** item);
 
+/*
+ * Removes item from the given level of the multilevel queue.
+ * Return 0 (success) or -1 (failure) if item is not on that level.
+ */
+extern int multilevel_queue_delete(multilevel_queue_t queue, int level, void* item);
+
 /* 
  * Free the queue and return 0 (success) or -1 (failure). Do not free the queue nodes; this is
  * the responsibility of the programmer.
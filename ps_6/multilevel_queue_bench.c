@@ -0,0 +1,176 @@
+/* multilevel_queue_bench.c
+   Times multilevel queue enqueue/dequeue pairs against the old
+   implementation, which kept a circular list of queue_t levels and
+   walked it on every operation.
+   Usage: multilevel_queue_bench [iterations]
+   Each run keeps a few items spread over the levels and dequeues
+   starting from a level that moves, the way the scheduler does.
+*/
+#include "multilevel_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 2000000
+#define RESIDENT_ITEMS 8
+
+/* the old multilevel queue, kept here as the baseline */
+typedef struct list_level {
+  queue_t queue;
+  struct list_level* next;
+} list_level;
+
+typedef struct list_multilevel_queue {
+  list_level* head;
+  int count;
+  int num_levels;
+} list_multilevel_queue;
+
+static list_multilevel_queue*
+list_mlq_new(int number_of_levels) {
+  int i;
+  list_level* new_level;
+  list_level* tail = NULL;
+  list_multilevel_queue* multi_q;
+
+  multi_q = (list_multilevel_queue*)malloc(sizeof(list_multilevel_queue));
+  if (multi_q == NULL) return NULL;
+  multi_q->num_levels = number_of_levels;
+  multi_q->count = 0;
+  multi_q->head = NULL;
+
+  for (i = 0; i < number_of_levels; i++) {
+    new_level = (list_level*)malloc(sizeof(list_level));
+    if (new_level == NULL) return NULL;
+    new_level->queue = queue_new();
+    if (new_level->queue == NULL) return NULL;
+    if (multi_q->head == NULL) {
+      new_level->next = new_level;
+      multi_q->head = new_level;
+    }
+    else {
+      tail->next = new_level;
+      new_level->next = multi_q->head;
+    }
+    tail = new_level;
+  }
+  return multi_q;
+}
+
+static int
+list_mlq_enqueue(list_multilevel_queue* multi_q, int level, void* item) {
+  list_level* curr = multi_q->head;
+  int curr_level = 0;
+
+  while (curr_level++ < level) curr = curr->next;
+  if (queue_append(curr->queue, item) == -1) return -1;
+  multi_q->count++;
+  return 0;
+}
+
+static int
+list_mlq_dequeue(list_multilevel_queue* multi_q, int level, void** item) {
+  int i;
+  list_level* curr = multi_q->head;
+
+  if (multi_q->count == 0) {
+    *item = NULL;
+    return -1;
+  }
+  for (i = 0; i < level; i++) curr = curr->next;
+  for (i = 0; i < multi_q->num_levels; i++) {
+    if (queue_length(curr->queue) == 0) {
+      level = (level + 1) % multi_q->num_levels;
+      curr = curr->next;
+      continue;
+    }
+    if (queue_dequeue(curr->queue, item) == -1) return -1;
+    multi_q->count--;
+    return level;
+  }
+  return -1;
+}
+
+static void
+list_mlq_free(list_multilevel_queue* multi_q) {
+  int i;
+  list_level* curr = multi_q->head;
+  list_level* temp;
+
+  for (i = 0; i < multi_q->num_levels; i++) {
+    temp = curr;
+    curr = curr->next;
+    queue_free(temp->queue);
+    free(temp);
+  }
+  free(multi_q);
+}
+
+static double
+elapsed_ns(struct timespec* start, struct timespec* stop) {
+  return (stop->tv_sec - start->tv_sec) * 1e9 + (stop->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Returns ns per enqueue/dequeue pair for the bitmap queue.
+ */
+static double
+bench_bitmap(int levels, long iterations) {
+  long i;
+  void* item;
+  struct timespec start, stop;
+  multilevel_queue_t multi_q = multilevel_queue_new(levels);
+
+  for (i = 0; i < RESIDENT_ITEMS; i++) {
+    multilevel_queue_enqueue(multi_q, (i * 7) % levels, (void*)i);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < iterations; i++) {
+    multilevel_queue_enqueue(multi_q, (i * 7) % levels, (void*)i);
+    multilevel_queue_dequeue(multi_q, i % levels, &item);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  multilevel_queue_free(multi_q);
+  return elapsed_ns(&start, &stop) / iterations;
+}
+
+/*
+ * Returns ns per enqueue/dequeue pair for the old list of levels.
+ */
+static double
+bench_list(int levels, long iterations) {
+  long i;
+  void* item;
+  struct timespec start, stop;
+  list_multilevel_queue* multi_q = list_mlq_new(levels);
+
+  for (i = 0; i < RESIDENT_ITEMS; i++) {
+    list_mlq_enqueue(multi_q, (i * 7) % levels, (void*)i);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < iterations; i++) {
+    list_mlq_enqueue(multi_q, (i * 7) % levels, (void*)i);
+    list_mlq_dequeue(multi_q, i % levels, &item);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  list_mlq_free(multi_q);
+  return elapsed_ns(&start, &stop) / iterations;
+}
+
+int
+main(int argc, char* argv[]) {
+  int i;
+  long iterations = DEFAULT_ITERATIONS;
+  int levels[] = {4, 64, 128, 256};
+
+  if (argc > 1) {
+    iterations = atol(argv[1]);
+  }
+  printf("levels  bitmap ns/op  list ns/op\n");
+  for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    printf("%6d  %12.1f  %10.1f\n", levels[i],
+        bench_bitmap(levels[i], iterations), bench_list(levels[i], iterations));
+  }
+  return 0;
+}
@@ -7,6 +7,7 @@
 #include "assert.h"
 
 int main(void) {
+  long i;
   long x1, x2, x3, x4, val;
   multilevel_queue_t multi_q = NULL;
   val = 0;
@@ -63,6 +64,62 @@ int main(void) {
   assert(multilevel_queue_dequeue(multi_q,1,(void**)(&val)) == -1);
   assert(val == 0);
   multilevel_queue_free(multi_q);
+
+  // more levels than fit in one bitmap word
+  multi_q = multilevel_queue_new(130);
+  assert(multilevel_queue_enqueue(multi_q,130,(void*)x1) == -1);
+  multilevel_queue_enqueue(multi_q,3,(void*)x1);
+  multilevel_queue_enqueue(multi_q,64,(void*)x2);
+  multilevel_queue_enqueue(multi_q,129,(void*)x3);
+  assert(multilevel_queue_dequeue(multi_q,4,(void**)(&val)) == 64);
+  assert(val == 2);
+  assert(multilevel_queue_dequeue(multi_q,65,(void**)(&val)) == 129);
+  assert(val == 3);
+  // wraps from the last word back to the first
+  assert(multilevel_queue_dequeue(multi_q,129,(void**)(&val)) == 3);
+  assert(val == 1);
+  assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == -1);
+  multilevel_queue_free(multi_q);
+
+  // a level grows past its initial capacity with its head mid-ring
+  multi_q = multilevel_queue_new(2);
+  for (i = 0; i < 10; i++) {
+    multilevel_queue_enqueue(multi_q,1,(void*)i);
+    multilevel_queue_dequeue(multi_q,0,(void**)(&val));
+  }
+  for (i = 0; i < 100; i++) {
+    assert(multilevel_queue_enqueue(multi_q,1,(void*)i) == 0);
+  }
+  for (i = 0; i < 100; i++) {
+    assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == 1);
+    assert(val == i);
+  }
+  assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == -1);
+  multilevel_queue_free(multi_q);
+
+  // deleting from the middle of a level, with its head mid-ring
+  multi_q = multilevel_queue_new(2);
+  for (i = 0; i < 10; i++) {
+    multilevel_queue_enqueue(multi_q,1,(void*)i);
+    multilevel_queue_dequeue(multi_q,0,(void**)(&val));
+  }
+  for (i = 0; i < 10; i++) {
+    multilevel_queue_enqueue(multi_q,1,(void*)i);
+  }
+  assert(multilevel_queue_delete(multi_q,1,(void*)x4) == 0);
+  assert(multilevel_queue_delete(multi_q,1,(void*)x4) == -1);
+  assert(multilevel_queue_delete(multi_q,0,(void*)x1) == -1);
+  assert(multilevel_queue_delete(multi_q,2,(void*)x1) == -1);
+  for (i = 0; i < 10; i++) {
+    if (i == x4) continue;
+    assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == 1);
+    assert(val == i);
+  }
+  assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == -1);
+  multilevel_queue_enqueue(multi_q,1,(void*)x1);
+  assert(multilevel_queue_delete(multi_q,1,(void*)x1) == 0);
+  assert(multilevel_queue_dequeue(multi_q,0,(void**)(&val)) == -1);
+  multilevel_queue_free(multi_q);
   
   printf("potato.\n");
   return 0;
@@ -0,0 +1,141 @@
+/* net_rx_bench.c
+   Measures how many packets per second the network receive path takes
+   in, batched into pool buffers, against the old path, which malloced a
+   packet and called recvfrom for each datagram.
+   Usage: net_rx_bench [packets] [size]
+   Each round sends a burst of datagrams of size bytes to a socket on
+   the loopback interface, and then times only taking them off it, so
+   the sender's cost is left out. Neither path starts the thread system.
+*/
+#include "network.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DEFAULT_PACKETS 200000
+#define DEFAULT_SIZE 64
+#define BURST 128
+#define RCVBUF (4 * 1024 * 1024)
+
+int packets = DEFAULT_PACKETS;
+int size = DEFAULT_SIZE;
+int rx;
+int tx;
+struct sockaddr_in rx_addr;
+
+/*
+ * Takes every datagram waiting on rx and returns how many there were.
+ */
+typedef int (*drain_t)();
+
+int
+drain_recvfrom() {
+  network_interrupt_arg_t* packet;
+  struct sockaddr_in addr;
+  socklen_t fromlen;
+  int n = 0;
+
+  for (;;) {
+    //the old fixed size packet
+    packet = (network_interrupt_arg_t*)malloc(sizeof(network_interrupt_arg_t) +
+        NETWORK_PKT_HEADROOM + MAX_NETWORK_PKT_SIZE);
+    fromlen = sizeof(addr);
+    packet->size = recvfrom(rx, packet->head, MAX_NETWORK_PKT_SIZE,
+                            MSG_DONTWAIT, (struct sockaddr*)&addr, &fromlen);
+    if (packet->size < 0) {
+      free(packet);
+      return n;
+    }
+    packet->sender[0] = addr.sin_addr.s_addr;
+    packet->sender[1] = addr.sin_port;
+    free(packet);
+    n++;
+  }
+}
+
+int
+drain_batch() {
+  network_interrupt_arg_t* pkts[NETWORK_RECEIVE_BATCH];
+  int n = 0;
+  int got;
+  int i;
+
+  while ((got = network_receive_batch(rx, pkts, NETWORK_RECEIVE_BATCH)) > 0) {
+    for (i = 0; i < got; i++) {
+      network_free_pkt(pkts[i]);
+    }
+    n += got;
+  }
+  return n;
+}
+
+double
+elapsed_ns(struct timespec* start, struct timespec* stop) {
+  return (stop->tv_sec - start->tv_sec) * 1e9 + (stop->tv_nsec - start->tv_nsec);
+}
+
+void
+run(char* what, drain_t drain) {
+  char data[MAX_NETWORK_PKT_SIZE];
+  struct timespec start, stop;
+  double ns = 0;
+  int received = 0;
+  int sent;
+  int i;
+
+  memset(data, 'x', size);
+  for (sent = 0; sent < packets; sent += BURST) {
+    for (i = 0; i < BURST; i++) {
+      sendto(tx, data, size, 0, (struct sockaddr*)&rx_addr, sizeof(rx_addr));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    received += drain();
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    ns += elapsed_ns(&start, &stop);
+  }
+  printf("%-20s %8d packets %8.1f ns/packet %10.0f packets/s\n", what,
+      received, ns / received, received / (ns / 1e9));
+}
+
+int
+main(int argc, char* argv[]) {
+  socklen_t len = sizeof(rx_addr);
+  int rcvbuf = RCVBUF;
+
+  if (argc > 1) {
+    packets = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    size = atoi(argv[2]);
+  }
+  if (size < 1 || size > MAX_NETWORK_PKT_SIZE) size = DEFAULT_SIZE;
+
+  rx = socket(PF_INET, SOCK_DGRAM, 0);
+  tx = socket(PF_INET, SOCK_DGRAM, 0);
+  if (rx < 0 || tx < 0) {
+    perror("socket");
+    return 1;
+  }
+  memset(&rx_addr, 0, sizeof(rx_addr));
+  rx_addr.sin_family = AF_INET;
+  rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(rx, (struct sockaddr*)&rx_addr, sizeof(rx_addr)) < 0 ||
+      getsockname(rx, (struct sockaddr*)&rx_addr, &len) < 0) {
+    perror("bind");
+    return 1;
+  }
+  setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  printf("%d byte packets, bursts of %d\n", size, BURST);
+  run("malloc and recvfrom", drain_recvfrom);
+  run("pool and recvmmsg", drain_batch);
+  run("malloc and recvfrom", drain_recvfrom);
+  run("pool and recvmmsg", drain_batch);
+  return 0;
+}
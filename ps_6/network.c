@@ -2,6 +2,7 @@
  * network.c:
  *      This module paints the unix socket interface a pretty color.
  */
+#define _GNU_SOURCE /* recvmmsg */
 
 #include <string.h>
 #include <stdio.h>
@@ -13,6 +14,7 @@
 #include <signal.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <sched.h>
 
 #include "defs.h"
 #include "network.h"
@@ -60,12 +62,51 @@ int synthetic_network = 0;
 struct address_info {
   int sock;
   struct sockaddr_in sin;
-  char pkt[MAX_NETWORK_PKT_SIZE];
 };
 
 struct address_info if_info;
 static network_address_t broadcast_addr = { 0 };
 
+/*
+ * The packet size classes. Each has a pool of buffers: free holds those
+ * not in use, most recently freed (so most likely still in cache) last,
+ * and packets of the class from outside buffers were malloced while it
+ * was empty. The I/O thread takes packets and the processors give them
+ * back, so pool_lock, which covers the stats too, is a spin lock, held
+ * with interrupts disabled on the processors.
+ */
+typedef struct {
+  char* buffers;
+  network_interrupt_arg_t** free;
+  int stride; /* bytes per packet, head and all */
+  network_pkt_stats stats;
+} pkt_class;
+
+static pkt_class pkt_classes[NETWORK_PKT_CLASSES] = {
+  { NULL, NULL, 0, { 256, 1024 } },
+  { NULL, NULL, 0, { 2048, 256 } },
+  { NULL, NULL, 0, { MAX_NETWORK_PKT_SIZE, 128 } },
+};
+#define LARGEST_CLASS (NETWORK_PKT_CLASSES - 1)
+
+/*
+ * Datagrams are gathered straight from the senders' buffers, so the send
+ * path shares only the broadcast links, which the shell can change under
+ * a broadcast, and genrand's state, which random.c locks itself.
+ */
+static tas_lock_t topology_lock = 0;
+
+static tas_lock_t pool_lock = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/*
+ * The full sized packets network_receive_batch receives into, kept from
+ * one call to the next. It hands out those that get large packets, and
+ * copies the rest into packets of their size. Only the I/O thread
+ * receives (the benchmarks aside), so they need no lock.
+ */
+static network_interrupt_arg_t* rx_ring[NETWORK_RECEIVE_BATCH];
+
 /* forward definition */
 void start_network_poll(interrupt_handler_t, int*);
 void network_address_to_sockaddr(network_address_t addr, struct sockaddr_in* sin);
@@ -96,46 +137,79 @@ network_printaddr(network_address_t addr) {
   printf("%s", name);
 }
 
+/*
+ * Spins for lock with interrupts disabled, as the processors hold it.
+ */
+static void
+spin_acquire(tas_lock_t* lock) {
+  while (atomic_test_and_set(lock))
+    sched_yield();
+}
+
+/*
+ * Sends the fragments in iov as one datagram with sendmsg, which
+ * gathers them itself, so nothing is staged in a shared buffer and any
+ * number of threads can send at once.
+ */
+static int
+send_pktv(network_address_t dest_address, struct iovec* iov, int iovcnt) {
+  struct sockaddr_in sin;
+  struct msghdr msg;
+  int pktlen = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > NETWORK_MAX_IOV)
+    return -1;
+  for (i = 0; i < iovcnt; i++)
+    pktlen += iov[i].iov_len;
+  if (pktlen > MAX_NETWORK_PKT_SIZE)
+    return -1;
+
+  network_address_to_sockaddr(dest_address, &sin);
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &sin;
+  msg.msg_namelen = sizeof(sin);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+  return sendmsg(if_info.sock, &msg, 0);
+}
+
 static int
 send_pkt(network_address_t dest_address,
          int hdr_len, char* hdr,
          int data_len, char* data) {
-  int cc;
-  struct sockaddr_in sin;
-  char* bufp;
-  int sz, pktlen;
-
-  pktlen = hdr_len + data_len;
+  struct iovec iov[2];
 
   /* sanity checks */
-  if (hdr_len < 0 || data_len < 0 || pktlen > MAX_NETWORK_PKT_SIZE)
+  if (hdr_len < 0 || data_len < 0 ||
+      hdr_len + data_len > MAX_NETWORK_PKT_SIZE)
     return 0;
 
-  /*
-   * Pull up the headers and data and stuff them into the output
-   * packet with the
-   * field sizes embedded.
-   */
-
-  bufp = if_info.pkt;
+  iov[0].iov_base = hdr;
+  iov[0].iov_len = hdr_len;
+  iov[1].iov_base = data;
+  iov[1].iov_len = data_len;
+  return send_pktv(dest_address, iov, 2);
+}
 
-  sz = hdr_len;
-  memcpy(bufp, hdr, sz);
-  bufp += sz;
+int
+network_send_pktv(network_address_t dest_address,
+                  struct iovec* iov, int iovcnt) {
+  int i;
+  int pktlen = 0;
 
-  sz = data_len;
-  memcpy(bufp, data, sz);
-  bufp += sz;
+  if (synthetic_network) {
+    if(genrand() < loss_rate) {
+      for (i = 0; i < iovcnt; i++)
+        pktlen += iov[i].iov_len;
+      return pktlen;
+    }
 
-  network_address_to_sockaddr(dest_address, &sin);
-  cc = sendto(if_info.sock,
-              if_info.pkt,
-              pktlen,
-              0,
-              (struct sockaddr *) &sin,
-              sizeof(sin));
+    if(genrand() < duplication_rate)
+      send_pktv(dest_address, iov, iovcnt);
+  }
 
-  return cc;
+  return send_pktv(dest_address, iov, iovcnt);
 }
 
 int
@@ -320,14 +394,21 @@ bcast_add_link(bcast_t* bcast, char* src, char* dest) {
   int srcnum, destnum;
   int i;
 
+  interrupt_level_t l;
+
   srcnum = hostname_to_entry(bcast, src);
   destnum = hostname_to_entry(bcast, dest);
 
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&topology_lock);
   for (i=0; i<bcast->entries[srcnum].n_links; i++)
     if (bcast->entries[srcnum].links[i] == destnum)
-      return;
+      break;
 
-  bcast->entries[srcnum].links[bcast->entries[srcnum].n_links++] = destnum;
+  if (i == bcast->entries[srcnum].n_links)
+    bcast->entries[srcnum].links[bcast->entries[srcnum].n_links++] = destnum;
+  atomic_clear(&topology_lock);
+  set_interrupt_level(l);
 }
 
 void
@@ -335,9 +416,13 @@ bcast_remove_link(bcast_t* bcast, char* src, char* dest) {
   int srcnum, destnum;
   int i;
 
+  interrupt_level_t l;
+
   srcnum = hostname_to_entry(bcast, src);
   destnum = hostname_to_entry(bcast, dest);
 
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&topology_lock);
   for (i=0; i<bcast->entries[srcnum].n_links; i++)
     if (bcast->entries[srcnum].links[i] == destnum) {
       if (i < bcast->entries[srcnum].n_links-1) {
@@ -348,10 +433,15 @@ bcast_remove_link(bcast_t* bcast, char* src, char* dest) {
       else
         bcast->entries[srcnum].n_links--;
     }
+  atomic_clear(&topology_lock);
+  set_interrupt_level(l);
 }
 
 int
 network_bcast_pkt(int hdr_len, char* hdr, int data_len, char* data) {
+  int links[BCAST_MAX_ENTRIES];
+  interrupt_level_t l;
+  int n_links;
   int i;
   int me;
 
@@ -362,8 +452,16 @@ network_bcast_pkt(int hdr_len, char* hdr, int data_len, char* data) {
 
     me = topology.me;
 
-    for (i=0; i<topology.entries[me].n_links; i++) {
-      int dest = topology.entries[me].links[i];
+    /* a snapshot of the links, so they are not held while sending */
+    l = set_interrupt_level(DISABLED);
+    spin_acquire(&topology_lock);
+    n_links = topology.entries[me].n_links;
+    memcpy(links, topology.entries[me].links, n_links * sizeof(int));
+    atomic_clear(&topology_lock);
+    set_interrupt_level(l);
+
+    for (i=0; i<n_links; i++) {
+      int dest = links[i];
 
       if (synthetic_network) {
         if(genrand() < loss_rate)
@@ -406,43 +504,287 @@ network_remove_bcast_link(char* src, char* dest) {
 }
 
 
-int network_poll(void* arg) {
-  int* s;
-  network_interrupt_arg_t* packet;
-  struct sockaddr_in addr;
-  unsigned int fromlen = sizeof(struct sockaddr_in);
+static void
+pool_initialize() {
+  pkt_class* cl;
+  int c;
+  int i;
 
-  s = (int *) arg;
+  for (c = 0; c < NETWORK_PKT_CLASSES; c++) {
+    cl = &pkt_classes[c];
+    cl->stride = (sizeof(network_interrupt_arg_t) + NETWORK_PKT_HEADROOM +
+                  cl->stats.capacity + 15) & ~15;
+    cl->buffers = (char*)malloc(cl->stats.pool_size * cl->stride);
+    cl->free = (network_interrupt_arg_t**)
+        malloc(cl->stats.pool_size * sizeof(network_interrupt_arg_t*));
+    AbortOnCondition(cl->buffers == NULL || cl->free == NULL, "malloc");
+    for (i = 0; i < cl->stats.pool_size; i++) {
+      cl->free[i] = (network_interrupt_arg_t*)
+          (cl->buffers + (cl->stats.pool_size - 1 - i) * cl->stride);
+    }
+    cl->stats.pool_free = cl->stats.pool_size;
+  }
+}
 
-  for (;;) {
+/*
+ * Returns the smallest class holding len bytes.
+ */
+static int
+pkt_class_for(int len) {
+  int c;
 
-    /* we rely on run_user_handler to destroy this data structure */
-    if (DEBUG)
-      kprintf("NET:Allocating an incoming packet.\n");
+  for (c = 0; c < LARGEST_CLASS; c++) {
+    if (len <= pkt_classes[c].stats.capacity)
+      break;
+  }
+  return c;
+}
 
-    packet =
-      (network_interrupt_arg_t *) malloc(sizeof(network_interrupt_arg_t));
-    assert(packet != NULL);
+/*
+ * Takes a buffer of class cl from its pool, or returns NULL if it is
+ * empty. pool_lock must be held.
+ */
+static network_interrupt_arg_t*
+pool_pop(pkt_class* cl) {
+  if (cl->stats.pool_free == 0) {
+    cl->stats.malloced++;
+    return NULL;
+  }
+  return cl->free[--cl->stats.pool_free];
+}
 
-    packet->size = recvfrom(*s, packet->buffer, MAX_NETWORK_PKT_SIZE,
-                            0, (struct sockaddr *) &addr, &fromlen);
-    if (packet->size <= 0) {
-      kprintf("NET:Error, %d.\n", errno);
-      AbortOnCondition(1,"Crashing.");
+/*
+ * Counts a packet of class c handed out for len bytes. pool_lock must
+ * be held.
+ */
+static void
+pool_count(int c, int len) {
+  pkt_class* cl = &pkt_classes[c];
+
+  cl->stats.allocs++;
+  cl->stats.in_use++;
+  if (cl->stats.in_use > cl->stats.peak_in_use)
+    cl->stats.peak_in_use = cl->stats.in_use;
+  cl->stats.bytes += cl->stride;
+  cl->stats.payload += len;
+}
+
+/*
+ * Sets up pkt, a buffer of class c from pool_pop, to hold len bytes,
+ * and returns it. If pool_pop came back empty handed, pkt is NULL and a
+ * buffer is malloced instead.
+ */
+static network_interrupt_arg_t*
+pkt_init(network_interrupt_arg_t* pkt, int c, int len) {
+  if (pkt == NULL) {
+    pkt = (network_interrupt_arg_t*)malloc(pkt_classes[c].stride);
+    AbortOnCondition(pkt == NULL, "malloc");
+  }
+  pkt->pkt_class = c;
+  pkt->length = len;
+  pkt->data = pkt->head + NETWORK_PKT_HEADROOM;
+  pkt->size = len;
+  return pkt;
+}
+
+/*
+ * Gives n packets back to their pools, or to free if they were malloced.
+ */
+static void
+pool_give(network_interrupt_arg_t** pkts, int n) {
+  interrupt_level_t l;
+  pkt_class* cl;
+  char* p;
+  int i;
+
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&pool_lock);
+  for (i = 0; i < n; i++) {
+    cl = &pkt_classes[pkts[i]->pkt_class];
+    cl->stats.in_use--;
+    cl->stats.bytes -= cl->stride;
+    cl->stats.payload -= pkts[i]->length;
+    p = (char*)pkts[i];
+    if (p >= cl->buffers && p < cl->buffers + cl->stats.pool_size * cl->stride)
+      cl->free[cl->stats.pool_free++] = pkts[i];
+    else
+      free(pkts[i]);
+  }
+  atomic_clear(&pool_lock);
+  set_interrupt_level(l);
+}
+
+network_interrupt_arg_t*
+network_pkt_alloc(int len) {
+  network_interrupt_arg_t* pkt;
+  interrupt_level_t l;
+  int c;
+
+  if (len < 0 || len > MAX_NETWORK_PKT_SIZE)
+    return NULL;
+  pthread_once(&pool_once, pool_initialize);
+  c = pkt_class_for(len);
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&pool_lock);
+  pkt = pool_pop(&pkt_classes[c]);
+  pool_count(c, len);
+  atomic_clear(&pool_lock);
+  set_interrupt_level(l);
+  return pkt_init(pkt, c, len);
+}
+
+void
+network_free_pkt(network_interrupt_arg_t* pkt) {
+  pool_give(&pkt, 1);
+}
+
+int
+network_get_pkt_stats(network_pkt_stats* stats) {
+  interrupt_level_t l;
+  int c;
+
+  if (stats == NULL)
+    return -1;
+  pthread_once(&pool_once, pool_initialize);
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&pool_lock);
+  for (c = 0; c < NETWORK_PKT_CLASSES; c++) {
+    stats[c] = pkt_classes[c].stats;
+  }
+  atomic_clear(&pool_lock);
+  set_interrupt_level(l);
+  return 0;
+}
+
+void
+network_print_pkt_stats() {
+  network_pkt_stats stats[NETWORK_PKT_CLASSES];
+  int c;
+
+  network_get_pkt_stats(stats);
+  printf("%8s %6s %6s %8s %8s %10s %10s %10s %8s\n", "CLASS", "POOL",
+         "FREE", "IN USE", "PEAK", "BYTES", "PAYLOAD", "ALLOCS", "MALLOCED");
+  for (c = 0; c < NETWORK_PKT_CLASSES; c++) {
+    printf("%8d %6d %6d %8ld %8ld %10ld %10ld %10ld %8ld\n",
+           stats[c].capacity, stats[c].pool_size, stats[c].pool_free,
+           stats[c].in_use, stats[c].peak_in_use, stats[c].bytes,
+           stats[c].payload, stats[c].allocs, stats[c].malloced);
+  }
+}
+
+char*
+network_pkt_pull(network_interrupt_arg_t* pkt, int len) {
+  if (len < 0 || len > pkt->size)
+    return NULL;
+  pkt->data += len;
+  pkt->size -= len;
+  return pkt->data;
+}
+
+char*
+network_pkt_push(network_interrupt_arg_t* pkt, int len) {
+  if (len < 0 || len > pkt->data - pkt->head)
+    return NULL;
+  pkt->data -= len;
+  pkt->size += len;
+  return pkt->data;
+}
+
+int
+network_receive_batch(int sock, network_interrupt_arg_t** pkts, int max) {
+  struct mmsghdr msgs[NETWORK_RECEIVE_BATCH];
+  struct iovec iov[NETWORK_RECEIVE_BATCH];
+  struct sockaddr_in addrs[NETWORK_RECEIVE_BATCH];
+  pkt_class* largest = &pkt_classes[LARGEST_CLASS];
+  interrupt_level_t l;
+  int size;
+  int c;
+  int got;
+  int i;
+
+  if (max > NETWORK_RECEIVE_BATCH)
+    max = NETWORK_RECEIVE_BATCH;
+  if (max < 1)
+    return 0;
+  pthread_once(&pool_once, pool_initialize);
+  if (rx_ring[0] == NULL) {
+    l = set_interrupt_level(DISABLED);
+    spin_acquire(&pool_lock);
+    for (i = 0; i < NETWORK_RECEIVE_BATCH; i++)
+      rx_ring[i] = pool_pop(largest);
+    atomic_clear(&pool_lock);
+    set_interrupt_level(l);
+    for (i = 0; i < NETWORK_RECEIVE_BATCH; i++)
+      rx_ring[i] = pkt_init(rx_ring[i], LARGEST_CLASS, 0);
+  }
+
+  memset(msgs, 0, max * sizeof(struct mmsghdr));
+  for (i = 0; i < max; i++) {
+    iov[i].iov_base = rx_ring[i]->head + NETWORK_PKT_HEADROOM;
+    iov[i].iov_len = MAX_NETWORK_PKT_SIZE;
+    msgs[i].msg_hdr.msg_name = &addrs[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  got = recvmmsg(sock, msgs, max, MSG_DONTWAIT, NULL);
+  if (got < 0)
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+  //one trip to the pools for the whole batch
+  l = set_interrupt_level(DISABLED);
+  spin_acquire(&pool_lock);
+  for (i = 0; i < got; i++) {
+    size = msgs[i].msg_len;
+    c = pkt_class_for(size);
+    if (c == LARGEST_CLASS) {
+      pkts[i] = rx_ring[i];
+      rx_ring[i] = pool_pop(largest);
+    }
+    else {
+      pkts[i] = pool_pop(&pkt_classes[c]);
+    }
+    pool_count(c, size);
+  }
+  atomic_clear(&pool_lock);
+  set_interrupt_level(l);
+
+  for (i = 0; i < got; i++) {
+    size = msgs[i].msg_len;
+    c = pkt_class_for(size);
+    if (c == LARGEST_CLASS) {
+      rx_ring[i] = pkt_init(rx_ring[i], LARGEST_CLASS, 0);
+      pkt_init(pkts[i], c, size);
     }
-    else if (DEBUG)
-      kprintf("NET:Received a packet, seqno %d.\n", ntohl(*((int *) packet->buffer)));
+    else {
+      pkts[i] = pkt_init(pkts[i], c, size);
+      memcpy(pkts[i]->data, rx_ring[i]->head + NETWORK_PKT_HEADROOM, size);
+    }
+    sockaddr_to_network_address(&addrs[i], pkts[i]->sender);
+  }
+  return got;
+}
 
-    assert(fromlen == sizeof(struct sockaddr_in));
-    sockaddr_to_network_address(&addr, packet->sender);
+/*
+ * Called by the I/O thread when the socket is readable: passes on the
+ * packets waiting, up to a batch at a time so the other devices get a
+ * turn. The consumers give the packets back with network_free_pkt.
+ */
+static void
+network_poll(int s, void* arg) {
+  network_interrupt_arg_t* packets[NETWORK_RECEIVE_BATCH];
+  int n;
+  int i;
 
-    /*
-     * now we have filled in the arg to the network interrupt service routine,
-     * so we have to get the user's thread to run it.
-     */
+  n = network_receive_batch(s, packets, NETWORK_RECEIVE_BATCH);
+  if (n < 0) {
+    kprintf("NET:Error, %d.\n", errno);
+    AbortOnCondition(1,"Crashing.");
+  }
+  for (i = 0; i < n; i++) {
     if (DEBUG)
-      kprintf("NET:packet arrived.\n");
-    send_interrupt(NETWORK_INTERRUPT_TYPE, mini_network_handler, (void*)packet);
+      kprintf("NET:Received a packet, seqno %d.\n", ntohl(*((int *) packets[i]->data)));
+    send_interrupt(NETWORK_INTERRUPT_TYPE, mini_network_handler, (void*)packets[i]);
   }
 }
 
@@ -452,29 +794,8 @@ int network_poll(void* arg) {
  * that clock_init has been called!
  */
 void start_network_poll(interrupt_handler_t network_handler, int* s) {
-  pthread_t network_thread;
-  sigset_t set;
-  sigset_t old_set;
-  struct sigaction sa;
-  sigemptyset(&set);
-  sigaddset(&set,SIGRTMAX-1);
-  sigaddset(&set,SIGRTMAX-2);
-  sigprocmask(SIG_BLOCK,&set,&old_set);
-
-  /* create clock and return threads, but discard ids */
-  AbortOnCondition(pthread_create(&network_thread, NULL, (void*)network_poll, s),
-      "pthread");
-
-  sa.sa_handler = (void*)handle_interrupt;
-  sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
-  sa.sa_sigaction= (void*)handle_interrupt;
-  sigemptyset(&sa.sa_mask);
-  sigaddset(&sa.sa_mask,SIGRTMAX-2);
-  sigaddset(&sa.sa_mask,SIGRTMAX-1);
-  if (sigaction(SIGRTMAX-2, &sa, NULL) == -1)
-      AbortOnError(0);
-
-  pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+  AbortOnCondition(interrupt_add_source(*s, network_poll, NULL) == -1,
+      "epoll_ctl");
 }
 
 int
@@ -10,7 +10,10 @@
  *      same or different hosts.
  */
 
+#include <sys/uio.h>
+
 #define MAX_NETWORK_PKT_SIZE    8192
+#define NETWORK_MAX_IOV         8 /* fragments per network_send_pktv */
 
 #define BCAST_ENABLED 1
 #define BCAST_USE_TOPOLOGY_FILE 1
@@ -25,17 +28,107 @@ typedef unsigned int network_address_t[2];
 *  Network interrupt handler                                                   *
 *******************************************************************************/
 
-/* the argument to the network interrupt handler */
+/*
+ * The argument to the network interrupt handler, and the one packet
+ * type every layer uses: a packet is the size bytes from data on,
+ * inside head. Packets are received NETWORK_PKT_HEADROOM bytes into
+ * head, so headers can be put in front of them in place. Each layer
+ * finds its header at data and takes it off with network_pkt_pull,
+ * leaving data at the next layer's, so nothing is ever moved.
+ *
+ * head is only as big as the packet's size class needs (see
+ * network_pkt_alloc), so packets are never declared, only allocated.
+ */
+#define NETWORK_PKT_HEADROOM 256
+
 typedef struct {
     network_address_t sender;
-    char buffer[MAX_NETWORK_PKT_SIZE];
+    char* data;
     int size;
+    int pkt_class; /* the size class head came from */
+    int length; /* bytes put in it when it was allocated, for the stats */
+    char head[];
 } network_interrupt_arg_t;
 
 /* the type of an interrupt handler.  These functions are responsible for freeing
- * the argument that is passed in */
+ * the argument that is passed in, with network_free_pkt */
 typedef void (*network_handler_t)(network_interrupt_arg_t *arg);
 
+/*
+ * Packets come in size classes, holding up to 256 bytes, 2 KB or a
+ * whole MAX_NETWORK_PKT_SIZE bytes after the headroom, so that a queue
+ * of acks and route replies does not hold 8 KB for each of them. Each
+ * class has a pool of buffers set up once, so receiving does not go to
+ * malloc for each packet; if a pool runs dry, its packets are malloced
+ * until buffers come back to it.
+ */
+#define NETWORK_PKT_CLASSES 3
+#define NETWORK_RECEIVE_BATCH 32
+
+/*
+ * Returns a packet from the smallest class holding len bytes, with data
+ * at the headroom and size len, or NULL if len is more than
+ * MAX_NETWORK_PKT_SIZE.
+ */
+network_interrupt_arg_t* network_pkt_alloc(int len);
+
+/*
+ * Gives a packet back to its pool, or to free. May be called with
+ * interrupts at any level.
+ */
+void network_free_pkt(network_interrupt_arg_t *pkt);
+
+/*
+ * What the packets of a size class are taking up, for
+ * network_get_pkt_stats.
+ */
+typedef struct {
+    int capacity; /* bytes after the headroom */
+    int pool_size; /* buffers in its pool */
+    int pool_free; /* the receiver keeps a batch of the largest */
+    long in_use; /* packets allocated and not freed */
+    long peak_in_use;
+    long bytes; /* memory the packets in use take up */
+    long payload; /* bytes the packets in use were allocated with */
+    long allocs;
+    long malloced; /* allocations the pool was empty for */
+} network_pkt_stats;
+
+/*
+ * Copies the stats of each of the NETWORK_PKT_CLASSES classes, smallest
+ * first, into stats. Returns 0 (success) or -1 (failure).
+ */
+int network_get_pkt_stats(network_pkt_stats *stats);
+
+/*
+ * prints the packet memory stats.
+ */
+void network_print_pkt_stats();
+
+/*
+ * Takes len bytes off the front of pkt and returns where it starts now,
+ * or NULL if pkt is shorter than that.
+ */
+char* network_pkt_pull(network_interrupt_arg_t *pkt, int len);
+
+/*
+ * Makes room for len bytes in front of pkt, out of the space before
+ * it in head, and returns where it starts now, or NULL if there is not
+ * that much room.
+ */
+char* network_pkt_push(network_interrupt_arg_t *pkt, int len);
+
+/*
+ * Receives up to max (at most NETWORK_RECEIVE_BATCH) datagrams waiting
+ * on the UDP socket sock with one system call, and puts them in pkts.
+ * They are received into a batch of full sized packets kept from one
+ * call to the next, and those that fit a smaller class are copied into
+ * one. Returns how many it received, 0 if none were waiting, or -1 on
+ * error. Only one thread may call it at a time. Used by the network
+ * interrupt; exported for the benchmarks.
+ */
+int network_receive_batch(int sock, network_interrupt_arg_t **pkts, int max);
+
 /*
  * network_initialize should be called before clock interrupts start
  * happening (or with clock interrupts disabled).  The initialization
@@ -71,6 +164,15 @@ network_send_pkt(network_address_t dest_address,
                  int hdr_len, char * hdr,
                  int  data_len, char * data);
 
+/*
+ * network_send_pktv sends the iovcnt (at most NETWORK_MAX_IOV) fragments
+ * in iov, in order, as one packet, straight from where they are without
+ * copying them together first. Returns the number of bytes sent, or -1.
+ */
+int
+network_send_pktv(network_address_t dest_address,
+                  struct iovec* iov, int iovcnt);
+
 int
 network_bcast_pkt(int hdr_len, char* hdr, int data_len, char* data);
 
@@ -3,6 +3,7 @@
  *
  */
 #include "queue.h"
+#include "slab.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -17,6 +18,8 @@ typedef struct queue{
   struct node_t* tail;
 } queue;
 
+static slab_cache node_cache = SLAB_CACHE_INIT("queue node", node_t);
+
 /*
  * Return an empty queue.
  */
@@ -42,7 +45,7 @@ queue_prepend(queue_t queue, void* item) {
   if (queue == NULL){
     return -1;
   }
-  new_node = (node_t*)malloc(sizeof(node_t));
+  new_node = (node_t*)slab_alloc(&node_cache);
   if (new_node == NULL){
     return -1;
   }
@@ -66,7 +69,7 @@ queue_append(queue_t queue, void* item) {
   if (queue == NULL){
     return -1;
   }
-  new_node = (node_t*)malloc(sizeof(node_t));
+  new_node = (node_t*)slab_alloc(&node_cache);
   if (new_node == NULL){
     return -1;
   }
@@ -95,13 +98,13 @@ queue_dequeue(queue_t queue, void** item) {
   }
   *item = queue->head->item;
   if (queue->len == 1){
-    free(queue->head);
+    slab_free(&node_cache, queue->head);
     queue->head = NULL;
     queue->tail = NULL;
   } else {
     tmp = queue->head;
     queue->head = queue->head->next;
-    free(tmp);
+    slab_free(&node_cache, tmp);
   }
   queue->len--;
   return 0;
@@ -151,7 +154,7 @@ queue_free (queue_t queue) {
       return -1;
     }
     tmp_ = tmp->next;
-    free(tmp);
+    slab_free(&node_cache, tmp);
     tmp = tmp_;
     curr_len--;
   }
@@ -199,7 +202,7 @@ queue_delete(queue_t queue, void* item) {
           queue->tail = NULL;
         }
       }
-      free(runner);
+      slab_free(&node_cache, runner);
       queue->len--;
       return 0;
     }
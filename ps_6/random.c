@@ -28,6 +28,10 @@
 /* matumoto@math.keio.ac.jp                                        */
 
 #include<stdio.h>
+#include<sched.h>
+
+#include "interrupts.h"
+#include "machineprimitives.h"
 
 /* Period parameters */
 #define N 624
@@ -47,9 +51,14 @@
 static unsigned long mt[N]; /* the array for the state vector  */
 static int mti=N+1; /* mti==N+1 means mt[N] is not initialized */
 
+/* mt and mti are shared by every caller (the disk, the network's      */
+/* synthetic loss, threads on any processor), so sgenrand and genrand */
+/* hold this spin lock, with interrupts disabled as processors hold it */
+static tas_lock_t rand_lock = 0;
+
 /* initializing the array with a NONZERO seed */
-void
-sgenrand(seed)
+static void
+sgenrand_unlocked(seed)
     unsigned long seed;
 {
     /* setting initial seeds to mt[N] using         */
@@ -61,9 +70,9 @@ sgenrand(seed)
         mt[mti] = (69069 * mt[mti-1]) & 0xffffffff;
 }
 
-double /* generating reals */
+static double /* generating reals */
 /* unsigned long */ /* for integer generation */
-genrand()
+genrand_unlocked()
 {
     unsigned long y;
     static unsigned long mag01[2]={0x0, MATRIX_A};
@@ -73,7 +82,7 @@ genrand()
         int kk;
 
         if (mti == N+1)   /* if sgenrand() has not been called, */
-            sgenrand(4357); /* a default initial seed is used   */
+            sgenrand_unlocked(4357); /* a default initial seed is used   */
 
         for (kk=0;kk<N-M;kk++) {
             y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
@@ -99,6 +108,42 @@ genrand()
     /* return y; */ /* for integer generation */
 }
 
+static interrupt_level_t
+rand_lock_acquire()
+{
+    interrupt_level_t l = set_interrupt_level(DISABLED);
+
+    while (atomic_test_and_set(&rand_lock))
+        sched_yield();
+    return l;
+}
+
+static void
+rand_lock_release(interrupt_level_t l)
+{
+    atomic_clear(&rand_lock);
+    set_interrupt_level(l);
+}
+
+void
+sgenrand(unsigned long seed)
+{
+    interrupt_level_t l = rand_lock_acquire();
+
+    sgenrand_unlocked(seed);
+    rand_lock_release(l);
+}
+
+double
+genrand()
+{
+    interrupt_level_t l = rand_lock_acquire();
+    double r = genrand_unlocked();
+
+    rand_lock_release(l);
+    return r;
+}
+
 unsigned int genintrand(unsigned int maxval){
   return (unsigned long)
     (genrand()* (unsigned long)0xffffffff ) % maxval +1;
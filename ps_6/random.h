@@ -31,6 +31,7 @@
 #ifndef __RANDOM_H__
 #define __RANDOM_H__
 
+/* both may be called from any thread or processor at once */
 void   sgenrand(unsigned long);
 double genrand();
 unsigned int genintrand(unsigned int);
@@ -7,10 +7,14 @@
 #include "synch.h"
 #include "interrupts.h"
 #include  <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 
 #define MAX_LINE_LENGTH 512
 #define READ_INTERRUPT_TYPE 3
+#define READ_CHUNK 4096
 
 struct kb_line {
 	struct kb_line* next;
@@ -20,11 +24,17 @@ struct kb_line {
 struct kb_line* kb_head;
 struct kb_line* kb_tail;
 
+/* the line being read, on the I/O thread */
+static struct kb_line* kb_partial;
+static int kb_partial_len;
+
 semaphore_t new_data;
 
 void read_handler(void* arg) {
 	struct kb_line* node = (struct kb_line*) arg;
-	set_interrupt_level(DISABLED);
+	interrupt_level_t l;
+
+	l = set_interrupt_level(DISABLED);
 
 	if (kb_head == NULL) {
 		kb_head = node;
@@ -34,32 +44,59 @@ void read_handler(void* arg) {
 		kb_tail = node;
 	}
 
-	set_interrupt_level(ENABLED);
 	semaphore_V(new_data);
+	set_interrupt_level(l);
 }
 
-int read_poll(void* arg) {
-
-	struct kb_line* new_node;
-
-	while (1) {
-		new_node = (struct kb_line*) malloc(sizeof(struct kb_line));
-		new_node->next = NULL;
-
-		fgets(new_node->buf, MAX_LINE_LENGTH, stdin);
+/*
+ * Called by the I/O thread when stdin is readable: cuts what is read
+ * into lines, as fgets would, and passes each one on. When stdin is a
+ * file, which epoll cannot wait on, an eventfd that is always readable
+ * stands in for it until the end of the file.
+ */
+void read_poll(int fd, void* arg) {
+	char buf[READ_CHUNK];
+	int n;
+	int i;
+
+	n = read(0, buf, READ_CHUNK);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+
+	/* at end of input there will be no more lines; stop polling
+	   rather than spin sending empty ones */
+	if (n <= 0) {
+		if (kb_partial != NULL && kb_partial_len > 0) {
+			send_interrupt(READ_INTERRUPT_TYPE, read_handler, kb_partial);
+		} else {
+			free(kb_partial);
+		}
+		kb_partial = NULL;
+		interrupt_remove_source(fd);
+		if (fd != 0)
+			close(fd);
+		return;
+	}
 
-		send_interrupt(READ_INTERRUPT_TYPE, read_handler, new_node);
+	for (i = 0; i < n; i++) {
+		if (kb_partial == NULL) {
+			kb_partial = (struct kb_line*) malloc(sizeof(struct kb_line));
+			kb_partial->next = NULL;
+			kb_partial_len = 0;
+		}
+		kb_partial->buf[kb_partial_len++] = buf[i];
+		kb_partial->buf[kb_partial_len] = 0;
+		if (buf[i] == '\n' || kb_partial_len == MAX_LINE_LENGTH - 1) {
+			send_interrupt(READ_INTERRUPT_TYPE, read_handler, kb_partial);
+			kb_partial = NULL;
+		}
 	}
 }
 
 
 int miniterm_initialize() {
-	pthread_t read_thread;
-    sigset_t set;
-    sigset_t old_set;
-    sigfillset(&set);
-    sigprocmask(SIG_BLOCK,&set,&old_set);
-
+	uint64_t one = 1;
+	int fd;
 
 	kprintf("Starting read interrupts.\n");
     mini_read_handler = read_handler;
@@ -70,12 +107,13 @@ int miniterm_initialize() {
 	new_data = semaphore_create();
 	semaphore_initialize(new_data, 0);
 
-    AbortOnCondition(pthread_create(&read_thread, NULL, (void*)read_poll, NULL)!=0,
-      "pthread");
-
-    sigdelset(&old_set,SIGRTMAX-2);
-    sigdelset(&old_set,SIGRTMAX-1);
-    pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+	if (interrupt_add_source(0, read_poll, NULL) == -1) {
+		fd = eventfd(0, 0);
+		AbortOnCondition(fd == -1 || write(fd, &one, sizeof(one)) != sizeof(one),
+		  "eventfd");
+		AbortOnCondition(interrupt_add_source(fd, read_poll, NULL) == -1,
+		  "epoll_ctl");
+	}
 
 	return 0;
 }
@@ -0,0 +1,478 @@
+/*
+ * Scheduling policies for the processors' run queues.
+ */
+#include <stdlib.h>
+#include "sched_policy.h"
+#include "multilevel_queue.h"
+
+#define HEAP_INITIAL_CAPACITY 16
+#define STRIDE1 (1 << 20)
+
+typedef struct sched_ops {
+  int (*enqueue)(sched_rq_t rq, sched_entity_t se, int why);
+  sched_entity_t (*dequeue)(sched_rq_t rq);
+  int (*remove)(sched_rq_t rq, sched_entity_t se);
+  int (*tick)(sched_rq_t rq, sched_entity_t se);
+} sched_ops;
+
+/*
+ * A run queue holds the state of every policy, but only the part its
+ * own policy uses is ever filled in: mlfq uses levels, stride and edf
+ * use the heap, and lottery uses the list. System threads are on a FIFO
+ * of their own, outside the policy, and are not in count.
+ */
+typedef struct sched_rq {
+  sched_policy_t policy;
+  sched_ops* ops;
+  int count;
+  uint64_t rng;
+
+  multilevel_queue_t levels;
+
+  sched_entity_t* heap;
+  int heap_capacity;
+  uint64_t next_seq;
+  uint64_t pass; //pass of the last thread taken off, stride only
+
+  sched_entity_t head;
+  sched_entity_t tail;
+  uint64_t total_tickets;
+
+  sched_entity_t system_head;
+  sched_entity_t system_tail;
+  int system_count;
+  sched_entity_t system_yielded; //lets a user thread go before it
+} sched_rq;
+
+/*
+ * xorshift64*: a few shifts and a multiply per number, and good
+ * enough for picking levels and lottery winners.
+ */
+uint64_t
+sched_random(sched_rq_t rq) {
+  rq->rng ^= rq->rng >> 12;
+  rq->rng ^= rq->rng << 25;
+  rq->rng ^= rq->rng >> 27;
+  return rq->rng * 2685821657736338717ULL;
+}
+
+/* HEAP, ordered by (key, seq) */
+
+static int
+heap_before(sched_entity_t a, sched_entity_t b) {
+  return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+static int
+heap_push(sched_rq_t rq, sched_entity_t se) {
+  sched_entity_t* new_heap;
+  int i = rq->count;
+
+  if (rq->count == rq->heap_capacity) {
+    new_heap = (sched_entity_t*)realloc(rq->heap,
+        2 * rq->heap_capacity * sizeof(sched_entity_t));
+    if (new_heap == NULL) return -1;
+    rq->heap = new_heap;
+    rq->heap_capacity *= 2;
+  }
+  se->seq = rq->next_seq++;
+
+  //sift up
+  while (i > 0 && heap_before(se, rq->heap[(i - 1) / 2])) {
+    rq->heap[i] = rq->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  rq->heap[i] = se;
+  rq->count++;
+  return 0;
+}
+
+static sched_entity_t
+heap_pop(sched_rq_t rq) {
+  sched_entity_t top;
+  sched_entity_t last;
+  int i = 0;
+  int child;
+
+  if (rq->count == 0) return NULL;
+  top = rq->heap[0];
+  last = rq->heap[--rq->count];
+
+  //sift down
+  while ((child = 2 * i + 1) < rq->count) {
+    if (child + 1 < rq->count && heap_before(rq->heap[child + 1], rq->heap[child])) {
+      child++;
+    }
+    if (!heap_before(rq->heap[child], last)) break;
+    rq->heap[i] = rq->heap[child];
+    i = child;
+  }
+  rq->heap[i] = last;
+  return top;
+}
+
+/*
+ * Takes se out of the middle of the heap: the last entry fills its hole
+ * and sifts whichever way it has to. Finding se is a linear scan.
+ */
+static int
+heap_remove(sched_rq_t rq, sched_entity_t se) {
+  sched_entity_t last;
+  int i;
+  int child;
+
+  for (i = 0; i < rq->count && rq->heap[i] != se; i++);
+  if (i == rq->count) return -1;
+  last = rq->heap[--rq->count];
+  if (i == rq->count) return 0;
+
+  //sift up
+  while (i > 0 && heap_before(last, rq->heap[(i - 1) / 2])) {
+    rq->heap[i] = rq->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  //sift down
+  while ((child = 2 * i + 1) < rq->count) {
+    if (child + 1 < rq->count && heap_before(rq->heap[child + 1], rq->heap[child])) {
+      child++;
+    }
+    if (!heap_before(rq->heap[child], last)) break;
+    rq->heap[i] = rq->heap[child];
+    i = child;
+  }
+  rq->heap[i] = last;
+  return 0;
+}
+
+/* MLFQ */
+
+static int
+mlfq_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  if (why == SCHED_PREEMPT) {
+    if (se->level < SCHED_LEVELS - 1) se->level++;
+    se->rem_quanta = 1 << se->level;
+  }
+  else if (why == SCHED_NEW) {
+    if (se->level < 0) se->level = 0;
+    if (se->level > SCHED_LEVELS - 1) se->level = SCHED_LEVELS - 1;
+    se->rem_quanta = 1 << se->level;
+  }
+  else {
+    //back to its own priority, not to the top level
+    se->level = se->priority;
+    se->rem_quanta = 1 << se->level;
+  }
+  if (multilevel_queue_enqueue(rq->levels, se->level, se) == -1) return -1;
+  rq->count++;
+  return 0;
+}
+
+static sched_entity_t
+mlfq_dequeue(sched_rq_t rq) {
+  sched_entity_t se = NULL;
+  int num;
+  int level;
+
+  num = sched_random(rq) % 100;
+  if (num < 50) level = 0;
+  else if (num < 75) level = 1;
+  else if (num < 90) level = 2;
+  else level = 3;
+
+  if (multilevel_queue_dequeue(rq->levels, level, (void**)(&se)) == -1) return NULL;
+  rq->count--;
+  return se;
+}
+
+static int
+mlfq_remove(sched_rq_t rq, sched_entity_t se) {
+  if (multilevel_queue_delete(rq->levels, se->level, se) == -1) return -1;
+  rq->count--;
+  return 0;
+}
+
+static int
+mlfq_tick(sched_rq_t rq, sched_entity_t se) {
+  return --(se->rem_quanta) <= 0;
+}
+
+/* STRIDE */
+
+static int
+stride_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  //a thread that slept, or came from another processor, starts even
+  //with the others instead of catching up on the time it missed
+  if (se->pass < rq->pass) se->pass = rq->pass;
+  se->key = se->pass;
+  return heap_push(rq, se);
+}
+
+static sched_entity_t
+stride_dequeue(sched_rq_t rq) {
+  sched_entity_t se = heap_pop(rq);
+
+  if (se != NULL) rq->pass = se->pass;
+  return se;
+}
+
+static int
+stride_remove(sched_rq_t rq, sched_entity_t se) {
+  return heap_remove(rq, se);
+}
+
+static int
+stride_tick(sched_rq_t rq, sched_entity_t se) {
+  se->pass += STRIDE1 / se->tickets;
+  return 1;
+}
+
+/* LOTTERY */
+
+/*
+ * A thread holds the tickets it had when it was put on the queue until
+ * it comes off, so total_tickets stays the sum of the keys.
+ */
+static int
+lottery_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  se->key = se->tickets;
+  se->next = NULL;
+  if (rq->tail == NULL) rq->head = se;
+  else rq->tail->next = se;
+  rq->tail = se;
+  rq->total_tickets += se->key;
+  rq->count++;
+  return 0;
+}
+
+static sched_entity_t
+lottery_dequeue(sched_rq_t rq) {
+  sched_entity_t se = rq->head;
+  sched_entity_t prev = NULL;
+  uint64_t winner;
+
+  if (rq->count == 0) return NULL;
+  winner = sched_random(rq) % rq->total_tickets;
+  while (winner >= se->key) {
+    winner -= se->key;
+    prev = se;
+    se = se->next;
+  }
+
+  if (prev == NULL) rq->head = se->next;
+  else prev->next = se->next;
+  if (rq->tail == se) rq->tail = prev;
+  rq->total_tickets -= se->key;
+  rq->count--;
+  return se;
+}
+
+static int
+lottery_remove(sched_rq_t rq, sched_entity_t se) {
+  sched_entity_t prev = NULL;
+  sched_entity_t cur = rq->head;
+
+  while (cur != NULL && cur != se) {
+    prev = cur;
+    cur = cur->next;
+  }
+  if (cur == NULL) return -1;
+
+  if (prev == NULL) rq->head = se->next;
+  else prev->next = se->next;
+  if (rq->tail == se) rq->tail = prev;
+  rq->total_tickets -= se->key;
+  rq->count--;
+  return 0;
+}
+
+static int
+lottery_tick(sched_rq_t rq, sched_entity_t se) {
+  return 1;
+}
+
+/* EDF */
+
+static int
+edf_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  se->key = (uint64_t)se->deadline;
+  return heap_push(rq, se);
+}
+
+static sched_entity_t
+edf_dequeue(sched_rq_t rq) {
+  return heap_pop(rq);
+}
+
+static int
+edf_remove(sched_rq_t rq, sched_entity_t se) {
+  return heap_remove(rq, se);
+}
+
+/*
+ * Only give up the processor to a thread whose deadline is no later,
+ * so threads with equal deadlines (or none) take turns.
+ */
+static int
+edf_tick(sched_rq_t rq, sched_entity_t se) {
+  return rq->count > 0 && rq->heap[0]->key <= (uint64_t)se->deadline;
+}
+
+/* SYSTEM CLASS */
+
+/*
+ * A system thread that gives up the processor, rather than blocking,
+ * lets the other system threads and then one user thread have it before
+ * it goes again, so that a busy kernel thread cannot shut user threads
+ * out altogether.
+ */
+static int
+system_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  if (why == SCHED_YIELD || why == SCHED_PREEMPT) rq->system_yielded = se;
+  se->next = NULL;
+  if (rq->system_tail == NULL) rq->system_head = se;
+  else rq->system_tail->next = se;
+  rq->system_tail = se;
+  rq->system_count++;
+  return 0;
+}
+
+static sched_entity_t
+system_dequeue(sched_rq_t rq) {
+  sched_entity_t se = rq->system_head;
+
+  if (rq->system_yielded == se) rq->system_yielded = NULL;
+  rq->system_head = se->next;
+  if (rq->system_head == NULL) rq->system_tail = NULL;
+  rq->system_count--;
+  return se;
+}
+
+static int
+system_remove(sched_rq_t rq, sched_entity_t se) {
+  sched_entity_t prev = NULL;
+  sched_entity_t cur = rq->system_head;
+
+  while (cur != NULL && cur != se) {
+    prev = cur;
+    cur = cur->next;
+  }
+  if (cur == NULL) return -1;
+
+  if (rq->system_yielded == se) rq->system_yielded = NULL;
+  if (prev == NULL) rq->system_head = se->next;
+  else prev->next = se->next;
+  if (rq->system_tail == se) rq->system_tail = prev;
+  rq->system_count--;
+  return 0;
+}
+
+static sched_ops policy_ops[] = {
+  { mlfq_enqueue, mlfq_dequeue, mlfq_remove, mlfq_tick },
+  { stride_enqueue, stride_dequeue, stride_remove, stride_tick },
+  { lottery_enqueue, lottery_dequeue, lottery_remove, lottery_tick },
+  { edf_enqueue, edf_dequeue, edf_remove, edf_tick },
+};
+
+void
+sched_entity_init(sched_entity_t se, struct minithread* thread) {
+  se->thread = thread;
+  se->sched_class = SCHED_USER;
+  se->priority = 0;
+  se->level = 0;
+  se->rem_quanta = 1;
+  se->tickets = SCHED_DEFAULT_TICKETS;
+  se->pass = 0;
+  se->deadline = SCHED_NO_DEADLINE;
+  se->key = 0;
+  se->seq = 0;
+  se->next = NULL;
+}
+
+sched_rq_t
+sched_rq_new(sched_policy_t policy, uint64_t seed) {
+  sched_rq_t rq;
+
+  if (policy < SCHED_MLFQ || policy > SCHED_EDF) return NULL;
+
+  rq = (sched_rq_t)calloc(1, sizeof(sched_rq));
+  if (rq == NULL) return NULL;
+
+  rq->policy = policy;
+  rq->ops = &policy_ops[policy];
+  //xorshift gets stuck at 0
+  rq->rng = seed != 0 ? seed : 0x9E3779B97F4A7C15ULL;
+
+  if (policy == SCHED_MLFQ) {
+    rq->levels = multilevel_queue_new(SCHED_LEVELS);
+    if (rq->levels == NULL) {
+      free(rq);
+      return NULL;
+    }
+  }
+  else if (policy == SCHED_STRIDE || policy == SCHED_EDF) {
+    rq->heap = (sched_entity_t*)malloc(HEAP_INITIAL_CAPACITY * sizeof(sched_entity_t));
+    if (rq->heap == NULL) {
+      free(rq);
+      return NULL;
+    }
+    rq->heap_capacity = HEAP_INITIAL_CAPACITY;
+  }
+  return rq;
+}
+
+int
+sched_enqueue(sched_rq_t rq, sched_entity_t se, int why) {
+  if (rq == NULL || se == NULL) return -1;
+  if (se->sched_class == SCHED_SYSTEM) return system_enqueue(rq, se, why);
+  return rq->ops->enqueue(rq, se, why);
+}
+
+sched_entity_t
+sched_dequeue(sched_rq_t rq) {
+  if (rq == NULL) return NULL;
+  if (sched_system_waiting(rq)) return system_dequeue(rq);
+  if (rq->count == 0) return NULL;
+  rq->system_yielded = NULL;
+  return rq->ops->dequeue(rq);
+}
+
+int
+sched_remove(sched_rq_t rq, sched_entity_t se) {
+  if (rq == NULL || se == NULL) return -1;
+  if (se->sched_class == SCHED_SYSTEM) return system_remove(rq, se);
+  return rq->ops->remove(rq, se);
+}
+
+/*
+ * System threads take turns with each other, and a user thread's slice
+ * is still charged when a system thread cuts it short.
+ */
+int
+sched_tick(sched_rq_t rq, sched_entity_t se) {
+  int over = 0;
+
+  if (se->sched_class == SCHED_USER) over = rq->ops->tick(rq, se);
+  if (over) return SCHED_TICK_OVER;
+  return sched_system_waiting(rq) ? SCHED_TICK_SYSTEM : SCHED_TICK_RUN;
+}
+
+int
+sched_system_waiting(sched_rq_t rq) {
+  return rq->system_head != NULL &&
+      (rq->system_head != rq->system_yielded || rq->count == 0);
+}
+
+int
+sched_rq_length(sched_rq_t rq) {
+  if (rq == NULL) return -1;
+  return rq->count + rq->system_count;
+}
+
+int
+sched_rq_free(sched_rq_t rq) {
+  if (rq == NULL) return -1;
+  if (rq->levels != NULL) multilevel_queue_free(rq->levels);
+  free(rq->heap);
+  free(rq);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Scheduling policies for the processors' run queues.
+ *
+ * Every processor keeps its runnable threads in a sched_rq_t, and the
+ * policy the run queue was made with decides which thread comes off it
+ * next and how long that thread gets to run. The policies are:
+ *
+ *  SCHED_MLFQ     multilevel feedback queue. A thread starts at level 0
+ *                 and drops a level each time it uses up its slice;
+ *                 level n gets 2^n quanta. Levels are picked 50/25/15/10
+ *                 percent of the time, from level 0 to level 3.
+ *  SCHED_STRIDE   stride scheduling. Threads get the processor in
+ *                 proportion to their tickets, deterministically.
+ *  SCHED_LOTTERY  lottery scheduling. Threads get the processor in
+ *                 proportion to their tickets, on average.
+ *  SCHED_EDF      earliest deadline first. Threads without a deadline
+ *                 run round robin, after every thread that has one.
+ *
+ * Whatever the policy, threads in the system class (kernel threads like
+ * the packet processor) are kept apart from it, and always come off the
+ * run queue ahead of the others, round robin among themselves.
+ *
+ * All of these functions must be called with interrupts disabled.
+ */
+#ifndef __SCHED_POLICY_H__
+#define __SCHED_POLICY_H__
+
+#include "inttypes.h"
+
+typedef enum {
+  SCHED_MLFQ,
+  SCHED_STRIDE,
+  SCHED_LOTTERY,
+  SCHED_EDF
+} sched_policy_t;
+
+#define SCHED_LEVELS 4
+#define SCHED_DEFAULT_TICKETS 100
+#define SCHED_NO_DEADLINE INT64_MAX
+
+/* Why a thread is being put on a run queue */
+#define SCHED_WAKEUP 0  /* it was blocked */
+#define SCHED_YIELD 1   /* it gave up the processor */
+#define SCHED_PREEMPT 2 /* it used up its slice */
+#define SCHED_NEW 3     /* it has not run yet, and starts at its level */
+
+/* What sched_tick says about the running thread */
+#define SCHED_TICK_RUN 0    /* it keeps running */
+#define SCHED_TICK_OVER 1   /* its slice is over */
+#define SCHED_TICK_SYSTEM 2 /* a system thread cuts its slice short */
+
+/* Scheduling classes */
+#define SCHED_USER 0    /* scheduled by the run queue's policy */
+#define SCHED_SYSTEM 1  /* ahead of every user thread */
+
+/*
+ * The scheduling state of a thread. It lives inside the thread, so run
+ * queues link and order these instead of allocating anything.
+ */
+typedef struct sched_entity {
+  struct minithread* thread;
+  int sched_class;    /* SCHED_USER or SCHED_SYSTEM */
+  int priority;       /* mlfq level to go back to after blocking or yielding */
+  int level;          /* mlfq level */
+  int rem_quanta;     /* quanta left in this slice */
+  int tickets;        /* stride and lottery share */
+  uint64_t pass;      /* stride virtual time */
+  int64_t deadline;   /* edf deadline, in clock ticks */
+  uint64_t key;       /* pass, deadline or tickets while queued */
+  uint64_t seq;       /* heap order among equal keys, oldest first */
+  struct sched_entity* next;
+} sched_entity;
+
+typedef sched_entity* sched_entity_t;
+
+/*
+ * sched_rq_t is a pointer to an internally maintained run queue.
+ */
+typedef struct sched_rq* sched_rq_t;
+
+/*
+ * Set up the scheduling state of a new thread: the user class, priority
+ * and level 0, the default number of tickets and no deadline.
+ */
+extern void sched_entity_init(sched_entity_t se, struct minithread* thread);
+
+/*
+ * Returns an empty run queue scheduled by policy, with its own random
+ * number generator started from seed. Returns NULL on error.
+ */
+extern sched_rq_t sched_rq_new(sched_policy_t policy, uint64_t seed);
+
+/*
+ * Puts se on the run queue. why is one of SCHED_WAKEUP, SCHED_YIELD,
+ * SCHED_PREEMPT and SCHED_NEW. Return 0 (success) or -1 (failure).
+ */
+extern int sched_enqueue(sched_rq_t rq, sched_entity_t se, int why);
+
+/*
+ * Takes the thread that should run next off the run queue, or returns
+ * NULL if it is empty.
+ */
+extern sched_entity_t sched_dequeue(sched_rq_t rq);
+
+/*
+ * Takes se off the run queue wherever it is, so it can be run out of
+ * turn. Return 0 (success) or -1 (failure) if se is not on the queue.
+ */
+extern int sched_remove(sched_rq_t rq, sched_entity_t se);
+
+/*
+ * Charges one clock tick to se, which is running on rq's processor.
+ * Returns SCHED_TICK_OVER if its slice is over, SCHED_TICK_SYSTEM if it
+ * is not but a system thread would come off the run queue ahead of it,
+ * and SCHED_TICK_RUN if it should keep running.
+ */
+extern int sched_tick(sched_rq_t rq, sched_entity_t se);
+
+/*
+ * Returns 1 if a system thread on the run queue would come off it next,
+ * 0 otherwise.
+ */
+extern int sched_system_waiting(sched_rq_t rq);
+
+/*
+ * Returns the number of threads on the run queue.
+ */
+extern int sched_rq_length(sched_rq_t rq);
+
+/*
+ * Returns the next number from rq's xorshift generator. Cheap enough
+ * to call on every scheduling decision.
+ */
+extern uint64_t sched_random(sched_rq_t rq);
+
+/*
+ * Free the run queue and return 0 (success) or -1 (failure). The threads
+ * on it are not freed.
+ */
+extern int sched_rq_free(sched_rq_t rq);
+
+#endif /*__SCHED_POLICY_H__*/
@@ -0,0 +1,291 @@
+/* sched_policy_test.c
+   Tests the scheduling policies: each one should hand out the
+   processor in the shares it promises, and let threads be taken off
+   its run queue out of turn. System threads should run ahead of them
+   all, under every policy.
+*/
+#include "sched_policy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define RUNS 100000
+
+/*
+ * Runs the threads on rq for RUNS slices of one tick each and counts
+ * how many slices each got. Threads whose slice is not over after a
+ * tick keep running.
+ */
+void
+run(sched_rq_t rq, sched_entity* se, int* slices, int n) {
+  int i;
+  sched_entity_t next;
+
+  for (i = 0; i < n; i++) {
+    slices[i] = 0;
+  }
+  next = sched_dequeue(rq);
+  for (i = 0; i < RUNS; i++) {
+    slices[next - se]++;
+    if (sched_tick(rq, next)) {
+      sched_enqueue(rq, next, SCHED_PREEMPT);
+      next = sched_dequeue(rq);
+    }
+  }
+  sched_enqueue(rq, next, SCHED_YIELD);
+}
+
+void
+test_mlfq(void) {
+  sched_entity se[SCHED_LEVELS];
+  int picked[SCHED_LEVELS] = {0, 0, 0, 0};
+  int share[SCHED_LEVELS] = {50, 25, 15, 10};
+  sched_rq_t rq = sched_rq_new(SCHED_MLFQ, 1);
+  sched_entity_t next;
+  int i;
+
+  // one thread on every level
+  for (i = 0; i < SCHED_LEVELS; i++) {
+    sched_entity_init(&se[i], NULL);
+    se[i].level = i - 1;
+    assert(sched_enqueue(rq, &se[i], SCHED_PREEMPT) == 0);
+    assert(se[i].level == i);
+    assert(se[i].rem_quanta == 1 << i);
+  }
+  assert(sched_rq_length(rq) == SCHED_LEVELS);
+
+  // the levels come up in the intended proportions
+  for (i = 0; i < RUNS; i++) {
+    next = sched_dequeue(rq);
+    picked[next->level]++;
+    next->level--;
+    sched_enqueue(rq, next, SCHED_PREEMPT);
+  }
+  for (i = 0; i < SCHED_LEVELS; i++) {
+    assert(abs(picked[i] - share[i] * (RUNS / 100)) < RUNS / 100);
+  }
+
+  // waking up or yielding goes back to the thread's priority
+  next = sched_dequeue(rq);
+  sched_enqueue(rq, next, SCHED_YIELD);
+  assert(next->level == 0 && next->rem_quanta == 1);
+  next = sched_dequeue(rq);
+  next->priority = 2;
+  next->level = 2;
+  sched_enqueue(rq, next, SCHED_PREEMPT);
+  assert(next->level == 3);
+  assert(sched_remove(rq, next) == 0);
+  sched_enqueue(rq, next, SCHED_WAKEUP);
+  assert(next->level == 2 && next->rem_quanta == 4);
+  assert(sched_remove(rq, next) == 0);
+  next->priority = 0;
+  sched_enqueue(rq, next, SCHED_WAKEUP);
+
+  // new threads start at the level they were given
+  next = sched_dequeue(rq);
+  next->level = 2;
+  sched_enqueue(rq, next, SCHED_NEW);
+  assert(next->level == 2 && next->rem_quanta == 4);
+  sched_rq_free(rq);
+}
+
+void
+test_stride(void) {
+  sched_entity se[3];
+  int slices[3];
+  int i;
+  sched_rq_t rq = sched_rq_new(SCHED_STRIDE, 1);
+
+  for (i = 0; i < 3; i++) {
+    sched_entity_init(&se[i], NULL);
+    se[i].tickets = 100 * (i + 1);
+    sched_enqueue(rq, &se[i], SCHED_WAKEUP);
+  }
+  run(rq, se, slices, 3);
+
+  // exact shares, but for rounding in the strides
+  for (i = 0; i < 3; i++) {
+    assert(abs(slices[i] - (i + 1) * RUNS / 6) < RUNS / 10000);
+  }
+  sched_rq_free(rq);
+}
+
+void
+test_lottery(void) {
+  sched_entity se[3];
+  int slices[3];
+  int i;
+  sched_rq_t rq = sched_rq_new(SCHED_LOTTERY, 1);
+
+  for (i = 0; i < 3; i++) {
+    sched_entity_init(&se[i], NULL);
+    se[i].tickets = 100 * (i + 1);
+    sched_enqueue(rq, &se[i], SCHED_WAKEUP);
+  }
+  run(rq, se, slices, 3);
+
+  // shares on average, within 2% of all slices
+  for (i = 0; i < 3; i++) {
+    assert(abs(slices[i] - (i + 1) * RUNS / 6) < RUNS / 50);
+  }
+  for (i = 0; i < 3; i++) {
+    assert(sched_dequeue(rq) != NULL);
+  }
+  assert(sched_dequeue(rq) == NULL);
+  sched_rq_free(rq);
+}
+
+void
+test_edf(void) {
+  sched_entity se[4];
+  int slices[4];
+  int i;
+  sched_rq_t rq = sched_rq_new(SCHED_EDF, 1);
+
+  for (i = 0; i < 4; i++) {
+    sched_entity_init(&se[i], NULL);
+  }
+  se[0].deadline = 30;
+  se[1].deadline = 10;
+  se[2].deadline = 20;
+  for (i = 0; i < 4; i++) {
+    sched_enqueue(rq, &se[i], SCHED_WAKEUP);
+  }
+
+  // earliest deadline first, then threads without one
+  assert(sched_dequeue(rq) == &se[1]);
+  assert(sched_dequeue(rq) == &se[2]);
+  assert(sched_dequeue(rq) == &se[0]);
+  assert(sched_dequeue(rq) == &se[3]);
+  assert(sched_dequeue(rq) == NULL);
+
+  // a thread keeps running while nothing more urgent is waiting
+  sched_enqueue(rq, &se[3], SCHED_WAKEUP);
+  assert(sched_tick(rq, &se[1]) == SCHED_TICK_RUN);
+  assert(sched_tick(rq, &se[3]) == SCHED_TICK_OVER);
+  assert(sched_dequeue(rq) == &se[3]);
+
+  // threads without deadlines take turns
+  se[0].deadline = SCHED_NO_DEADLINE;
+  se[1].deadline = SCHED_NO_DEADLINE;
+  sched_enqueue(rq, &se[0], SCHED_WAKEUP);
+  sched_enqueue(rq, &se[1], SCHED_WAKEUP);
+  run(rq, se, slices, 2);
+  assert(slices[0] == RUNS / 2 && slices[1] == RUNS / 2);
+  sched_rq_free(rq);
+}
+
+/*
+ * Threads taken off the middle of a run queue never come off it again,
+ * under every policy, and the rest still come off in order under edf.
+ */
+void
+test_remove(void) {
+  sched_entity se[5];
+  sched_entity other;
+  sched_rq_t rq;
+  sched_entity_t next;
+  int policy;
+  int i;
+
+  for (policy = SCHED_MLFQ; policy <= SCHED_EDF; policy++) {
+    rq = sched_rq_new(policy, 1);
+    sched_entity_init(&other, NULL);
+    for (i = 0; i < 5; i++) {
+      sched_entity_init(&se[i], NULL);
+      se[i].deadline = 10 * (i + 1);
+      sched_enqueue(rq, &se[i], SCHED_WAKEUP);
+    }
+    assert(sched_remove(rq, &se[2]) == 0);
+    assert(sched_remove(rq, &se[0]) == 0);
+    assert(sched_remove(rq, &se[2]) == -1);
+    assert(sched_remove(rq, &other) == -1);
+    assert(sched_rq_length(rq) == 3);
+    for (i = 0; i < 3; i++) {
+      next = sched_dequeue(rq);
+      assert(next != &se[0] && next != &se[2]);
+      if (policy == SCHED_EDF) {
+        assert(next == &se[i == 0 ? 1 : i + 2]);
+      }
+    }
+    assert(sched_dequeue(rq) == NULL);
+    sched_rq_free(rq);
+  }
+}
+
+/*
+ * System threads come off first, round robin, under every policy, cut
+ * user threads' slices short, and let one user thread go after yielding.
+ */
+void
+test_system(void) {
+  sched_entity user[2];
+  sched_entity sys[2];
+  sched_rq_t rq;
+  int policy;
+  int i;
+
+  for (policy = SCHED_MLFQ; policy <= SCHED_EDF; policy++) {
+    rq = sched_rq_new(policy, 1);
+    for (i = 0; i < 2; i++) {
+      sched_entity_init(&user[i], NULL);
+      sched_entity_init(&sys[i], NULL);
+      sys[i].sched_class = SCHED_SYSTEM;
+      user[i].deadline = 10;
+    }
+    sched_enqueue(rq, &user[0], SCHED_WAKEUP);
+    sched_enqueue(rq, &sys[0], SCHED_WAKEUP);
+    sched_enqueue(rq, &user[1], SCHED_WAKEUP);
+    sched_enqueue(rq, &sys[1], SCHED_WAKEUP);
+    assert(sched_rq_length(rq) == 4);
+    assert(sched_system_waiting(rq));
+    assert(sched_dequeue(rq) == &sys[0]);
+    assert(sched_dequeue(rq) == &sys[1]);
+    assert(!sched_system_waiting(rq));
+
+    // a waiting system thread ends a user thread's slice, and system
+    // threads only give way to each other
+    sched_enqueue(rq, &sys[1], SCHED_WAKEUP);
+    assert(sched_tick(rq, &user[0]) != SCHED_TICK_RUN);
+    assert(sched_tick(rq, &sys[0]) == SCHED_TICK_SYSTEM);
+    if (policy == SCHED_MLFQ) {
+      // cut short, not over, so the user thread is not demoted for it
+      user[0].rem_quanta = 3;
+      assert(sched_tick(rq, &user[0]) == SCHED_TICK_SYSTEM);
+    }
+    assert(sched_dequeue(rq) == &sys[1]);
+    assert(sched_tick(rq, &sys[1]) == SCHED_TICK_RUN);
+
+    // yielding lets a user thread in first, and cuts nobody short
+    sched_enqueue(rq, &sys[1], SCHED_YIELD);
+    assert(sched_tick(rq, &sys[0]) == SCHED_TICK_RUN);
+    if (policy == SCHED_MLFQ) {
+      user[0].rem_quanta = 3;
+      assert(sched_tick(rq, &user[0]) == SCHED_TICK_RUN);
+    }
+    assert(sched_dequeue(rq)->sched_class == SCHED_USER);
+    assert(sched_dequeue(rq) == &sys[1]);
+
+    assert(sched_remove(rq, &sys[1]) == -1);
+    sched_enqueue(rq, &sys[0], SCHED_WAKEUP);
+    assert(sched_remove(rq, &sys[0]) == 0);
+    assert(sched_rq_length(rq) == 1);
+    assert(sched_dequeue(rq)->sched_class == SCHED_USER);
+    assert(sched_dequeue(rq) == NULL);
+    sched_rq_free(rq);
+  }
+}
+
+int
+main(void) {
+  assert(sched_rq_new(SCHED_EDF + 1, 1) == NULL);
+  test_mlfq();
+  test_stride();
+  test_lottery();
+  test_edf();
+  test_remove();
+  test_system();
+  printf("All scheduling policy tests passed.\n");
+  return 0;
+}
@@ -7,6 +7,7 @@
 #include <assert.h>
 
 #include "minifile.h"
+#include "network.h"
 
 #define COPY_BUFFER_SIZE 1024
 
@@ -151,6 +152,8 @@ void help_screen() {
 	printf(" input path - input a text file from standard input\n");
 	printf(" cp (copy) src dest - copy src file to dest file\n");
 	printf(" mv (move) src dest - move src file to dest file\n");
+	printf(" top - show what the scheduler and each thread have done\n");
+	printf(" netstat - show the memory held by network packets\n");
 	printf(" whoami - print your identity\n");
 	printf(" help - show this screen\n");
 	printf(" exit - exit shell\n");
@@ -211,6 +214,10 @@ int shell(int *g) {
 			copy(arg1,arg2);
 		else if(strcmp(func,"mv") == 0 || strcmp(func,"move") == 0)
 			move(arg1,arg2);
+		else if(strcmp(func,"top") == 0)
+			minithread_print_stats();
+		else if(strcmp(func,"netstat") == 0)
+			network_print_pkt_stats();
 		else if(strcmp(func,"whoami") == 0)
 			printf("You are minithread %d, running our shell\n",minithread_id());
 		else if(strcmp(func,"exit") == 0)
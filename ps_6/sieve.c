@@ -9,6 +9,18 @@
  * filter thread for each new prime, which subsequently filters out
  * all multiples of that prime from the pipe.
  *
+ * There is a filter thread per prime, 78498 of them for MAXPRIME, so
+ * they get small stacks without guard pages.
+ *
+ * Threads pass numbers down the pipeline in batches, through channels
+ * of CHANNEL_SIZE numbers, so a thread only gives up the processor
+ * when its output channel fills up or its input runs dry, instead of
+ * once per number.
+ *
+ * Usage: sieve [max] [handoff]
+ * With handoff set to 1, a thread that wakes up its neighbour in the
+ * pipeline hands it the processor (see channel_set_handoff).
+ *
  */
 #include <stdlib.h>
 #include <stdio.h>
@@ -16,102 +28,118 @@
 #include "synch.h"
 
 #define MAXPRIME 1000000
+#define CHANNEL_SIZE 16
 
 typedef struct {
-  int value;
-  semaphore_t produce;
-  semaphore_t consume;
-} channel_t;
-
-typedef struct {
-  channel_t* left;
-  channel_t* right;
+  channel_t left;
+  channel_t right;
   int prime;
 } filter_t;
 
 
 int max = MAXPRIME;
+int handoff = 0;
 
-/* produce all integers from 2 to max */
-int source(int* arg) {
-  channel_t* c = (channel_t *) arg;
-  int i;
+channel_t channel_new() {
+  channel_t c = channel_create(CHANNEL_SIZE);
 
-  for (i=2; i<=max; i++) {
-    c->value = i;
-    semaphore_V(c->consume);
-    semaphore_P(c->produce);
+  channel_set_handoff(c, handoff);
+  return c;
+}
+
+/* produce all integers from 2 to max, then -1 */
+int source(int* arg) {
+  channel_t c = (channel_t) arg;
+  void* batch[CHANNEL_SIZE];
+  int i = 2;
+  int n;
+
+  while (i <= max) {
+    for (n = 0; n < CHANNEL_SIZE && i <= max; n++, i++) {
+      batch[n] = (void *) (long) i;
+    }
+    channel_send_batch(c, batch, n);
   }
-  
-  c->value = -1;
-  semaphore_V(c->consume);
+
+  channel_send(c, (void *) -1L);
 
   return 0;
 }
 
 int filter(int* arg) {
   filter_t* f = (filter_t *) arg;
-  int value;
-
-  for (;;) {
-    semaphore_P(f->left->consume);
-    value = f->left->value;
-    semaphore_V(f->left->produce);
-    if ((value == -1) || (value % f->prime != 0)) {
-      f->right->value = value;
-      semaphore_V(f->right->consume);
-      semaphore_P(f->right->produce);
+  void* in[CHANNEL_SIZE];
+  void* out[CHANNEL_SIZE];
+  long value = 0;
+  int i, n, passed;
+
+  while (value != -1) {
+    n = channel_receive_batch(f->left, in, CHANNEL_SIZE);
+    passed = 0;
+    for (i = 0; i < n; i++) {
+      value = (long) in[i];
+      if ((value == -1) || (value % f->prime != 0)) {
+        out[passed++] = in[i];
+      }
     }
-    if (value == -1)
-      break;
+    channel_send_batch(f->right, out, passed);
   }
 
   return 0;
 }
 
 int sink(int* arg) {
-  channel_t* p = (channel_t *) malloc(sizeof(channel_t));
-  int value;
-
-  p->produce = semaphore_create();
-  semaphore_initialize(p->produce, 0);
-  p->consume = semaphore_create();
-  semaphore_initialize(p->consume, 0);
+  channel_t p = channel_new();
+  long value;
+  int primes = 0;
+  uint64_t start = minithread_time_ns();
+  long switches = minithread_context_switches();
+  minithread_attr attr;
+
+  minithread_attr_init(&attr);
+  attr.stack_size = MIN_STACKSIZE;
+  attr.guard_size = 0;
+  attr.name = "filter";
 
   minithread_fork(source, (int *) p);
   
   for (;;) {
     filter_t* f;
 
-    semaphore_P(p->consume);
-    value = p->value;
-    semaphore_V(p->produce);
-    
+    value = (long) channel_receive(p);
+
     if (value == -1)
       break;
 
-    printf("%d is prime.\n", value);
+    printf("%ld is prime.\n", value);
+    primes++;
     
     f = (filter_t *) malloc(sizeof(filter_t));
     f->left = p;
     f->prime = value;
     
-    p = (channel_t *) malloc(sizeof(channel_t));
-    p->produce = semaphore_create();
-    semaphore_initialize(p->produce, 0);
-    p->consume = semaphore_create();
-    semaphore_initialize(p->consume, 0);
-    
+    p = channel_new();
     f->right = p;
 
-    minithread_fork(filter, (int *) f);
+    minithread_fork_ex(filter, (int *) f, &attr);
   }
 
+  printf("%d primes up to %d in %lu ms, %.2f context switches per number, "
+      "handoff %s\n", primes, max,
+      (unsigned long)((minithread_time_ns() - start) / 1000000),
+      (double)(minithread_context_switches() - switches) / (max - 1),
+      handoff ? "on" : "off");
   return 0;
 }
 
 int
 main(int argc, char * argv[]) {
+  if (argc > 1) {
+    max = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    handoff = atoi(argv[2]);
+  }
   minithread_system_initialize(sink, NULL);
   return -1;
 }
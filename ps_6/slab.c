@@ -0,0 +1,174 @@
+/*
+ * Slab allocator for kernel objects.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "slab.h"
+#include "interrupts.h"
+#include "minithread.h"
+
+#define SLAB_BYTES (16 * 1024) //size of a slab, unless objects are big
+#define SLAB_MIN_OBJECTS 8
+#define SLAB_ALIGN 16
+
+slab_cache_t all_caches = NULL;
+
+/*
+ * Sets up cache's statistics and puts it on the list of all caches,
+ * the first time it is used. Interrupts must be disabled.
+ */
+static void
+slab_register(slab_cache_t cache) {
+  size_t size = cache->size;
+
+  if (size < sizeof(void*)) size = sizeof(void*);
+  cache->stats.name = cache->name;
+  cache->stats.object_size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+  cache->next = all_caches;
+  all_caches = cache;
+  cache->registered = 1;
+}
+
+/*
+ * Takes a new slab from malloc and puts all of its objects on the free
+ * list. Returns 0 (success) or -1 (failure). Interrupts must be disabled.
+ */
+static int
+slab_grow(slab_cache_t cache) {
+  size_t size = cache->stats.object_size;
+  long count = SLAB_BYTES / size;
+  char* slab;
+  long i;
+
+  if (count < SLAB_MIN_OBJECTS) count = SLAB_MIN_OBJECTS;
+  slab = (char*)malloc(count * size);
+  if (slab == NULL) return -1;
+
+  //link them in address order
+  for (i = count - 1; i >= 0; i--) {
+    *(void**)(slab + i * size) = cache->free_list;
+    cache->free_list = slab + i * size;
+  }
+  cache->stats.slabs++;
+  cache->stats.bytes += count * size;
+  return 0;
+}
+
+/*
+ * Fills half of an empty magazine from the free list, growing the cache
+ * if the free list runs out. Returns 0 (success) or -1 (failure).
+ * Interrupts must be disabled.
+ */
+static int
+slab_refill(slab_cache_t cache, slab_magazine* mag) {
+  void* obj;
+
+  while (mag->rounds < SLAB_MAGAZINE_SIZE / 2) {
+    if (cache->free_list == NULL && slab_grow(cache) == -1) {
+      break;
+    }
+    obj = cache->free_list;
+    cache->free_list = *(void**)obj;
+    mag->objects[mag->rounds++] = obj;
+  }
+  cache->stats.refills++;
+  return mag->rounds > 0 ? 0 : -1;
+}
+
+/*
+ * Empties half of a full magazine into the free list.
+ * Interrupts must be disabled.
+ */
+static void
+slab_flush(slab_cache_t cache, slab_magazine* mag) {
+  void* obj;
+
+  while (mag->rounds > SLAB_MAGAZINE_SIZE / 2) {
+    obj = mag->objects[--mag->rounds];
+    *(void**)obj = cache->free_list;
+    cache->free_list = obj;
+  }
+  cache->stats.flushes++;
+}
+
+static slab_magazine*
+slab_magazine_here(slab_cache_t cache) {
+  return &cache->magazines[minithread_processor() % SLAB_MAX_PROCESSORS];
+}
+
+void*
+slab_alloc(slab_cache_t cache) {
+  interrupt_level_t l;
+  slab_magazine* mag;
+  void* obj = NULL;
+
+  if (cache == NULL) return NULL;
+  l = set_interrupt_level(DISABLED);
+  if (!cache->registered) {
+    slab_register(cache);
+  }
+  mag = slab_magazine_here(cache);
+  if (mag->rounds > 0) {
+    cache->stats.magazine_allocs++;
+  }
+  else if (slab_refill(cache, mag) == -1) {
+    set_interrupt_level(l);
+    return NULL;
+  }
+  obj = mag->objects[--mag->rounds];
+
+  cache->stats.allocs++;
+  cache->stats.in_use++;
+  if (cache->stats.in_use > cache->stats.peak_in_use) {
+    cache->stats.peak_in_use = cache->stats.in_use;
+  }
+  set_interrupt_level(l);
+  return obj;
+}
+
+void
+slab_free(slab_cache_t cache, void* obj) {
+  interrupt_level_t l;
+  slab_magazine* mag;
+
+  if (cache == NULL || obj == NULL) return;
+  l = set_interrupt_level(DISABLED);
+  mag = slab_magazine_here(cache);
+  if (mag->rounds == SLAB_MAGAZINE_SIZE) {
+    slab_flush(cache, mag);
+  }
+  mag->objects[mag->rounds++] = obj;
+  cache->stats.frees++;
+  cache->stats.in_use--;
+  set_interrupt_level(l);
+}
+
+int
+slab_cache_stats(slab_cache_t cache, slab_stats_t stats) {
+  interrupt_level_t l;
+
+  if (cache == NULL || stats == NULL) return -1;
+  l = set_interrupt_level(DISABLED);
+  if (!cache->registered) {
+    slab_register(cache);
+  }
+  *stats = cache->stats;
+  set_interrupt_level(l);
+  return 0;
+}
+
+void
+slab_print_stats() {
+  slab_cache_t cache;
+  slab_stats stats;
+
+  printf("%-20s %6s %9s %9s %9s %7s %9s %7s\n", "cache", "size", "in use",
+      "peak", "allocs", "slabs", "bytes", "mag %");
+  for (cache = all_caches; cache != NULL; cache = cache->next) {
+    slab_cache_stats(cache, &stats);
+    printf("%-20s %6lu %9ld %9ld %9ld %7ld %9ld %7ld\n", stats.name,
+        (unsigned long)stats.object_size, stats.in_use, stats.peak_in_use,
+        stats.allocs, stats.slabs, stats.bytes,
+        stats.allocs > 0 ? stats.magazine_allocs * 100 / stats.allocs : 0);
+  }
+}
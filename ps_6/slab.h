@@ -0,0 +1,94 @@
+/*
+ * Slab allocator for kernel objects.
+ *
+ * A slab cache hands out objects of a single type. It gets memory from
+ * malloc a slab (many objects) at a time and never gives it back, so
+ * allocating and freeing objects is a matter of moving them between
+ * free lists. Each processor keeps a magazine of free objects, so most
+ * allocations and frees only touch the magazine of the processor they
+ * run on; magazines are refilled from, and emptied into, the cache's
+ * free list half a magazine at a time.
+ *
+ * A module declares a cache for each type it allocates:
+ *
+ *   static slab_cache node_cache = SLAB_CACHE_INIT("queue node", node_t);
+ *
+ *   node = (node_t*)slab_alloc(&node_cache);
+ *   slab_free(&node_cache, node);
+ *
+ * Caches need no other set up, and may be used before
+ * minithread_system_initialize. Objects are not zeroed. All of these
+ * functions disable interrupts while they work, and must not be called
+ * from the device threads.
+ */
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include "defs.h"
+
+#define SLAB_MAGAZINE_SIZE 16
+#define SLAB_MAX_PROCESSORS 16 //processors past this share magazines
+
+typedef struct slab_magazine {
+  int rounds; //free objects in the magazine
+  void* objects[SLAB_MAGAZINE_SIZE];
+} slab_magazine;
+
+/*
+ * What a cache has handed out, for slab_cache_stats.
+ */
+typedef struct slab_stats {
+  char* name;
+  size_t object_size; //bytes per object, rounded up for alignment
+  long allocs;
+  long frees;
+  long in_use; //allocated and not freed
+  long peak_in_use;
+  long slabs; //slabs taken from malloc
+  long bytes; //memory taken from malloc
+  long magazine_allocs; //allocations served without refilling a magazine
+  long refills; //magazines filled from the free list
+  long flushes; //magazines emptied into the free list
+} slab_stats;
+
+typedef slab_stats* slab_stats_t;
+
+typedef struct slab_cache {
+  char* name;
+  size_t size;
+  int registered; //on the list of all caches, for slab_print_stats
+  struct slab_cache* next;
+  void* free_list; //free objects not in a magazine, linked through themselves
+  slab_stats stats;
+  slab_magazine magazines[SLAB_MAX_PROCESSORS];
+} slab_cache;
+
+typedef slab_cache* slab_cache_t;
+
+/*
+ * Initializer for a cache of objects of the given type.
+ */
+#define SLAB_CACHE_INIT(name, type) { (name), sizeof(type) }
+
+/*
+ * Return a free object from cache, or NULL if no memory is left.
+ */
+extern void* slab_alloc(slab_cache_t cache);
+
+/*
+ * Give obj, which came from slab_alloc on the same cache, back to cache.
+ * Does nothing if obj is NULL.
+ */
+extern void slab_free(slab_cache_t cache, void* obj);
+
+/*
+ * Copy cache's statistics into stats. Return 0 (success) or -1 (failure).
+ */
+extern int slab_cache_stats(slab_cache_t cache, slab_stats_t stats);
+
+/*
+ * Print a line of statistics for every cache that has been used.
+ */
+extern void slab_print_stats();
+
+#endif /*__SLAB_H__*/
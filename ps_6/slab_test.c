@@ -0,0 +1,94 @@
+/* slab_test.c
+   Tests the slab allocator.
+*/
+#include "slab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define OBJECTS 10000
+
+typedef struct small {
+  int a;
+  void* b;
+  char c;
+} small;
+
+typedef struct big {
+  char data[10000];
+} big;
+
+slab_cache small_cache = SLAB_CACHE_INIT("small", small);
+slab_cache big_cache = SLAB_CACHE_INIT("big", big);
+
+small* objects[OBJECTS];
+
+int
+main(void) {
+  slab_stats stats;
+  big* b;
+  small* s;
+  long slabs;
+  int i;
+  int j;
+
+  assert(slab_alloc(NULL) == NULL);
+  assert(slab_cache_stats(&small_cache, NULL) == -1);
+  slab_free(&small_cache, NULL);
+
+  // objects are distinct, aligned and usable
+  for (i = 0; i < OBJECTS; i++) {
+    objects[i] = (small*)slab_alloc(&small_cache);
+    assert(objects[i] != NULL);
+    assert(((long)objects[i] & 15) == 0);
+    objects[i]->a = i;
+    objects[i]->b = objects[i];
+  }
+  for (i = 0; i < OBJECTS; i++) {
+    assert(objects[i]->a == i && objects[i]->b == objects[i]);
+  }
+  for (i = 0; i < 100; i++) {
+    for (j = i + 1; j < 100; j++) {
+      assert(objects[i] != objects[j]);
+    }
+  }
+  assert(slab_cache_stats(&small_cache, &stats) == 0);
+  assert(stats.object_size == 32);
+  assert(stats.allocs == OBJECTS && stats.in_use == OBJECTS);
+  assert(stats.bytes >= OBJECTS * 32);
+
+  // freed objects are reused without growing the cache
+  for (i = 0; i < OBJECTS; i++) {
+    slab_free(&small_cache, objects[i]);
+  }
+  slab_cache_stats(&small_cache, &stats);
+  assert(stats.in_use == 0 && stats.peak_in_use == OBJECTS);
+  slabs = stats.slabs;
+  for (i = 0; i < OBJECTS; i++) {
+    objects[i] = (small*)slab_alloc(&small_cache);
+  }
+  for (i = 0; i < OBJECTS; i++) {
+    slab_free(&small_cache, objects[i]);
+  }
+  slab_cache_stats(&small_cache, &stats);
+  assert(stats.slabs == slabs && stats.in_use == 0);
+
+  // the last object freed comes back first, from the magazine
+  s = (small*)slab_alloc(&small_cache);
+  slab_free(&small_cache, s);
+  assert(slab_alloc(&small_cache) == s);
+  slab_free(&small_cache, s);
+
+  // big objects still come several to a slab
+  b = (big*)slab_alloc(&big_cache);
+  assert(b != NULL);
+  b->data[sizeof(b->data) - 1] = 1;
+  slab_free(&big_cache, b);
+  slab_cache_stats(&big_cache, &stats);
+  assert(stats.slabs == 1 && stats.bytes >= 8 * sizeof(big));
+
+  slab_print_stats();
+  printf("All slab tests passed.\n");
+  return 0;
+}
@@ -4,9 +4,10 @@
 
 #include "defs.h"
 #include "synch.h"
-#include "queue.h"
+#include "slab.h"
 #include "minithread.h"
 #include "interrupts.h"
+#include "alarm.h"
 
 /*
  *      You must implement the procedures and types defined in this interface.
@@ -17,26 +18,28 @@
  */
 struct semaphore {
   int count;
-  queue_t wait_q;    
+  int handoff; //V switches to the thread it wakes
+  minithread_queue wait_q; //linked through the threads, so blocking never allocates
 };
 
+static slab_cache semaphore_cache = SLAB_CACHE_INIT("semaphore", struct semaphore);
+
 /*
  * semaphore_t semaphore_create()
  *      Allocate a new semaphore.
  */
 semaphore_t semaphore_create() {
   semaphore_t new_sem = NULL;
-  queue_t new_q = NULL;
 
-  new_sem = (semaphore_t)malloc(sizeof(struct semaphore));
-  new_q = queue_new();
+  new_sem = (semaphore_t)slab_alloc(&semaphore_cache);
 
   // check if malloc was successful
-  if (new_sem == NULL || new_q == NULL) return NULL;
+  if (new_sem == NULL) return NULL;
   
   // initialize semaphore fields
   new_sem->count = 0;
-  new_sem->wait_q = new_q;
+  new_sem->handoff = 0;
+  minithread_queue_init(&new_sem->wait_q);
   return new_sem; 
 }
 
@@ -51,8 +54,7 @@ void semaphore_destroy(semaphore_t sem) {
   if (sem == NULL) return;
   
   l = set_interrupt_level(DISABLED); 
-  queue_free(sem->wait_q);
-  free(sem); 
+  slab_free(&semaphore_cache, sem); 
   set_interrupt_level(l);
 }
 
@@ -69,8 +71,14 @@ void semaphore_initialize(semaphore_t sem, int cnt) {
   sem->count = cnt;
 }
 
+void semaphore_set_handoff(semaphore_t sem, int handoff) {
+  if (sem == NULL) return;
+
+  sem->handoff = handoff;
+}
+
 void semaphore_block(semaphore_t sem) {
-  minithread_enqueue_and_schedule(sem->wait_q);
+  minithread_enqueue_and_schedule(&sem->wait_q);
 }
 
 /*
@@ -89,7 +97,7 @@ void semaphore_P(semaphore_t sem) {
 
 
 void semaphore_unblock(semaphore_t sem) {
-  minithread_dequeue_and_run(sem->wait_q);
+  minithread_dequeue_and_run(&sem->wait_q);
 }
 
 /*
@@ -101,7 +109,523 @@ void semaphore_V(semaphore_t sem) {
 
   l = set_interrupt_level(DISABLED);
   if (++sem->count <= 0) {
+    //interrupt handlers, and threads holding the kernel, cannot switch
+    if (sem->handoff && l == ENABLED) {
+      minithread_dequeue_and_switch(&sem->wait_q);
+      return;
+    }
     semaphore_unblock(sem);
   }
   set_interrupt_level(l);
 }
+
+/*
+ * A P waiting with a timeout. The waiting thread and the alarm each
+ * hold a reference, and whichever is done with it last frees it: the
+ * thread may be woken up after the alarm's function has started, and
+ * go on before it is done. Protected by disabling interrupts.
+ */
+typedef struct semaphore_timeout {
+  semaphore_t sem;
+  minithread_t thread;
+  int waiting; //the thread has not woken up yet
+  int fired; //the alarm's function has started
+  int timed_out;
+  int refs;
+} semaphore_timeout;
+
+static slab_cache timeout_cache = SLAB_CACHE_INIT("semaphore timeout", semaphore_timeout);
+
+static void
+semaphore_timeout_put(semaphore_timeout* t) {
+  if (--t->refs == 0) {
+    slab_free(&timeout_cache, t);
+  }
+}
+
+/*
+ * Alarm function: gives up on the P if the thread is still waiting,
+ * as if it had never called it.
+ */
+static void
+semaphore_time_out(void* arg) {
+  semaphore_timeout* t = (semaphore_timeout*)arg;
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  t->fired = 1;
+  if (t->waiting && minithread_queue_contains(&t->sem->wait_q, t->thread)) {
+    minithread_queue_remove(&t->sem->wait_q, t->thread);
+    t->sem->count++;
+    t->timed_out = 1;
+    minithread_start(t->thread);
+  }
+  semaphore_timeout_put(t);
+  set_interrupt_level(l);
+}
+
+/*
+ * int semaphore_P_timeout(semaphore_t sem, int delay)
+ *      P on the semaphore, giving up after delay milliseconds.
+ */
+int semaphore_P_timeout(semaphore_t sem, int delay) {
+  semaphore_timeout* t;
+  alarm_id alarm;
+  int result;
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  if (--sem->count >= 0) {
+    set_interrupt_level(l);
+    return 0;
+  }
+  t = NULL;
+  alarm = NULL;
+  if (delay > 0) {
+    t = (semaphore_timeout*)slab_alloc(&timeout_cache);
+  }
+  if (t != NULL) {
+    t->sem = sem;
+    t->thread = minithread_self();
+    t->waiting = 1;
+    t->fired = 0;
+    t->timed_out = 0;
+    t->refs = 2;
+    alarm = register_alarm(delay, semaphore_time_out, t);
+  }
+  if (alarm == NULL) {
+    slab_free(&timeout_cache, t);
+    sem->count++;
+    set_interrupt_level(l);
+    return -1;
+  }
+
+  semaphore_block(sem);
+  set_interrupt_level(DISABLED);
+  t->waiting = 0;
+  result = t->timed_out ? -1 : 0;
+  //until the function starts the alarm is still ours to deregister;
+  //once it has, the alarm may be gone and its handle reused
+  if (!t->fired && deregister_alarm(alarm) == 0) {
+    t->refs--;
+  }
+  semaphore_timeout_put(t);
+  set_interrupt_level(l);
+  return result;
+}
+
+
+/*
+ * Mutexes.
+ *
+ * state is 0 when the mutex is unlocked, 1 when it is locked, and 2
+ * when it is locked and threads may be waiting for it. It only changes
+ * with atomic instructions, so the uncontended paths never disable
+ * interrupts. A thread about to wait sets it to 2 with interrupts
+ * disabled before going on wait_q, so an unlock that finds 2 and
+ * disables interrupts to wake it up always finds it there.
+ */
+struct mutex {
+  int state;
+  minithread_queue wait_q;
+};
+
+static slab_cache mutex_cache = SLAB_CACHE_INIT("mutex", struct mutex);
+
+mutex_t mutex_create() {
+  mutex_t m = (mutex_t)slab_alloc(&mutex_cache);
+
+  if (m == NULL) return NULL;
+  m->state = 0;
+  minithread_queue_init(&m->wait_q);
+  return m;
+}
+
+void mutex_destroy(mutex_t m) {
+  if (m == NULL) return;
+  slab_free(&mutex_cache, m);
+}
+
+void mutex_lock(mutex_t m) {
+  interrupt_level_t l;
+
+  if (__sync_bool_compare_and_swap(&m->state, 0, 1)) return;
+
+  l = set_interrupt_level(DISABLED);
+  //whoever has it now will wake us up when they unlock it. Having
+  //been woken, we cannot tell whether others still wait, so keep it at 2
+  while (swap(&m->state, 2) != 0) {
+    minithread_enqueue_and_schedule(&m->wait_q);
+    set_interrupt_level(DISABLED);
+  }
+  set_interrupt_level(l);
+}
+
+int mutex_trylock(mutex_t m) {
+  return __sync_bool_compare_and_swap(&m->state, 0, 1) ? 0 : -1;
+}
+
+void mutex_unlock(mutex_t m) {
+  interrupt_level_t l;
+
+  if (swap(&m->state, 0) == 1) return;
+
+  l = set_interrupt_level(DISABLED);
+  if (minithread_queue_length(&m->wait_q) > 0) {
+    minithread_dequeue_and_run(&m->wait_q);
+  }
+  set_interrupt_level(l);
+}
+
+
+/*
+ * Condition variables. wait_q is protected by disabling interrupts,
+ * which also makes unlocking the mutex and going on wait_q one step,
+ * so no signal is missed in between.
+ */
+struct condvar {
+  minithread_queue wait_q;
+};
+
+static slab_cache condvar_cache = SLAB_CACHE_INIT("condvar", struct condvar);
+
+condvar_t condvar_create() {
+  condvar_t cv = (condvar_t)slab_alloc(&condvar_cache);
+
+  if (cv == NULL) return NULL;
+  minithread_queue_init(&cv->wait_q);
+  return cv;
+}
+
+void condvar_destroy(condvar_t cv) {
+  if (cv == NULL) return;
+  slab_free(&condvar_cache, cv);
+}
+
+void condvar_wait(condvar_t cv, mutex_t m) {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  mutex_unlock(m);
+  minithread_enqueue_and_schedule(&cv->wait_q);
+  set_interrupt_level(l);
+  mutex_lock(m);
+}
+
+void condvar_signal(condvar_t cv) {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  if (minithread_queue_length(&cv->wait_q) > 0) {
+    minithread_dequeue_and_run(&cv->wait_q);
+  }
+  set_interrupt_level(l);
+}
+
+void condvar_broadcast(condvar_t cv) {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  while (minithread_queue_length(&cv->wait_q) > 0) {
+    minithread_dequeue_and_run(&cv->wait_q);
+  }
+  set_interrupt_level(l);
+}
+
+
+/*
+ * Reader-writer locks.
+ *
+ * state holds the number of readers holding the lock, plus RW_WRITER
+ * while the writer holds it, plus RW_WAITERS while threads may be
+ * waiting on readers_q or writers_q. As with mutexes, a thread sets
+ * RW_WAITERS with interrupts disabled before it waits, and whoever
+ * leaves the lock unheld with RW_WAITERS set wakes the waiters up.
+ */
+#define RW_WRITER (1 << 30)
+#define RW_WAITERS (1 << 29)
+
+struct rwlock {
+  int state;
+  minithread_queue readers_q;
+  minithread_queue writers_q;
+};
+
+static slab_cache rwlock_cache = SLAB_CACHE_INIT("rwlock", struct rwlock);
+
+rwlock_t rwlock_create() {
+  rwlock_t rw = (rwlock_t)slab_alloc(&rwlock_cache);
+
+  if (rw == NULL) return NULL;
+  rw->state = 0;
+  minithread_queue_init(&rw->readers_q);
+  minithread_queue_init(&rw->writers_q);
+  return rw;
+}
+
+void rwlock_destroy(rwlock_t rw) {
+  if (rw == NULL) return;
+  slab_free(&rwlock_cache, rw);
+}
+
+/*
+ * Wakes up the first waiting writer, or else every waiting reader, once
+ * rw is left unheld with RW_WAITERS set. If someone took the lock in the
+ * meantime, waking them is up to whoever lets go of it next.
+ */
+static void
+rwlock_wake(rwlock_t rw) {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  if (__sync_bool_compare_and_swap(&rw->state, RW_WAITERS, 0)) {
+    if (minithread_queue_length(&rw->writers_q) > 0) {
+      minithread_dequeue_and_run(&rw->writers_q);
+    }
+    else {
+      while (minithread_queue_length(&rw->readers_q) > 0) {
+        minithread_dequeue_and_run(&rw->readers_q);
+      }
+    }
+    if (minithread_queue_length(&rw->writers_q) > 0 ||
+        minithread_queue_length(&rw->readers_q) > 0) {
+      __sync_fetch_and_or(&rw->state, RW_WAITERS);
+    }
+  }
+  set_interrupt_level(l);
+}
+
+void rwlock_read_lock(rwlock_t rw) {
+  int s = rw->state;
+  interrupt_level_t l;
+
+  if (!(s & (RW_WRITER | RW_WAITERS)) &&
+      __sync_bool_compare_and_swap(&rw->state, s, s + 1)) return;
+
+  l = set_interrupt_level(DISABLED);
+  while (1) {
+    s = rw->state;
+    //readers do not pass waiting writers
+    if (!(s & RW_WRITER) && minithread_queue_length(&rw->writers_q) == 0) {
+      if (__sync_bool_compare_and_swap(&rw->state, s, s + 1)) break;
+    }
+    else if (__sync_bool_compare_and_swap(&rw->state, s, s | RW_WAITERS)) {
+      minithread_enqueue_and_schedule(&rw->readers_q);
+      set_interrupt_level(DISABLED);
+    }
+  }
+  set_interrupt_level(l);
+}
+
+void rwlock_read_unlock(rwlock_t rw) {
+  if (__sync_sub_and_fetch(&rw->state, 1) == RW_WAITERS) {
+    rwlock_wake(rw);
+  }
+}
+
+void rwlock_write_lock(rwlock_t rw) {
+  int s;
+  interrupt_level_t l;
+
+  if (__sync_bool_compare_and_swap(&rw->state, 0, RW_WRITER)) return;
+
+  l = set_interrupt_level(DISABLED);
+  while (1) {
+    s = rw->state;
+    if ((s & ~RW_WAITERS) == 0) {
+      if (__sync_bool_compare_and_swap(&rw->state, s, s | RW_WRITER)) break;
+    }
+    else if (__sync_bool_compare_and_swap(&rw->state, s, s | RW_WAITERS)) {
+      minithread_enqueue_and_schedule(&rw->writers_q);
+      set_interrupt_level(DISABLED);
+    }
+  }
+  set_interrupt_level(l);
+}
+
+void rwlock_write_unlock(rwlock_t rw) {
+  if (__sync_sub_and_fetch(&rw->state, RW_WRITER) == RW_WAITERS) {
+    rwlock_wake(rw);
+  }
+}
+
+
+/*
+ * Channels. items is a ring of capacity slots, count of them full
+ * starting at head. Everything is protected by disabling interrupts.
+ * A thread that finds the channel full (or empty) waits on senders_q
+ * (or receivers_q), and checks again when woken, since another thread
+ * may have got there first. Every item put on the channel wakes at most
+ * one waiting receiver, and every item taken off at most one sender.
+ */
+struct channel {
+  void** items;
+  int capacity;
+  int head;
+  int count;
+  int handoff; //a blocking call switches to a thread it wakes
+  minithread_queue senders_q;
+  minithread_queue receivers_q;
+};
+
+static slab_cache channel_cache = SLAB_CACHE_INIT("channel", struct channel);
+
+channel_t channel_create(int capacity) {
+  channel_t c;
+
+  if (capacity < 1) return NULL;
+  c = (channel_t)slab_alloc(&channel_cache);
+  if (c == NULL) return NULL;
+  c->items = (void**)malloc(capacity * sizeof(void*));
+  if (c->items == NULL) {
+    slab_free(&channel_cache, c);
+    return NULL;
+  }
+  c->capacity = capacity;
+  c->head = 0;
+  c->count = 0;
+  c->handoff = 0;
+  minithread_queue_init(&c->senders_q);
+  minithread_queue_init(&c->receivers_q);
+  return c;
+}
+
+void channel_destroy(channel_t c) {
+  if (c == NULL) return;
+  free(c->items);
+  slab_free(&channel_cache, c);
+}
+
+void channel_set_handoff(channel_t c, int handoff) {
+  if (c == NULL) return;
+
+  c->handoff = handoff;
+}
+
+/*
+ * Wakes up to n threads waiting on q. If handoff is set, the last one
+ * runs at once, as with semaphore_V on a handoff semaphore, and it
+ * returns 1, with interrupts enabled again. Otherwise it returns 0.
+ * Interrupts must be disabled.
+ */
+static int
+channel_wake(minithread_queue_t q, int n, int handoff) {
+  int i;
+
+  for (i = 0; i < n && minithread_queue_length(q) > 0; i++) {
+    if (handoff && (i == n - 1 || minithread_queue_length(q) == 1)) {
+      minithread_dequeue_and_switch(q);
+      return 1;
+    }
+    minithread_dequeue_and_run(q);
+  }
+  return 0;
+}
+
+/*
+ * Puts as many of the n items on c as fit, and returns how many that
+ * was. The caller wakes the receivers. Interrupts must be disabled.
+ */
+static int
+channel_put(channel_t c, void** items, int n) {
+  int tail = c->head + c->count;
+  int i;
+
+  if (n > c->capacity - c->count) n = c->capacity - c->count;
+  if (tail >= c->capacity) tail -= c->capacity;
+  for (i = 0; i < n; i++) {
+    c->items[tail] = items[i];
+    if (++tail == c->capacity) tail = 0;
+  }
+  c->count += n;
+  return n;
+}
+
+/*
+ * Takes up to n items off c, and returns how many it took. The caller
+ * wakes the senders. Interrupts must be disabled.
+ */
+static int
+channel_take(channel_t c, void** items, int n) {
+  int i;
+
+  if (n > c->count) n = c->count;
+  for (i = 0; i < n; i++) {
+    items[i] = c->items[c->head];
+    if (++c->head == c->capacity) c->head = 0;
+  }
+  c->count -= n;
+  return n;
+}
+
+void channel_send(channel_t c, void* item) {
+  channel_send_batch(c, &item, 1);
+}
+
+void* channel_receive(channel_t c) {
+  void* item = NULL;
+
+  channel_receive_batch(c, &item, 1);
+  return item;
+}
+
+int channel_try_send(channel_t c, void* item) {
+  interrupt_level_t l;
+  int sent;
+
+  l = set_interrupt_level(DISABLED);
+  sent = channel_put(c, &item, 1);
+  channel_wake(&c->receivers_q, sent, 0);
+  set_interrupt_level(l);
+  return sent == 1 ? 0 : -1;
+}
+
+int channel_try_receive(channel_t c, void** item) {
+  interrupt_level_t l;
+  int taken;
+
+  l = set_interrupt_level(DISABLED);
+  taken = channel_take(c, item, 1);
+  channel_wake(&c->senders_q, taken, 0);
+  set_interrupt_level(l);
+  return taken == 1 ? 0 : -1;
+}
+
+void channel_send_batch(channel_t c, void** items, int n) {
+  interrupt_level_t l;
+  int sent = 0;
+  int put;
+  int switched;
+
+  if (n < 1) return;
+  l = set_interrupt_level(DISABLED);
+  for (;;) {
+    put = channel_put(c, items + sent, n - sent);
+    sent += put;
+    //interrupt handlers, and threads holding the kernel, cannot switch
+    switched = channel_wake(&c->receivers_q, put, c->handoff && l == ENABLED);
+    if (switched) set_interrupt_level(DISABLED);
+    if (sent == n) break;
+    //the receivers it switched to may have made room, so look again
+    if (!switched) {
+      minithread_enqueue_and_schedule(&c->senders_q);
+      set_interrupt_level(DISABLED);
+    }
+  }
+  set_interrupt_level(l);
+}
+
+int channel_receive_batch(channel_t c, void** items, int n) {
+  interrupt_level_t l;
+  int taken;
+
+  if (n < 1) return 0;
+  l = set_interrupt_level(DISABLED);
+  while ((taken = channel_take(c, items, n)) == 0) {
+    minithread_enqueue_and_schedule(&c->receivers_q);
+    set_interrupt_level(DISABLED);
+  }
+  if (!channel_wake(&c->senders_q, taken, c->handoff && l == ENABLED))
+    set_interrupt_level(l);
+  return taken;
+}
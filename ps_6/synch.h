@@ -34,6 +34,16 @@ extern void semaphore_destroy(semaphore_t sem);
 extern void semaphore_initialize(semaphore_t sem, int cnt);
 
 
+/*
+ * semaphore_set_handoff(semaphore_t sem, int handoff)
+ *  If handoff is nonzero, a V that wakes up a thread switches to it
+ *  right away, and the caller goes back on the run queue as if it had
+ *  yielded, so the two take turns without waiting on the scheduler.
+ *  A V with interrupts disabled still only wakes the thread up.
+ *  Semaphores start with handoff off.
+ */
+extern void semaphore_set_handoff(semaphore_t sem, int handoff);
+
 /*
  * semaphore_P(semaphore_t sem)
  *  P on the sempahore.
@@ -46,5 +56,205 @@ extern void semaphore_P(semaphore_t sem);
  */
 extern void semaphore_V(semaphore_t sem);
 
+/*
+ * int semaphore_P_timeout(semaphore_t sem, int delay)
+ *  P on the semaphore, giving up after delay milliseconds.
+ *  Return 0 if the P went through, or -1 if it timed out (and the
+ *  semaphore's count is as if it had never been called).
+ */
+extern int semaphore_P_timeout(semaphore_t sem, int delay);
+
+
+/*
+ * Mutexes.
+ *
+ * Locking a mutex no other thread holds, and unlocking one no other
+ * thread is waiting for, takes a single atomic instruction and leaves
+ * interrupts alone; only threads that have to wait, and the threads
+ * that wake them, disable interrupts. A mutex is not recursive, and
+ * must not be used by interrupt handlers.
+ */
+typedef struct mutex *mutex_t;
+
+/*
+ * mutex_t mutex_create()
+ *  Allocate a new mutex, unlocked.
+ */
+extern mutex_t mutex_create();
+
+/*
+ * mutex_destroy(mutex_t m)
+ *  Deallocate a mutex. No thread may hold it or wait for it.
+ */
+extern void mutex_destroy(mutex_t m);
+
+/*
+ * mutex_lock(mutex_t m)
+ *  Lock the mutex, waiting for it if another thread holds it.
+ */
+extern void mutex_lock(mutex_t m);
+
+/*
+ * int mutex_trylock(mutex_t m)
+ *  Lock the mutex if no thread holds it. Return 0 if it was locked,
+ *  -1 if it was held.
+ */
+extern int mutex_trylock(mutex_t m);
+
+/*
+ * mutex_unlock(mutex_t m)
+ *  Unlock the mutex, which the calling thread holds, and wake up a
+ *  thread waiting for it, if any.
+ */
+extern void mutex_unlock(mutex_t m);
+
+
+/*
+ * Condition variables.
+ */
+typedef struct condvar *condvar_t;
+
+/*
+ * condvar_t condvar_create()
+ *  Allocate a new condition variable.
+ */
+extern condvar_t condvar_create();
+
+/*
+ * condvar_destroy(condvar_t cv)
+ *  Deallocate a condition variable. No thread may be waiting on it.
+ */
+extern void condvar_destroy(condvar_t cv);
+
+/*
+ * condvar_wait(condvar_t cv, mutex_t m)
+ *  Unlock m, which the calling thread holds, and wait on cv until
+ *  signalled, then lock m again. Like any condition variable, check the
+ *  condition again on waking up.
+ */
+extern void condvar_wait(condvar_t cv, mutex_t m);
+
+/*
+ * condvar_signal(condvar_t cv)
+ *  Wake up the thread that has waited on cv the longest, if any.
+ */
+extern void condvar_signal(condvar_t cv);
+
+/*
+ * condvar_broadcast(condvar_t cv)
+ *  Wake up every thread waiting on cv.
+ */
+extern void condvar_broadcast(condvar_t cv);
+
+
+/*
+ * Reader-writer locks.
+ *
+ * Any number of readers, or a single writer, may hold a rwlock. Once
+ * a writer is waiting, new readers wait behind it, so a stream of
+ * readers cannot starve writers. As with mutexes, taking and dropping
+ * an uncontended rwlock are single atomic instructions.
+ */
+typedef struct rwlock *rwlock_t;
+
+/*
+ * rwlock_t rwlock_create()
+ *  Allocate a new reader-writer lock, unlocked.
+ */
+extern rwlock_t rwlock_create();
+
+/*
+ * rwlock_destroy(rwlock_t rw)
+ *  Deallocate a reader-writer lock. No thread may hold it or wait for it.
+ */
+extern void rwlock_destroy(rwlock_t rw);
+
+/*
+ * rwlock_read_lock(rwlock_t rw)
+ * rwlock_read_unlock(rwlock_t rw)
+ *  Take and drop the lock as a reader.
+ */
+extern void rwlock_read_lock(rwlock_t rw);
+extern void rwlock_read_unlock(rwlock_t rw);
+
+/*
+ * rwlock_write_lock(rwlock_t rw)
+ * rwlock_write_unlock(rwlock_t rw)
+ *  Take and drop the lock as the writer.
+ */
+extern void rwlock_write_lock(rwlock_t rw);
+extern void rwlock_write_unlock(rwlock_t rw);
+
+
+
+/*
+ * Channels.
+ *
+ * A channel is a bounded FIFO of void* items between any number of
+ * senders and receivers. Senders wait while it is full and receivers
+ * while it is empty. The batch calls move many items per call, and
+ * a sender does not wait until the channel is full, so a thread can
+ * fill a channel or empty it without a context switch per item.
+ * The try calls never wait, and may be used by interrupt handlers.
+ */
+typedef struct channel *channel_t;
+
+/*
+ * channel_t channel_create(int capacity)
+ *  Allocate a new, empty channel that holds up to capacity items.
+ *  Return NULL on error, or if capacity is less than 1.
+ */
+extern channel_t channel_create(int capacity);
+
+/*
+ * channel_destroy(channel_t c)
+ *  Deallocate a channel. No thread may be waiting on it. Items still
+ *  in it are dropped.
+ */
+extern void channel_destroy(channel_t c);
+
+/*
+ * channel_set_handoff(channel_t c, int handoff)
+ *  If handoff is nonzero, a blocking send or receive on c that wakes up
+ *  threads switches to the last of them at once, as semaphore_V does on
+ *  a handoff semaphore. Channels start with handoff off.
+ */
+extern void channel_set_handoff(channel_t c, int handoff);
+
+/*
+ * channel_send(channel_t c, void* item)
+ *  Put item on c, waiting for room if it is full.
+ */
+extern void channel_send(channel_t c, void* item);
+
+/*
+ * void* channel_receive(channel_t c)
+ *  Take the oldest item off c, waiting for one if it is empty.
+ */
+extern void* channel_receive(channel_t c);
+
+/*
+ * int channel_try_send(channel_t c, void* item)
+ * int channel_try_receive(channel_t c, void** item)
+ *  Like channel_send and channel_receive, but return -1 instead of
+ *  waiting if c is full (or empty), and 0 on success.
+ */
+extern int channel_try_send(channel_t c, void* item);
+extern int channel_try_receive(channel_t c, void** item);
+
+/*
+ * channel_send_batch(channel_t c, void** items, int n)
+ *  Put the n items on c in order, waiting for room whenever it fills
+ *  up. If it does, other senders' items may come between them.
+ */
+extern void channel_send_batch(channel_t c, void** items, int n);
+
+/*
+ * int channel_receive_batch(channel_t c, void** items, int n)
+ *  Take up to n items off c into items, waiting only if it is empty.
+ *  Return how many were taken: at least 1, unless n is less than 1.
+ */
+extern int channel_receive_batch(channel_t c, void** items, int n);
+
 
 #endif /*__SYNCH_H__*/
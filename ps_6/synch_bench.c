@@ -0,0 +1,149 @@
+/* synch_bench.c
+   Measures what locking costs, uncontended and contended.
+   Usage: synch_bench [rounds] [processors]
+   Uncontended: one thread locks and unlocks over and over. Contended:
+   two threads take turns at a lock, yielding while they hold it, so
+   every lock waits and every unlock wakes a thread up; then THREADS
+   threads hammer a lock with short critical sections on all processors.
+   Binary semaphores are measured alongside, for comparison.
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_ROUNDS 1000000
+#define THREADS 4
+
+int rounds = DEFAULT_ROUNDS;
+int num_procs = 1;
+semaphore_t sem;
+mutex_t mutex;
+rwlock_t rwlock;
+semaphore_t done;
+volatile long counter = 0;
+
+typedef enum { SEMAPHORE, MUTEX, READ_LOCK, WRITE_LOCK } lock_kind;
+
+void
+lock(int kind) {
+  switch (kind) {
+  case SEMAPHORE: semaphore_P(sem); break;
+  case MUTEX: mutex_lock(mutex); break;
+  case READ_LOCK: rwlock_read_lock(rwlock); break;
+  case WRITE_LOCK: rwlock_write_lock(rwlock); break;
+  }
+}
+
+void
+unlock(int kind) {
+  switch (kind) {
+  case SEMAPHORE: semaphore_V(sem); break;
+  case MUTEX: mutex_unlock(mutex); break;
+  case READ_LOCK: rwlock_read_unlock(rwlock); break;
+  case WRITE_LOCK: rwlock_write_unlock(rwlock); break;
+  }
+}
+
+void
+report(char* what, int ops, uint64_t start) {
+  uint64_t elapsed = minithread_time_ns() - start;
+
+  printf("%-32s %8.1f ns/op\n", what, (double)elapsed / ops);
+}
+
+int
+turn_taker(int* arg) {
+  int i;
+
+  for (i = 0; i < rounds / 100; i++) {
+    lock(*arg);
+    minithread_yield();
+    unlock(*arg);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+hammer(int* arg) {
+  int i;
+
+  for (i = 0; i < rounds / THREADS; i++) {
+    lock(*arg);
+    counter++;
+    unlock(*arg);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+void
+contended(char* what, proc_t proc, int kind, int threads, int ops) {
+  uint64_t start;
+  int i;
+
+  start = minithread_time_ns();
+  for (i = 0; i < threads; i++) {
+    minithread_fork(proc, &kind);
+  }
+  for (i = 0; i < threads; i++) {
+    semaphore_P(done);
+  }
+  report(what, ops, start);
+}
+
+int
+run_synch_bench(int* arg) {
+  char* names[] = { "semaphore", "mutex", "rwlock read", "rwlock write" };
+  char what[64];
+  uint64_t start;
+  int kind;
+  int i;
+
+  printf("%d processors\n", num_procs);
+  for (kind = SEMAPHORE; kind <= WRITE_LOCK; kind++) {
+    start = minithread_time_ns();
+    for (i = 0; i < rounds; i++) {
+      lock(kind);
+      unlock(kind);
+    }
+    sprintf(what, "%s, uncontended", names[kind]);
+    report(what, rounds, start);
+  }
+  for (kind = SEMAPHORE; kind <= WRITE_LOCK; kind++) {
+    if (kind == READ_LOCK) continue;
+    sprintf(what, "%s, taking turns", names[kind]);
+    contended(what, turn_taker, kind, 2, 2 * (rounds / 100));
+  }
+  for (kind = SEMAPHORE; kind <= WRITE_LOCK; kind++) {
+    sprintf(what, "%s, %d threads", names[kind], THREADS);
+    counter = 0;
+    contended(what, hammer, kind, THREADS, THREADS * (rounds / THREADS));
+    if (kind != READ_LOCK && counter != THREADS * (rounds / THREADS)) {
+      printf("%s lost updates!\n", names[kind]);
+    }
+  }
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    rounds = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    num_procs = atoi(argv[2]);
+  }
+  minithread_set_processors(num_procs);
+  sem = semaphore_create();
+  semaphore_initialize(sem, 1);
+  mutex = mutex_create();
+  rwlock = rwlock_create();
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_synch_bench, NULL);
+  return 0;
+}
@@ -0,0 +1,523 @@
+/*
+ * Task pools.
+ */
+#include <stdlib.h>
+#include "taskpool.h"
+#include "minithread.h"
+#include "interrupts.h"
+#include "synch.h"
+#include "slab.h"
+
+#define DEQUE_SIZE 1024 //a power of two
+
+typedef struct task {
+  taskpool_t pool;
+  proc_t proc;
+  arg_t arg;
+  int result;
+  volatile int done;
+  int refs; //the worker running it and the future each hold one
+  minithread_queue waiters; //threads joining it
+  struct task* next; //on the shared queue
+} task;
+
+typedef task* task_t;
+
+/*
+ * A Chase-Lev deque. Only its own worker pushes and pops at the bottom,
+ * so those need no lock, and thieves take from the top with a compare
+ * and swap. The one place the two meet, over the last task, is settled
+ * by a compare and swap on top as well. It does not grow: a worker
+ * whose deque is full puts tasks on the shared queue instead.
+ */
+typedef struct deque {
+  volatile long top;
+  volatile long bottom;
+  task_t tasks[DEQUE_SIZE];
+} deque;
+
+typedef struct worker {
+  taskpool_t pool;
+  minithread_t thread;
+  uint64_t rng; //picks the workers to steal from
+  deque tasks;
+} worker;
+
+/*
+ * The shared queue and idle_q are protected by disabling interrupts.
+ * A worker counts itself in sleepers before it last looks for work and
+ * goes on idle_q, and whoever adds work afterwards checks sleepers, so
+ * either the worker sees the work or it gets woken up.
+ */
+typedef struct taskpool {
+  int num_workers;
+  worker* workers;
+  task_t shared_head; //tasks submitted from outside the pool
+  task_t shared_tail;
+  volatile int sleepers;
+  minithread_queue idle_q;
+  volatile int stopping;
+  semaphore_t exited;
+} taskpool;
+
+/*
+ * What a parallel_for call shares between the pieces of its range. It
+ * lives on the caller's stack until done finishes.
+ */
+typedef struct loop {
+  taskpool_t pool;
+  loop_body_t body;
+  void* arg;
+  int grain;
+  volatile int remaining; //iterations not run yet
+  task_t done;
+} loop;
+
+typedef struct range {
+  loop* lp;
+  int start;
+  int end;
+} range;
+
+typedef range* range_t;
+
+static slab_cache task_cache = SLAB_CACHE_INIT("task", task);
+static slab_cache range_cache = SLAB_CACHE_INIT("loop range", range);
+
+/* DEQUE */
+
+static int
+deque_push(deque* d, task_t t) {
+  long b = d->bottom;
+
+  if (b - d->top >= DEQUE_SIZE) return -1;
+  d->tasks[b & (DEQUE_SIZE - 1)] = t;
+  __sync_synchronize();
+  d->bottom = b + 1;
+  return 0;
+}
+
+static task_t
+deque_pop(deque* d) {
+  long b = d->bottom - 1;
+  long t;
+  task_t item;
+
+  d->bottom = b;
+  __sync_synchronize();
+  t = d->top;
+  if (t > b) {
+    d->bottom = b + 1;
+    return NULL;
+  }
+  item = d->tasks[b & (DEQUE_SIZE - 1)];
+  if (t == b) {
+    //the last task: a thief may be taking it too
+    if (!__sync_bool_compare_and_swap(&d->top, t, t + 1)) item = NULL;
+    d->bottom = b + 1;
+  }
+  return item;
+}
+
+static task_t
+deque_steal(deque* d) {
+  long t = d->top;
+  long b;
+  task_t item;
+
+  __sync_synchronize();
+  b = d->bottom;
+  if (t >= b) return NULL;
+  item = d->tasks[t & (DEQUE_SIZE - 1)];
+  if (!__sync_bool_compare_and_swap(&d->top, t, t + 1)) return NULL;
+  return item;
+}
+
+/* TASKS */
+
+static task_t
+task_new(taskpool_t pool, proc_t proc, arg_t arg) {
+  task_t t = (task_t)slab_alloc(&task_cache);
+
+  if (t == NULL) return NULL;
+  t->pool = pool;
+  t->proc = proc;
+  t->arg = arg;
+  t->result = 0;
+  t->done = 0;
+  t->refs = 2;
+  minithread_queue_init(&t->waiters);
+  t->next = NULL;
+  return t;
+}
+
+static void
+task_put(task_t t) {
+  if (__sync_sub_and_fetch(&t->refs, 1) == 0) {
+    slab_free(&task_cache, t);
+  }
+}
+
+/*
+ * Marks t finished with result, wakes up the threads joining it, and
+ * drops the running worker's reference.
+ */
+static void
+task_finish(task_t t, int result) {
+  interrupt_level_t l;
+
+  t->result = result;
+  l = set_interrupt_level(DISABLED);
+  __sync_synchronize();
+  t->done = 1;
+  while (minithread_queue_length(&t->waiters) > 0) {
+    minithread_dequeue_and_run(&t->waiters);
+  }
+  set_interrupt_level(l);
+  task_put(t);
+}
+
+/* POOL */
+
+/*
+ * Returns the worker of pool the caller is, or NULL if it is not one.
+ */
+static worker*
+taskpool_self(taskpool_t pool) {
+  minithread_t self = minithread_self();
+  int i;
+
+  for (i = 0; i < pool->num_workers; i++) {
+    if (pool->workers[i].thread == self) return &pool->workers[i];
+  }
+  return NULL;
+}
+
+static int
+taskpool_has_work(taskpool_t pool) {
+  int i;
+
+  if (pool->shared_head != NULL) return 1;
+  for (i = 0; i < pool->num_workers; i++) {
+    if (pool->workers[i].tasks.top < pool->workers[i].tasks.bottom) return 1;
+  }
+  return 0;
+}
+
+/*
+ * Wakes up a sleeping worker, if there is one, after work was added.
+ */
+static void
+taskpool_wake(taskpool_t pool) {
+  interrupt_level_t l;
+
+  __sync_synchronize();
+  if (pool->sleepers == 0) return;
+  l = set_interrupt_level(DISABLED);
+  if (minithread_queue_length(&pool->idle_q) > 0) {
+    minithread_dequeue_and_run(&pool->idle_q);
+  }
+  set_interrupt_level(l);
+}
+
+/*
+ * Puts t on the caller's deque if it is a worker of pool, or else on
+ * the shared queue.
+ */
+static void
+taskpool_add(taskpool_t pool, task_t t) {
+  interrupt_level_t l;
+  worker* me = taskpool_self(pool);
+
+  if (me == NULL || deque_push(&me->tasks, t) == -1) {
+    l = set_interrupt_level(DISABLED);
+    if (pool->shared_tail == NULL) pool->shared_head = t;
+    else pool->shared_tail->next = t;
+    pool->shared_tail = t;
+    set_interrupt_level(l);
+  }
+  taskpool_wake(pool);
+}
+
+static task_t
+taskpool_take_shared(taskpool_t pool) {
+  interrupt_level_t l;
+  task_t t;
+
+  if (pool->shared_head == NULL) return NULL;
+  l = set_interrupt_level(DISABLED);
+  t = pool->shared_head;
+  if (t != NULL) {
+    pool->shared_head = t->next;
+    if (pool->shared_head == NULL) pool->shared_tail = NULL;
+  }
+  set_interrupt_level(l);
+  return t;
+}
+
+/*
+ * Finds the next task for me to run: the newest on its own deque, else
+ * the oldest on the shared queue, else the oldest on another worker's
+ * deque, trying them in turn from a random one. Returns NULL if there
+ * was nothing to take.
+ */
+static task_t
+taskpool_find(taskpool_t pool, worker* me) {
+  task_t t;
+  int first;
+  int i;
+
+  if ((t = deque_pop(&me->tasks)) != NULL) return t;
+  if ((t = taskpool_take_shared(pool)) != NULL) return t;
+
+  me->rng ^= me->rng << 13;
+  me->rng ^= me->rng >> 7;
+  me->rng ^= me->rng << 17;
+  first = me->rng % pool->num_workers;
+  for (i = 0; i < pool->num_workers; i++) {
+    worker* victim = &pool->workers[(first + i) % pool->num_workers];
+
+    if (victim != me && (t = deque_steal(&victim->tasks)) != NULL) return t;
+  }
+  return NULL;
+}
+
+static void
+taskpool_run(task_t t) {
+  task_finish(t, t->proc(t->arg));
+}
+
+/*
+ * Blocks the calling worker until there may be work for it.
+ */
+static void
+taskpool_sleep(taskpool_t pool) {
+  interrupt_level_t l;
+
+  __sync_fetch_and_add(&pool->sleepers, 1);
+  l = set_interrupt_level(DISABLED);
+  if (!pool->stopping && !taskpool_has_work(pool)) {
+    minithread_enqueue_and_schedule(&pool->idle_q);
+  }
+  set_interrupt_level(l);
+  __sync_fetch_and_sub(&pool->sleepers, 1);
+}
+
+static int
+taskpool_worker(int* arg) {
+  worker* me = (worker*)arg;
+  taskpool_t pool = me->pool;
+  task_t t;
+
+  while (1) {
+    if ((t = taskpool_find(pool, me)) != NULL) {
+      taskpool_run(t);
+    }
+    else if (pool->stopping) {
+      break;
+    }
+    else {
+      taskpool_sleep(pool);
+    }
+  }
+  semaphore_V(pool->exited);
+  return 0;
+}
+
+taskpool_t
+taskpool_create(int workers) {
+  taskpool_t pool;
+  minithread_attr attr;
+  int i;
+
+  if (workers < 1) {
+    workers = minithread_num_processors();
+  }
+  pool = (taskpool_t)malloc(sizeof(taskpool));
+  if (pool == NULL) return NULL;
+  pool->workers = (worker*)calloc(workers, sizeof(worker));
+  pool->exited = semaphore_create();
+  if (pool->workers == NULL || pool->exited == NULL) {
+    free(pool->workers);
+    semaphore_destroy(pool->exited);
+    free(pool);
+    return NULL;
+  }
+  semaphore_initialize(pool->exited, 0);
+  pool->shared_head = NULL;
+  pool->shared_tail = NULL;
+  pool->sleepers = 0;
+  minithread_queue_init(&pool->idle_q);
+  pool->stopping = 0;
+
+  //make them all before starting any, so each can find the others
+  minithread_attr_init(&attr);
+  attr.name = "task worker";
+  for (i = 0; i < workers; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].rng = i + 1;
+    pool->workers[i].thread = minithread_create_ex(taskpool_worker,
+        (arg_t)&pool->workers[i], &attr);
+    if (pool->workers[i].thread == NULL) break;
+  }
+  pool->num_workers = i;
+  if (pool->num_workers == 0) {
+    free(pool->workers);
+    semaphore_destroy(pool->exited);
+    free(pool);
+    return NULL;
+  }
+  for (i = 0; i < pool->num_workers; i++) {
+    minithread_start(pool->workers[i].thread);
+  }
+  return pool;
+}
+
+void
+taskpool_destroy(taskpool_t pool) {
+  interrupt_level_t l;
+  int i;
+
+  if (pool == NULL) return;
+  l = set_interrupt_level(DISABLED);
+  pool->stopping = 1;
+  while (minithread_queue_length(&pool->idle_q) > 0) {
+    minithread_dequeue_and_run(&pool->idle_q);
+  }
+  set_interrupt_level(l);
+  for (i = 0; i < pool->num_workers; i++) {
+    semaphore_P(pool->exited);
+  }
+  semaphore_destroy(pool->exited);
+  free(pool->workers);
+  free(pool);
+}
+
+future_t
+taskpool_submit(taskpool_t pool, proc_t proc, arg_t arg) {
+  task_t t;
+
+  if (pool == NULL || proc == NULL) return NULL;
+  t = task_new(pool, proc, arg);
+  if (t == NULL) return NULL;
+  taskpool_add(pool, t);
+  return t;
+}
+
+int
+future_join(future_t f) {
+  interrupt_level_t l;
+  worker* me = taskpool_self(f->pool);
+  task_t t;
+  int result;
+
+  while (!f->done) {
+    //a worker runs other tasks meanwhile, and only waits when it has none
+    if (me != NULL && (t = taskpool_find(f->pool, me)) != NULL) {
+      taskpool_run(t);
+      continue;
+    }
+    l = set_interrupt_level(DISABLED);
+    if (!f->done) {
+      minithread_enqueue_and_schedule(&f->waiters);
+    }
+    set_interrupt_level(l);
+  }
+  result = f->result;
+  task_put(f);
+  return result;
+}
+
+void
+future_detach(future_t f) {
+  if (f != NULL) task_put(f);
+}
+
+int
+future_done(future_t f) {
+  return f->done;
+}
+
+/* PARALLEL FOR */
+
+/*
+ * Runs a piece of a parallel_for range: gives away the top half of it
+ * until it is no bigger than the grain, then runs what is left.
+ */
+static int
+range_run(int* arg) {
+  range_t r = (range_t)arg;
+  loop* lp = r->lp;
+  range_t half;
+  future_t f;
+  int i;
+
+  while (r->end - r->start > lp->grain) {
+    half = (range_t)slab_alloc(&range_cache);
+    if (half == NULL) break;
+    half->lp = lp;
+    half->start = r->start + (r->end - r->start) / 2;
+    half->end = r->end;
+    r->end = half->start;
+    if ((f = taskpool_submit(lp->pool, range_run, (arg_t)half)) == NULL) {
+      r->end = half->end;
+      slab_free(&range_cache, half);
+      break;
+    }
+    future_detach(f);
+  }
+  for (i = r->start; i < r->end; i++) {
+    lp->body(i, lp->arg);
+  }
+  //once remaining gets to 0 the caller may return, and lp is gone
+  if (__sync_sub_and_fetch(&lp->remaining, r->end - r->start) == 0) {
+    task_finish(lp->done, 0);
+  }
+  slab_free(&range_cache, r);
+  return 0;
+}
+
+int
+parallel_for(taskpool_t pool, int start, int end, int grain,
+             loop_body_t body, void* arg) {
+  loop lp;
+  range_t r;
+  future_t f;
+
+  if (pool == NULL || body == NULL) return -1;
+  if (end <= start) return 0;
+  if (grain < 1) {
+    grain = (end - start) / (8 * pool->num_workers);
+    if (grain < 1) grain = 1;
+  }
+  lp.pool = pool;
+  lp.body = body;
+  lp.arg = arg;
+  lp.grain = grain;
+  lp.remaining = end - start;
+  lp.done = task_new(pool, NULL, NULL);
+  r = (range_t)slab_alloc(&range_cache);
+  if (lp.done == NULL || r == NULL) {
+    if (lp.done != NULL) slab_free(&task_cache, lp.done);
+    slab_free(&range_cache, r);
+    return -1;
+  }
+  r->lp = &lp;
+  r->start = start;
+  r->end = end;
+
+  //a worker starts on the range itself, anyone else hands it over
+  if (taskpool_self(pool) != NULL) {
+    range_run((int*)r);
+  }
+  else if ((f = taskpool_submit(pool, range_run, (arg_t)r)) != NULL) {
+    future_detach(f);
+  }
+  else {
+    slab_free(&task_cache, lp.done);
+    slab_free(&range_cache, r);
+    return -1;
+  }
+  future_join(lp.done);
+  return 0;
+}
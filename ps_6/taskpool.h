@@ -0,0 +1,83 @@
+/*
+ * Task pools.
+ *
+ * A task pool runs tasks (a function and its argument) on a fixed set
+ * of worker minithreads, so fine grained work does not have to make a
+ * thread, with its stack, per piece. Each worker keeps its own deque of
+ * tasks: tasks submitted by a worker go on the bottom of its deque, and
+ * it takes its next task off the bottom too, so it works through the
+ * tasks it made most recently while their data is still in cache.
+ * A worker whose deque is empty steals from the top of another's, so
+ * the oldest (and usually biggest) pieces of work are the ones that
+ * move. Tasks submitted by threads outside the pool go on a shared queue.
+ * Workers with nothing to do block until there is work.
+ *
+ * Submitting a task returns a future, which is joined to wait for the
+ * task and get its return value. A worker joining a future runs other
+ * tasks while it waits, so tasks may submit and join tasks of their own
+ * (divide and conquer) without running out of workers.
+ *
+ *   pool = taskpool_create(0);
+ *   f = taskpool_submit(pool, sum, &halves[0]);
+ *   total = sum(&halves[1]) + future_join(f);
+ */
+#ifndef __TASKPOOL_H__
+#define __TASKPOOL_H__
+
+#include "minithread.h"
+
+typedef struct taskpool* taskpool_t;
+typedef struct task* future_t;
+
+/*
+ * The body of a parallel_for loop, called once for each i in the range,
+ * with the arg given to parallel_for.
+ */
+typedef void (*loop_body_t)(int i, void* arg);
+
+/*
+ * Return a pool of workers worker minithreads, or one per processor if
+ * workers is less than 1. Must be called after
+ * minithread_system_initialize. Returns NULL on error.
+ */
+extern taskpool_t taskpool_create(int workers);
+
+/*
+ * Wait for every task submitted to pool to finish, stop its workers
+ * and free it. Must not be called by a task in pool.
+ */
+extern void taskpool_destroy(taskpool_t pool);
+
+/*
+ * Have a worker of pool run proc(arg), and return a future for it, or
+ * NULL on error. The future must be joined or detached exactly once.
+ */
+extern future_t taskpool_submit(taskpool_t pool, proc_t proc, arg_t arg);
+
+/*
+ * Wait for the task behind f to finish, free f, and return what the
+ * task returned.
+ */
+extern int future_join(future_t f);
+
+/*
+ * Give up f without waiting: it is freed once its task finishes.
+ */
+extern void future_detach(future_t f);
+
+/*
+ * Return 1 if the task behind f has finished, 0 otherwise.
+ */
+extern int future_done(future_t f);
+
+/*
+ * Call body(i, arg) for every i from start up to (not including) end
+ * on pool's workers, and return once all calls have returned. The range
+ * is split in halves until the pieces have at most grain iterations;
+ * a grain of 0 picks one giving each worker about eight pieces.
+ * Return 0 (success) or -1 (failure), in which case no calls were made.
+ */
+extern int parallel_for(taskpool_t pool, int start, int end, int grain,
+                        loop_body_t body, void* arg);
+
+#endif /*__TASKPOOL_H__*/
@@ -0,0 +1,122 @@
+/* taskpool_bench.c
+   Compares forking a minithread per piece of work with submitting a
+   task to a task pool, and times parallel_for.
+   Usage: taskpool_bench [units] [processors]
+   fork: forks a thread per unit and waits for it on a semaphore.
+   submit: submits a task per unit, in batches, and joins them.
+   parallel_for: runs a loop of units iterations with the default grain
+   and with a grain of 1, against the same loop run serially.
+   Each unit does a little arithmetic so the overhead dominates.
+*/
+#include "minithread.h"
+#include "synch.h"
+#include "taskpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_UNITS 100000
+#define BATCH 100
+
+int units = DEFAULT_UNITS;
+int num_procs = 1;
+semaphore_t done;
+volatile long sink;
+
+int
+unit(int* arg) {
+  long x = (long)(intptr_t)arg;
+  int i;
+
+  for (i = 0; i < 16; i++) x = x * 31 + i;
+  sink = x;
+  return 0;
+}
+
+int
+forked_unit(int* arg) {
+  unit(arg);
+  semaphore_V(done);
+  return 0;
+}
+
+void
+loop_unit(int i, void* arg) {
+  unit((arg_t)(intptr_t)i);
+}
+
+void
+report(char* what, uint64_t start) {
+  uint64_t elapsed = minithread_time_ns() - start;
+
+  printf("%-22s %10.1f ns/unit %12.0f units/s\n", what,
+      (double)elapsed / units, units / (elapsed / 1e9));
+}
+
+int
+run_taskpool_bench(int* arg) {
+  taskpool_t pool = taskpool_create(0);
+  future_t futures[BATCH];
+  uint64_t start;
+  int i;
+  int j;
+
+  printf("%d processors, %d units\n", num_procs, units);
+
+  start = minithread_time_ns();
+  for (i = 0; i < units; i += BATCH) {
+    for (j = 0; j < BATCH; j++) {
+      minithread_fork(forked_unit, (arg_t)(intptr_t)(i + j));
+    }
+    for (j = 0; j < BATCH; j++) {
+      semaphore_P(done);
+    }
+  }
+  report("fork and wait", start);
+
+  start = minithread_time_ns();
+  for (i = 0; i < units; i += BATCH) {
+    for (j = 0; j < BATCH; j++) {
+      futures[j] = taskpool_submit(pool, unit, (arg_t)(intptr_t)(i + j));
+    }
+    for (j = 0; j < BATCH; j++) {
+      future_join(futures[j]);
+    }
+  }
+  report("submit and join", start);
+
+  start = minithread_time_ns();
+  for (i = 0; i < units; i++) {
+    loop_unit(i, NULL);
+  }
+  report("serial loop", start);
+
+  start = minithread_time_ns();
+  parallel_for(pool, 0, units, 0, loop_unit, NULL);
+  report("parallel_for", start);
+
+  start = minithread_time_ns();
+  parallel_for(pool, 0, units, 1, loop_unit, NULL);
+  report("parallel_for, grain 1", start);
+
+  taskpool_destroy(pool);
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    units = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    num_procs = atoi(argv[2]);
+  }
+  if (units < BATCH) units = BATCH;
+  units -= units % BATCH;
+  minithread_set_processors(num_procs);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_taskpool_bench, NULL);
+  return 0;
+}
@@ -14,9 +14,37 @@ print_alarm(void* arg){
   printf("Set off alarm %li\n", (long)arg);
 }
 
+#define MANY 10000
+
+int fired;
+int far_delays[4] = { 50, 3000, 200000, 20000000 };
+int far[4];
+alarm_id many[MANY];
+
+void
+count_alarm(void* arg){
+  fired++;
+}
+
+//checks it goes off at the tick it was set for
+void
+check_alarm(void* arg){
+  assert(*(int*)arg == sys_time);
+  fired++;
+}
+
+void
+rearm_alarm(void* arg){
+  fired++;
+  if (arg == NULL) {
+    set_alarm(1, rearm_alarm, (void*)1, sys_time);
+  }
+}
+
 int
 test_alarms(int* arg){
   int STOP = 100;
+  int i;
   alarm_id tmp1;
   alarm_id tmp2;
   alarm_id tmp8;
@@ -72,6 +100,57 @@ test_alarms(int* arg){
   assert(deregister_alarm(tmp10) == 0);
 
   printf("deregister unexecuted alarms...SUCCESS\n");
+
+  // an alarm set for a tick that has already gone by goes off next
+  fired = 0;
+  set_alarm(1, count_alarm, NULL, sys_time - 10);
+  execute_alarms(sys_time);
+  assert(fired == 1);
+  printf("late alarm goes off............SUCCESS\n");
+
+  // alarms far enough out to go through every wheel, with ticks skipped
+  fired = 0;
+  for (i = 0; i < 4; i++) {
+    far[i] = sys_time + far_delays[i];
+    set_alarm(far_delays[i], check_alarm, &far[i], sys_time);
+  }
+  for (i = 0; i < 4; i++) {
+    sys_time = far[i] - 1;
+    execute_alarms(sys_time);
+    assert(fired == i);
+    sys_time += 1;
+    execute_alarms(sys_time);
+    assert(fired == i + 1);
+  }
+  assert(alarm_list_len(a_list) == 0);
+  assert(alarm_next_time() == -1);
+  printf("far alarms go off on time......SUCCESS\n");
+
+  // set and cancel many, out of order
+  for (i = 0; i < MANY; i++) {
+    many[i] = set_alarm(i * 7 % 5000 + 1, count_alarm, NULL, sys_time);
+  }
+  assert(alarm_next_time() == sys_time + 1);
+  for (i = MANY - 1; i >= 0; i -= 2) {
+    assert(deregister_alarm(many[i]) == 0);
+  }
+  fired = 0;
+  sys_time += 5000;
+  execute_alarms(sys_time);
+  assert(fired == MANY / 2);
+  assert(alarm_list_len(a_list) == 0);
+  printf("set and cancel many alarms.....SUCCESS\n");
+
+  // alarms may set and cancel alarms
+  fired = 0;
+  set_alarm(1, rearm_alarm, NULL, sys_time);
+  sys_time += 1;
+  execute_alarms(sys_time);
+  assert(fired == 1);
+  sys_time += 1;
+  execute_alarms(sys_time);
+  assert(fired == 2);
+  printf("alarms set alarms..............SUCCESS\n");
   free(a_list);
   return 0;
 }
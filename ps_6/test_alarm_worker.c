@@ -0,0 +1,150 @@
+/* test_alarm_worker.c
+   Checks that alarm functions run on the alarm worker with interrupts
+   enabled, in the order their alarms went off, a budget at a time, and
+   that an alarm that went off but has not run yet can still be
+   deregistered. Also checks that a thread the worker interrupted still
+   runs after it when an alarm goes off while a system thread runs
+   ahead of that thread.
+   Usage: test_alarm_worker [alarms]
+*/
+#include "minithread.h"
+#include "interrupts.h"
+#include "synch.h"
+#include "alarm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define DEFAULT_ALARMS 1000
+#define SPIN (5 * MILLISECOND)
+#define SPINS 20
+
+extern minithread_t minithread_fork_system(proc_t proc, char* name);
+
+int alarms = DEFAULT_ALARMS;
+int* order;
+volatile int ran = 0;
+semaphore_t done;
+semaphore_t spin_go;
+volatile int spun = 0;
+
+void
+check_context(void* arg) {
+  interrupt_level_t l;
+
+  l = set_interrupt_level(DISABLED);
+  assert(l == ENABLED);
+  set_interrupt_level(l);
+  assert(strcmp(minithread_name(minithread_self()), "alarm worker") == 0);
+  semaphore_V(done);
+}
+
+void
+must_not_run(void* arg) {
+  assert(0);
+}
+
+void
+count_alarm(void* arg) {
+  order[ran++] = (int)(long)arg;
+  if (ran == alarms) {
+    semaphore_V(done);
+  }
+}
+
+void
+nothing(void* arg) {
+}
+
+void
+lost(void* arg) {
+  printf("the interrupted thread never ran again\n");
+  exit(1);
+}
+
+/* a system thread that keeps the processor for a while once woken */
+int
+spinner(int* arg) {
+  uint64_t start;
+
+  while (1) {
+    semaphore_P(spin_go);
+    start = clock_now();
+    while (clock_now() - start < SPIN);
+    spun++;
+  }
+  return 0;
+}
+
+/* wakes the spinner, and sets off another alarm while it runs */
+void
+wake_spinner(void* arg) {
+  register_alarm(1, nothing, NULL);
+  semaphore_V(spin_go);
+}
+
+int
+run_alarm_worker_test(int* arg) {
+  alarm_stats stats;
+  alarm_id id;
+  uint64_t when;
+  interrupt_level_t l;
+  int i;
+
+  // where and how alarm functions run
+  register_alarm(1, check_context, NULL);
+  semaphore_P(done);
+
+  // gone off, waiting for the worker, then deregistered
+  l = set_interrupt_level(DISABLED);
+  when = clock_now();
+  id = set_alarm_at(when, must_not_run, NULL);
+  run_alarms(when + MILLISECOND);
+  assert(alarm_due_count() == 1);
+  assert(deregister_alarm(id) == 0);
+  assert(alarm_due_count() == 0);
+  set_interrupt_level(l);
+
+  // many at once: in order, over several budgets
+  when = clock_now() + 10 * MILLISECOND;
+  for (i = 0; i < alarms; i++) {
+    set_alarm_at(when + i, count_alarm, (void*)(long)i);
+  }
+  semaphore_P(done);
+  for (i = 0; i < alarms; i++) {
+    assert(order[i] == i);
+  }
+  assert(alarm_get_stats(&stats) == 0);
+  assert(stats.budget_exhausted > 0);
+  assert(stats.fired - stats.inline_fired >= alarms + 1);
+
+  // the worker interrupts this thread to wake a system thread, which
+  // runs ahead of it, and is itself interrupted by the worker
+  minithread_fork_system(spinner, "spinner");
+  register_alarm(10 * SPINS * SPIN / MILLISECOND, lost, NULL);
+  for (i = 0; i < SPINS; i++) {
+    register_alarm(1, wake_spinner, NULL);
+    while (spun == i);
+  }
+
+  alarm_print_stats();
+  printf("All alarm worker tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    alarms = atoi(argv[1]);
+  }
+  order = (int*)malloc(alarms * sizeof(int));
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  spin_go = semaphore_create();
+  semaphore_initialize(spin_go, 0);
+  minithread_system_initialize(run_alarm_worker_test, NULL);
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* test_handoff.c
+   Checks that minithread_yield_to runs the thread it is given next,
+   and that a V on a semaphore with handoff on runs the thread it wakes
+   before returning, while one with handoff off does not.
+   Usage: test_handoff
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define THREADS 5
+
+int order[THREADS];
+int ran = 0;
+volatile int woken = 0;
+semaphore_t sem;
+semaphore_t done;
+
+int
+runner(int* arg) {
+  order[ran++] = *arg;
+  semaphore_V(done);
+  return 0;
+}
+
+int
+waiter(int* arg) {
+  semaphore_P(sem);
+  woken = 1;
+  semaphore_V(done);
+  return 0;
+}
+
+int
+run_handoff_test(int* arg) {
+  minithread_t threads[THREADS];
+  int ids[THREADS];
+  int i;
+
+  // the thread yielded to runs first, the rest in turn after it
+  for (i = 0; i < THREADS; i++) {
+    ids[i] = i;
+    threads[i] = minithread_fork(runner, &ids[i]);
+  }
+  assert(minithread_yield_to(threads[3]) == 0);
+  assert(order[0] == 3);
+  for (i = 0; i < THREADS; i++) {
+    semaphore_P(done);
+  }
+  assert(ran == THREADS);
+
+  // nothing to yield to
+  assert(minithread_yield_to(minithread_self()) == -1);
+  threads[0] = minithread_fork(waiter, NULL);
+  minithread_yield();
+  assert(minithread_yield_to(threads[0]) == -1);
+  assert(!woken);
+
+  // without handoff the waiter only wakes up
+  semaphore_V(sem);
+  assert(!woken);
+  semaphore_P(done);
+  assert(woken);
+
+  // with handoff it runs before V returns
+  woken = 0;
+  semaphore_set_handoff(sem, 1);
+  minithread_fork(waiter, NULL);
+  minithread_yield();
+  semaphore_V(sem);
+  assert(woken);
+  semaphore_P(done);
+
+  // a V with nobody waiting keeps going
+  semaphore_V(sem);
+  semaphore_P(sem);
+
+  printf("All handoff tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  sem = semaphore_create();
+  semaphore_initialize(sem, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_handoff_test, NULL);
+  return 0;
+}
@@ -0,0 +1,120 @@
+/* test_hrtimer.c
+   Checks that sleeps and alarms go off on time rather than at the next
+   clock tick: never early, and typically well within a millisecond
+   late, both with every processor idle (sleeps) and with every
+   processor busy (alarms, which do not wait for the scheduler). With
+   more processors than the host has CPUs the host's scheduler adds its
+   own delays, so lateness is only reported then.
+   Usage: test_hrtimer [processors]
+*/
+#include "minithread.h"
+#include "synch.h"
+#include "alarm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+
+#define TRIES 21
+#define MAX_LATE (1 * MILLISECOND) //for the median; the host adds noise
+
+int delays_us[] = { 500, 1000, 3000, 10000, 37000, 150000 };
+volatile int spinning = 0;
+volatile uint64_t fired_at;
+semaphore_t done;
+int strict; //enforce MAX_LATE
+
+int
+spinner(int* arg) {
+  while (spinning) ;
+  semaphore_V(done);
+  return 0;
+}
+
+void
+record(void* arg) {
+  fired_at = minithread_time_ns();
+}
+
+int
+compare(const void* a, const void* b) {
+  uint64_t x = *(uint64_t*)a;
+  uint64_t y = *(uint64_t*)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* waits TRIES times for each delay, checks how late it was */
+void
+check_timers(char* what, int busy) {
+  uint64_t late[TRIES];
+  uint64_t delay;
+  uint64_t start;
+  int i;
+  int j;
+
+  for (i = 0; i < sizeof(delays_us) / sizeof(delays_us[0]); i++) {
+    delay = (uint64_t)delays_us[i] * MICROSECOND;
+    for (j = 0; j < TRIES; j++) {
+      start = minithread_time_ns();
+      if (busy) {
+        fired_at = 0;
+        set_alarm_at(boot_time + start + delay, record, NULL);
+        while (fired_at == 0) ;
+        late[j] = fired_at - start;
+      }
+      else {
+        minithread_sleep_ns(delay);
+        late[j] = minithread_time_ns() - start;
+      }
+      assert(late[j] >= delay);
+      late[j] -= delay;
+    }
+    qsort(late, TRIES, sizeof(late[0]), compare);
+    printf("%-5s %6d us: %4lu us late (median), %5lu us at worst\n", what,
+        delays_us[i], (unsigned long)(late[TRIES / 2] / MICROSECOND),
+        (unsigned long)(late[TRIES - 1] / MICROSECOND));
+    assert(!strict || late[TRIES / 2] <= MAX_LATE);
+  }
+}
+
+int
+run_hrtimer_test(int* arg) {
+  int processors = *arg;
+  int i;
+
+  strict = processors <= sysconf(_SC_NPROCESSORS_ONLN);
+  check_timers("sleep", 0);
+
+  // every processor busy, this thread included
+  spinning = 1;
+  for (i = 0; i < processors; i++) {
+    minithread_fork(spinner, NULL);
+  }
+  check_timers("alarm", 1);
+  spinning = 0;
+  for (i = 0; i < processors; i++) {
+    semaphore_P(done);
+  }
+
+  // the clock tick API still counts in ticks
+  assert(minithread_time() <= minithread_time_ns() / TIME_QUANTA);
+  printf("All high resolution timer tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  int processors = 1;
+
+  if (argc > 1) {
+    processors = atoi(argv[1]);
+  }
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_set_processors(processors);
+  minithread_system_initialize(run_hrtimer_test, &processors);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/* test_idle.c
+   Sleeps while nothing else is runnable, and checks that the idle
+   processors sleep too instead of spinning, and that sleepers wake up
+   on time.
+   Usage: test_idle [processors]
+*/
+#include "minithread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/resource.h>
+
+int delays[] = {100, 250, 1000, 2000};
+
+/* CPU time used by the whole process so far, in ms */
+uint64_t
+cpu_time_millis() {
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+int
+run_idle_test(int* arg) {
+  int i;
+  uint64_t start;
+  uint64_t cpu_start;
+  uint64_t slept;
+  uint64_t total_slept = 0;
+  uint64_t total_cpu;
+
+  cpu_start = cpu_time_millis();
+  for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+    start = currentTimeMillis();
+    minithread_sleep_with_timeout(delays[i]);
+    slept = currentTimeMillis() - start;
+    total_slept += slept;
+    printf("slept %d ms: woke after %lu ms\n", delays[i], (unsigned long)slept);
+
+    /* sleeps end on the tick the alarm was set for, not a tick later */
+    assert(slept < delays[i] + 100);
+  }
+  total_cpu = cpu_time_millis() - cpu_start;
+  printf("%d processors used %lu ms of CPU in %lu ms\n",
+      *arg, (unsigned long)total_cpu, (unsigned long)total_slept);
+  assert(total_cpu * 20 < total_slept);
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  int n = 1;
+
+  if (argc > 1) {
+    n = atoi(argv[1]);
+  }
+  minithread_set_processors(n);
+  minithread_system_initialize(run_idle_test, &n);
+  return 0;
+}
@@ -0,0 +1,98 @@
+/* test_pkt_pool.c
+   Tests packet allocation: network_pkt_alloc picks the smallest size
+   class that fits, the class counters follow allocs and frees, a class
+   whose pool runs dry mallocs until its buffers come back, and pull and
+   push move the data within the headroom. Does not start the thread
+   system.
+*/
+#include "network.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define EXTRA 5
+
+network_interrupt_arg_t* pkts[4096];
+
+int
+main(void) {
+  network_pkt_stats stats[NETWORK_PKT_CLASSES];
+  network_pkt_stats before[NETWORK_PKT_CLASSES];
+  network_interrupt_arg_t* pkt;
+  int sizes[] = { 0, 1, 256, 257, 2048, 2049, MAX_NETWORK_PKT_SIZE };
+  int classes[] = { 0, 0, 0, 1, 1, 2, 2 };
+  int n;
+  int c;
+  int i;
+
+  assert(network_get_pkt_stats(NULL) == -1);
+  assert(network_pkt_alloc(-1) == NULL);
+  assert(network_pkt_alloc(MAX_NETWORK_PKT_SIZE + 1) == NULL);
+  assert(network_get_pkt_stats(before) == 0);
+  for (c = 0; c < NETWORK_PKT_CLASSES; c++) {
+    assert(before[c].in_use == 0 && before[c].allocs == 0);
+    assert(before[c].pool_free == before[c].pool_size);
+  }
+
+  // each size lands in the smallest class that holds it, counted there
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    pkt = network_pkt_alloc(sizes[i]);
+    assert(pkt != NULL);
+    assert(pkt->size == sizes[i]);
+    assert(pkt->data == pkt->head + NETWORK_PKT_HEADROOM);
+    memset(pkt->data, 'x', sizes[i]);
+    network_get_pkt_stats(stats);
+    for (c = 0; c < NETWORK_PKT_CLASSES; c++) {
+      assert(stats[c].in_use == (c == classes[i]));
+      assert(stats[c].allocs == before[c].allocs + (c == classes[i]));
+    }
+    c = classes[i];
+    assert(stats[c].capacity >= sizes[i]);
+    assert(stats[c].payload == sizes[i]);
+    assert(stats[c].bytes >= stats[c].capacity + NETWORK_PKT_HEADROOM);
+    assert(stats[c].pool_free == stats[c].pool_size - 1);
+    network_free_pkt(pkt);
+    network_get_pkt_stats(before);
+    assert(before[c].in_use == 0 && before[c].bytes == 0);
+    assert(before[c].payload == 0);
+    assert(before[c].pool_free == before[c].pool_size);
+    assert(before[c].peak_in_use == 1);
+  }
+
+  // pull and push stay within the packet
+  pkt = network_pkt_alloc(100);
+  assert(network_pkt_pull(pkt, 101) == NULL);
+  assert(network_pkt_pull(pkt, 40) == pkt->head + NETWORK_PKT_HEADROOM + 40);
+  assert(pkt->size == 60);
+  assert(network_pkt_push(pkt, NETWORK_PKT_HEADROOM + 41) == NULL);
+  assert(network_pkt_push(pkt, NETWORK_PKT_HEADROOM + 40) == pkt->head);
+  assert(pkt->size == 100 + NETWORK_PKT_HEADROOM);
+  network_free_pkt(pkt);
+
+  // a pool that runs dry mallocs, and gets all its buffers back
+  n = before[0].pool_size + EXTRA;
+  for (i = 0; i < n; i++) {
+    pkts[i] = network_pkt_alloc(10);
+    assert(pkts[i] != NULL);
+    pkts[i]->data[0] = (char)i;
+  }
+  network_get_pkt_stats(stats);
+  assert(stats[0].pool_free == 0);
+  assert(stats[0].in_use == n && stats[0].peak_in_use == n);
+  assert(stats[0].malloced == before[0].malloced + EXTRA);
+  assert(stats[0].payload == 10L * n);
+  for (i = 0; i < n; i++) {
+    assert(pkts[i]->data[0] == (char)i);
+    network_free_pkt(pkts[i]);
+  }
+  network_get_pkt_stats(stats);
+  assert(stats[0].pool_free == stats[0].pool_size);
+  assert(stats[0].in_use == 0 && stats[0].bytes == 0);
+  assert(stats[1].in_use == 0 && stats[2].in_use == 0);
+
+  network_print_pkt_stats();
+  printf("All packet pool tests passed.\n");
+  return 0;
+}
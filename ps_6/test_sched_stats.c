@@ -0,0 +1,162 @@
+/* test_sched_stats.c
+   Checks the scheduler statistics: threads show up in the thread stats
+   with their names and states, spinning threads are charged CPU time,
+   wakeups, blocks and clock ticks are counted, and the waits land in
+   the histograms. Prints the top view at the end.
+   Usage: test_sched_stats
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define ROUNDS 1000
+#define SPIN_NS (300 * 1000000ULL)
+#define MAX_THREADS 64
+
+semaphore_t ping;
+semaphore_t pong;
+semaphore_t done;
+volatile long counter = 0;
+
+int
+ponger(int* arg) {
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) {
+    semaphore_P(ping);
+    semaphore_V(pong);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+/*
+ * Spins, yielding now and then, mostly outside the clock library call,
+ * where clock interrupts would be dropped. Leaves the CPU time it was
+ * charged in *arg.
+ */
+int
+spinner(int* arg) {
+  thread_stats threads[MAX_THREADS];
+  uint64_t start = minithread_time_ns();
+  int n;
+  int i;
+
+  while (minithread_time_ns() - start < SPIN_NS) {
+    for (i = 0; i < 100000; i++) counter++;
+    minithread_yield();
+  }
+  n = minithread_get_thread_stats(threads, MAX_THREADS);
+  for (i = 0; i < n; i++) {
+    if (threads[i].id == minithread_id()) *(uint64_t*)arg = threads[i].cpu_time;
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+/*
+ * Finds the stats of the thread named name, or returns NULL.
+ */
+thread_stats_t
+find(thread_stats_t threads, int n, char* name) {
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (strcmp(threads[i].name, name) == 0) return &threads[i];
+  }
+  return NULL;
+}
+
+long
+sum(long* buckets) {
+  long total = 0;
+  int i;
+
+  for (i = 0; i < MINITHREAD_LATENCY_BUCKETS; i++) {
+    total += buckets[i];
+  }
+  return total;
+}
+
+int
+run_stats_test(int* arg) {
+  thread_stats threads[MAX_THREADS];
+  scheduler_stats stats;
+  thread_stats_t t;
+  minithread_attr attr;
+  uint64_t cpu[2];
+  int n;
+  int i;
+
+  assert(minithread_get_scheduler_stats(NULL) == -1);
+  minithread_reset_scheduler_stats();
+  assert(minithread_get_scheduler_stats(&stats) == 0);
+  assert(stats.wakeups == 0 && stats.blocks == 0);
+
+  // a blocked thread, and ping-pong with it
+  minithread_attr_init(&attr);
+  attr.name = "ponger";
+  minithread_fork_ex(ponger, NULL, &attr);
+  minithread_yield();
+  n = minithread_get_thread_stats(threads, MAX_THREADS);
+  assert((t = find(threads, n, "ponger")) != NULL);
+  assert(t->state == 'B' && t->runs == 1 && t->wakeups == 0);
+  assert((t = find(threads, n, "idle")) != NULL);
+  assert((t = find(threads, n, "packets")) != NULL);
+  assert(t->priority == MINITHREAD_PRIORITY_SYSTEM);
+  for (i = 0; i < ROUNDS; i++) {
+    semaphore_V(ping);
+    semaphore_P(pong);
+  }
+  semaphore_P(done);
+
+  assert(minithread_get_scheduler_stats(&stats) == 0);
+  assert(stats.wakeups >= 2 * ROUNDS && stats.blocks >= 2 * ROUNDS);
+  assert(sum(stats.block_time) == stats.wakeups);
+  assert(sum(stats.run_wait) > 0);
+  assert(stats.switches >= 2 * ROUNDS);
+  assert(stats.max_run_wait > 0);
+
+  // threads that spin are charged for it, and the clock ticks counted
+  attr.name = "spinner";
+  minithread_fork_ex(spinner, (int*)&cpu[0], &attr);
+  minithread_fork_ex(spinner, (int*)&cpu[1], &attr);
+  n = minithread_get_thread_stats(threads, MAX_THREADS);
+  assert((t = find(threads, n, "spinner")) != NULL);
+  assert(t->state == 'W' && t->runs == 0);
+  semaphore_P(done);
+  semaphore_P(done);
+  assert(find(threads, minithread_get_thread_stats(threads, MAX_THREADS),
+      "spinner") == NULL);
+  for (i = 0; i < 2; i++) {
+    assert(cpu[i] > SPIN_NS / 4 && cpu[i] < 2 * SPIN_NS);
+  }
+
+  assert(minithread_get_scheduler_stats(&stats) == 0);
+  assert(sum(stats.ticks) >= 1 && stats.yields > 2);
+  n = minithread_get_thread_stats(threads, MAX_THREADS);
+  for (i = 0; i < n; i++) {
+    assert(threads[i].cpu_time < stats.uptime + SPIN_NS);
+  }
+
+  minithread_print_stats();
+  printf("All scheduler statistics tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  ping = semaphore_create();
+  semaphore_initialize(ping, 0);
+  pong = semaphore_create();
+  semaphore_initialize(pong, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_stats_test, NULL);
+  return 0;
+}
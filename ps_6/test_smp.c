@@ -0,0 +1,73 @@
+/* test_smp.c
+   Runs CPU bound threads on several processors.
+   Usage: test_smp [processors] [threads]
+   Each thread does the same amount of work, so the elapsed time
+   should drop close to linearly as processors are added (up to the
+   number of cores on the machine).
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define WORK 200000000L
+
+int num_threads = 8;
+semaphore_t done;
+semaphore_t results_lock;
+long total = 0;
+
+int
+spin(int* arg) {
+  long i;
+  long count = 0;
+
+  for (i = 0; i < WORK; i++) {
+    count += i & 1;
+  }
+  semaphore_P(results_lock);
+  total += count;
+  semaphore_V(results_lock);
+  semaphore_V(done);
+  return 0;
+}
+
+int
+run_smp_test(int* arg) {
+  int i;
+  uint64_t start;
+
+  start = currentTimeMillis();
+  for (i = 0; i < num_threads; i++) {
+    minithread_fork(spin, NULL);
+  }
+  for (i = 0; i < num_threads; i++) {
+    semaphore_P(done);
+  }
+  assert(total == num_threads * (WORK / 2));
+  printf("%d threads on %d processors: %lu ms\n", num_threads, *arg,
+      (unsigned long)(currentTimeMillis() - start));
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  int n = 1;
+
+  if (argc > 1) {
+    n = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    num_threads = atoi(argv[2]);
+  }
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  results_lock = semaphore_create();
+  semaphore_initialize(results_lock, 1);
+  minithread_set_processors(n);
+  minithread_system_initialize(run_smp_test, &n);
+  return 0;
+}
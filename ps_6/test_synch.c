@@ -0,0 +1,307 @@
+/* test_synch.c
+   Checks mutexes, condition variables, reader-writer locks,
+   semaphore_P_timeout and channels, with threads that yield inside
+   their critical sections so they are always contended.
+   Usage: test_synch [processors]
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define THREADS 8
+#define ROUNDS 2000
+#define SLOTS 4
+#define TIMEOUT 50 //milliseconds
+#define BATCH 7
+
+mutex_t mutex;
+condvar_t not_full;
+condvar_t not_empty;
+rwlock_t rwlock;
+semaphore_t sem;
+semaphore_t done;
+channel_t channel;
+
+int counter = 0;
+int buffer[SLOTS];
+int head = 0;
+int count = 0;
+long consumed = 0;
+int readers = 0;
+int writers = 0;
+int max_readers = 0;
+volatile int timeouts_passed = 0;
+long received = 0;
+
+int
+incrementer(int* arg) {
+  int i;
+  int tmp;
+
+  for (i = 0; i < ROUNDS; i++) {
+    mutex_lock(mutex);
+    tmp = counter;
+    if (i % 8 == 0) minithread_yield();
+    counter = tmp + 1;
+    mutex_unlock(mutex);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+producer(int* arg) {
+  int i;
+
+  for (i = 1; i <= ROUNDS; i++) {
+    mutex_lock(mutex);
+    while (count == SLOTS) {
+      condvar_wait(not_full, mutex);
+    }
+    buffer[(head + count++) % SLOTS] = i;
+    condvar_signal(not_empty);
+    mutex_unlock(mutex);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+consumer(int* arg) {
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) {
+    mutex_lock(mutex);
+    while (count == 0) {
+      condvar_wait(not_empty, mutex);
+    }
+    consumed += buffer[head];
+    head = (head + 1) % SLOTS;
+    count--;
+    condvar_broadcast(not_full);
+    mutex_unlock(mutex);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+reader(int* arg) {
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) {
+    rwlock_read_lock(rwlock);
+    __sync_fetch_and_add(&readers, 1);
+    assert(writers == 0);
+    if (readers > max_readers) max_readers = readers;
+    minithread_yield();
+    assert(writers == 0);
+    __sync_fetch_and_sub(&readers, 1);
+    rwlock_read_unlock(rwlock);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+writer(int* arg) {
+  int i;
+
+  for (i = 0; i < ROUNDS / 10; i++) {
+    rwlock_write_lock(rwlock);
+    assert(__sync_fetch_and_add(&writers, 1) == 0);
+    assert(readers == 0);
+    minithread_yield();
+    assert(readers == 0);
+    __sync_fetch_and_sub(&writers, 1);
+    rwlock_write_unlock(rwlock);
+    minithread_yield();
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+timed_waiter(int* arg) {
+  if (semaphore_P_timeout(sem, 10 * TIMEOUT) == 0) {
+    __sync_fetch_and_add(&timeouts_passed, 1);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+/*
+ * Items are numbered 1 to ROUNDS per sender, plus the sender's number
+ * times ROUNDS, so none are NULL and every receiver can check that each
+ * sender's items come to it in order.
+ */
+int
+sender(int* arg) {
+  void* items[BATCH];
+  int i = 1;
+  int n;
+
+  while (i <= ROUNDS) {
+    for (n = 0; n < 1 + i % BATCH && i <= ROUNDS; n++, i++) {
+      items[n] = (void*)(long)(*arg * ROUNDS + i);
+    }
+    channel_send_batch(channel, items, n);
+    if (i % 3 == 0) minithread_yield();
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+receiver(int* arg) {
+  void* items[BATCH];
+  long last[THREADS / 2];
+  long item;
+  int got = 0;
+  int n;
+  int i;
+
+  for (i = 0; i < THREADS / 2; i++) {
+    last[i] = 0;
+  }
+  while (got < ROUNDS) {
+    n = got % 2 == 0 ? BATCH : 1;
+    if (n > ROUNDS - got) n = ROUNDS - got;
+    n = channel_receive_batch(channel, items, n);
+    for (i = 0; i < n; i++) {
+      item = (long)items[i] - 1;
+      assert(item % ROUNDS + 1 > last[item / ROUNDS]);
+      last[item / ROUNDS] = item % ROUNDS + 1;
+      __sync_fetch_and_add(&received, item % ROUNDS + 1);
+    }
+    got += n;
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+run_synch_test(int* arg) {
+  int ids[THREADS / 2];
+  void* item;
+  uint64_t start;
+  int i;
+  int j;
+
+  // mutual exclusion
+  for (i = 0; i < THREADS; i++) {
+    minithread_fork(incrementer, NULL);
+  }
+  for (i = 0; i < THREADS; i++) {
+    semaphore_P(done);
+  }
+  assert(counter == THREADS * ROUNDS);
+  mutex_lock(mutex);
+  assert(mutex_trylock(mutex) == -1);
+  mutex_unlock(mutex);
+  assert(mutex_trylock(mutex) == 0);
+  mutex_unlock(mutex);
+  printf("mutex..........................SUCCESS\n");
+
+  // bounded buffer
+  for (i = 0; i < THREADS / 2; i++) {
+    minithread_fork(producer, NULL);
+    minithread_fork(consumer, NULL);
+  }
+  for (i = 0; i < THREADS; i++) {
+    semaphore_P(done);
+  }
+  assert(count == 0);
+  assert(consumed == (long)THREADS / 2 * ROUNDS * (ROUNDS + 1) / 2);
+  printf("condition variables............SUCCESS\n");
+
+  // readers share, writers do not
+  for (i = 0; i < THREADS; i++) {
+    minithread_fork(i % 4 == 0 ? writer : reader, NULL);
+  }
+  for (i = 0; i < THREADS; i++) {
+    semaphore_P(done);
+  }
+  assert(max_readers > 1);
+  printf("reader-writer locks............SUCCESS\n");
+
+  // timing out leaves the count alone
+  start = minithread_time_ns();
+  assert(semaphore_P_timeout(sem, TIMEOUT) == -1);
+  assert(minithread_time_ns() - start >= TIMEOUT * MILLISECOND);
+  semaphore_V(sem);
+  assert(semaphore_P_timeout(sem, TIMEOUT) == 0);
+  assert(semaphore_P_timeout(sem, 0) == -1);
+
+  // woken up before the timeout
+  for (i = 0; i < THREADS; i++) {
+    minithread_fork(timed_waiter, NULL);
+  }
+  minithread_sleep_with_timeout(TIMEOUT);
+  for (i = 0; i < THREADS / 2; i++) {
+    semaphore_V(sem);
+  }
+  for (i = 0; i < THREADS; i++) {
+    semaphore_P(done);
+  }
+  assert(timeouts_passed == THREADS / 2);
+  assert(semaphore_P_timeout(sem, 1) == -1);
+  printf("semaphore_P_timeout............SUCCESS\n");
+
+  // first in, first out, and the try calls never wait
+  assert(channel_create(0) == NULL);
+  assert(channel_try_receive(channel, &item) == -1);
+  for (i = 0; i < SLOTS; i++) {
+    assert(channel_try_send(channel, (void*)(long)i) == 0);
+  }
+  assert(channel_try_send(channel, NULL) == -1);
+  assert(channel_receive(channel) == (void*)0);
+  channel_send(channel, (void*)(long)SLOTS);
+  for (i = 1; i <= SLOTS; i++) {
+    assert(channel_try_receive(channel, &item) == 0 && item == (void*)(long)i);
+  }
+  assert(channel_receive_batch(channel, &item, 0) == 0);
+
+  // many senders and receivers, with batches bigger than the channel,
+  // then the same again with handoff
+  for (j = 0; j < 2; j++) {
+    channel_set_handoff(channel, j);
+    received = 0;
+    for (i = 0; i < THREADS / 2; i++) {
+      ids[i] = i;
+      minithread_fork(sender, &ids[i]);
+      minithread_fork(receiver, NULL);
+    }
+    for (i = 0; i < THREADS; i++) {
+      semaphore_P(done);
+    }
+    assert(received == (long)THREADS / 2 * ROUNDS * (ROUNDS + 1) / 2);
+    assert(channel_try_receive(channel, &item) == -1);
+  }
+  printf("channels.......................SUCCESS\n");
+
+  printf("All synchronization tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    minithread_set_processors(atoi(argv[1]));
+  }
+  mutex = mutex_create();
+  not_full = condvar_create();
+  not_empty = condvar_create();
+  rwlock = rwlock_create();
+  sem = semaphore_create();
+  semaphore_initialize(sem, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  channel = channel_create(SLOTS);
+  minithread_system_initialize(run_synch_test, NULL);
+  return 0;
+}
@@ -0,0 +1,166 @@
+/* test_taskpool.c
+   Checks task pools: futures return what their tasks returned, tasks
+   can submit and join tasks of their own, parallel_for calls its body
+   exactly once per index whatever the grain, and taskpool_destroy waits
+   for detached tasks. With more than one processor it also checks that
+   tasks ran on more than one of them.
+   Usage: test_taskpool [processors]
+*/
+#include "minithread.h"
+#include "taskpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define TASKS 1000
+#define FIB 18
+#define N 10000
+#define SPIN_NS (1000 * 1000)
+
+int num_procs = 1;
+taskpool_t pool;
+int counts[N];
+volatile int finished = 0;
+volatile int ran_on[8];
+
+int
+square(int* arg) {
+  int n = (int)(intptr_t)arg;
+
+  return n * n;
+}
+
+int
+fib(int* arg) {
+  int n = (int)(intptr_t)arg;
+  future_t f;
+  int a;
+
+  if (n < 2) return n;
+  f = taskpool_submit(pool, fib, (arg_t)(intptr_t)(n - 1));
+  assert(f != NULL);
+  a = fib((arg_t)(intptr_t)(n - 2));
+  return a + future_join(f);
+}
+
+int
+fib_serial(int n) {
+  return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+int
+finish(int* arg) {
+  __sync_fetch_and_add(&finished, 1);
+  return 0;
+}
+
+int
+spin(int* arg) {
+  uint64_t start = minithread_time_ns();
+
+  while (minithread_time_ns() - start < SPIN_NS);
+  ran_on[minithread_processor() % 8] = 1;
+  return 0;
+}
+
+void
+count(int i, void* arg) {
+  __sync_fetch_and_add(&counts[i], *(int*)arg);
+}
+
+void
+check_loop(int start, int end, int grain) {
+  int one = 1;
+  int i;
+
+  for (i = 0; i < N; i++) counts[i] = 0;
+  assert(parallel_for(pool, start, end, grain, count, &one) == 0);
+  for (i = 0; i < N; i++) {
+    assert(counts[i] == (i >= start && i < end));
+  }
+}
+
+int
+nested_loop(int* arg) {
+  check_loop(0, N, 3);
+  return 7;
+}
+
+int
+run_taskpool_test(int* arg) {
+  future_t futures[TASKS];
+  future_t f;
+  long sum = 0;
+  int i;
+
+  pool = taskpool_create(0);
+  assert(pool != NULL);
+
+  // futures from outside the pool
+  for (i = 0; i < TASKS; i++) {
+    futures[i] = taskpool_submit(pool, square, (arg_t)(intptr_t)i);
+    assert(futures[i] != NULL);
+  }
+  for (i = 0; i < TASKS; i++) {
+    sum += future_join(futures[i]);
+  }
+  assert(sum == (long)(TASKS - 1) * TASKS * (2 * TASKS - 1) / 6);
+  assert(taskpool_submit(pool, NULL, NULL) == NULL);
+
+  // divide and conquer with nested joins
+  f = taskpool_submit(pool, fib, (arg_t)FIB);
+  assert(future_join(f) == fib_serial(FIB));
+
+  // future_done
+  f = taskpool_submit(pool, square, (arg_t)3);
+  while (!future_done(f)) minithread_yield();
+  assert(future_join(f) == 9);
+
+  // parallel_for, from outside the pool and from a task
+  check_loop(0, N, 0);
+  check_loop(0, N, 1);
+  check_loop(17, N - 5, 7);
+  check_loop(0, N, N + 5);
+  check_loop(5, 5, 0);
+  check_loop(5, 0, 0);
+  f = taskpool_submit(pool, nested_loop, NULL);
+  assert(future_join(f) == 7);
+  assert(parallel_for(pool, 0, N, 0, NULL, NULL) == -1);
+
+  // work spreads over the processors
+  for (i = 0; i < TASKS / 10; i++) {
+    futures[i] = taskpool_submit(pool, spin, NULL);
+  }
+  for (i = 0; i < TASKS / 10; i++) {
+    future_join(futures[i]);
+  }
+  if (num_procs > 1) {
+    for (i = 0, sum = 0; i < 8; i++) sum += ran_on[i];
+    assert(sum > 1);
+  }
+  taskpool_destroy(pool);
+
+  // destroy waits for detached tasks, on a pool of its own size
+  pool = taskpool_create(3);
+  assert(pool != NULL);
+  for (i = 0; i < TASKS; i++) {
+    future_detach(taskpool_submit(pool, finish, NULL));
+  }
+  taskpool_destroy(pool);
+  assert(finished == TASKS);
+
+  printf("All task pool tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    num_procs = atoi(argv[1]);
+  }
+  minithread_set_processors(num_procs);
+  minithread_system_initialize(run_taskpool_test, NULL);
+  return 0;
+}
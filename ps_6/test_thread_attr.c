@@ -0,0 +1,142 @@
+/* test_thread_attr.c
+   Makes threads with minithread_fork_ex and checks that their
+   attributes take effect, and that priorities can be changed and last
+   across blocking, then keeps many threads with small stacks
+   alive at once and checks they only take memory for the stack they use.
+   Usage: test_thread_attr [threads]
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#define DEFAULT_THREADS 200000
+
+int threads = DEFAULT_THREADS;
+semaphore_t started;
+semaphore_t go;
+semaphore_t done;
+
+/* resident memory of the process, in bytes */
+long
+resident() {
+  long pages = 0;
+  long rss = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+
+  assert(f != NULL);
+  assert(fscanf(f, "%ld %ld", &pages, &rss) == 2);
+  fclose(f);
+  return rss * sysconf(_SC_PAGESIZE);
+}
+
+int
+check_attrs(int* arg) {
+  assert(strcmp(minithread_name(minithread_self()), "checker") == 0);
+  assert(minithread_priority() == *arg);
+  semaphore_V(done);
+  return 0;
+}
+
+int
+check_priority(int* arg) {
+  assert(minithread_get_priority(minithread_self()) == 1);
+  semaphore_P(go);
+  assert(minithread_priority() == 1);
+
+  assert(minithread_set_priority(minithread_self(), 3) == 0);
+  minithread_yield();
+  assert(minithread_priority() == 3);
+  assert(minithread_nice(-1) == 2);
+  assert(minithread_nice(SCHED_LEVELS) == SCHED_LEVELS - 1);
+  assert(minithread_nice(-SCHED_LEVELS) == 0);
+  assert(minithread_set_priority(minithread_self(), -1) == -1);
+  assert(minithread_set_priority(minithread_self(), SCHED_LEVELS) == -1);
+  assert(minithread_get_priority(minithread_self()) == 0);
+  semaphore_V(done);
+  return 0;
+}
+
+int
+blocker(int* arg) {
+  semaphore_V(started);
+  semaphore_P(go);
+  semaphore_V(done);
+  return 0;
+}
+
+int
+run_attr_test(int* arg) {
+  minithread_attr attr;
+  int priority = 2;
+  long before;
+  long used;
+  int i;
+
+  // name and priority
+  minithread_attr_init(&attr);
+  attr.name = "checker";
+  attr.priority = priority;
+  assert(minithread_fork_ex(check_attrs, &priority, &attr) != NULL);
+  semaphore_P(done);
+  assert(strcmp(minithread_name(minithread_self()), "") == 0);
+
+  // priorities last across blocking, and can be changed
+  attr.priority = 1;
+  assert(minithread_fork_ex(check_priority, NULL, &attr) != NULL);
+  minithread_yield();
+  semaphore_V(go);
+  semaphore_P(done);
+
+  // bad attributes
+  attr.priority = SCHED_LEVELS;
+  assert(minithread_fork_ex(check_attrs, &priority, &attr) == NULL);
+  minithread_attr_init(&attr);
+  attr.stack_size = MIN_STACKSIZE - 1;
+  assert(minithread_fork_ex(check_attrs, &priority, &attr) == NULL);
+
+  // many small threads, all alive at once
+  minithread_attr_init(&attr);
+  attr.stack_size = MIN_STACKSIZE;
+  attr.guard_size = 0;
+  before = resident();
+  for (i = 0; i < threads; i++) {
+    assert(minithread_fork_ex(blocker, NULL, &attr) != NULL);
+    semaphore_P(started);
+  }
+  used = resident() - before;
+  printf("%d threads with %d KB stacks: %ld KB resident, %ld bytes each\n",
+      threads, MIN_STACKSIZE / 1024, used / 1024, used / threads);
+
+  // each touched far less than its whole stack
+  assert(used / threads < MIN_STACKSIZE / 2);
+
+  for (i = 0; i < threads; i++) {
+    semaphore_V(go);
+  }
+  for (i = 0; i < threads; i++) {
+    semaphore_P(done);
+  }
+  printf("All thread attribute tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    threads = atoi(argv[1]);
+  }
+  started = semaphore_create();
+  semaphore_initialize(started, 0);
+  go = semaphore_create();
+  semaphore_initialize(go, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_attr_test, NULL);
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* test_wait_queue.c
+   Checks that threads blocked on a semaphore wake up in order, and
+   that blocking and waking threads (semaphore handoffs, minithread_stop
+   and minithread_start, context switches) never allocates memory.
+   Usage: test_wait_queue [round trips]
+*/
+#include "minithread.h"
+#include "synch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define DEFAULT_ROUNDS 100000
+#define WAITERS 5
+
+extern void* __libc_malloc(size_t size);
+
+volatile long malloc_calls = 0;
+
+/*
+ * counts the mallocs made by minithreads, then hands every malloc to
+ * libc. The device threads allocate packets as they arrive.
+ */
+void*
+malloc(size_t size) {
+  if (minithread_self() != NULL) {
+    __sync_fetch_and_add(&malloc_calls, 1);
+  }
+  return __libc_malloc(size);
+}
+
+int rounds = DEFAULT_ROUNDS;
+semaphore_t ping;
+semaphore_t pong;
+semaphore_t wait_sem;
+semaphore_t done;
+int order[WAITERS];
+int woken = 0;
+minithread_t stopper_thread;
+
+int
+ponger(int* arg) {
+  int i;
+
+  for (i = 0; i < rounds; i++) {
+    semaphore_P(ping);
+    semaphore_V(pong);
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+waiter(int* arg) {
+  semaphore_P(wait_sem);
+  order[woken++] = *arg;
+  semaphore_V(done);
+  return 0;
+}
+
+int
+stopper(int* arg) {
+  int i;
+
+  for (i = 0; i < rounds; i++) {
+    minithread_stop();
+  }
+  semaphore_V(done);
+  return 0;
+}
+
+int
+run_wait_queue_test(int* arg) {
+  int ids[WAITERS];
+  long before;
+  int i;
+
+  // waiters wake up in the order they blocked
+  for (i = 0; i < WAITERS; i++) {
+    ids[i] = i;
+    minithread_fork(waiter, &ids[i]);
+  }
+  minithread_yield();
+  for (i = 0; i < WAITERS; i++) {
+    semaphore_V(wait_sem);
+    semaphore_P(done);
+  }
+  for (i = 0; i < WAITERS; i++) {
+    assert(order[i] == i);
+  }
+
+  // semaphore ping-pong
+  minithread_fork(ponger, NULL);
+  minithread_yield();
+  before = malloc_calls;
+  for (i = 0; i < rounds; i++) {
+    semaphore_V(ping);
+    semaphore_P(pong);
+  }
+  printf("%d semaphore round trips: %ld mallocs\n", rounds, malloc_calls - before);
+  assert(malloc_calls == before);
+  semaphore_P(done);
+
+  // stopping and starting a thread
+  stopper_thread = minithread_fork(stopper, NULL);
+  minithread_yield();
+  before = malloc_calls;
+  for (i = 0; i < rounds; i++) {
+    minithread_start(stopper_thread);
+    minithread_yield();
+  }
+  printf("%d stops and starts: %ld mallocs\n", rounds, malloc_calls - before);
+  assert(malloc_calls == before);
+  semaphore_P(done);
+
+  printf("All wait queue tests passed.\n");
+  exit(0);
+  return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  if (argc > 1) {
+    rounds = atoi(argv[1]);
+  }
+  ping = semaphore_create();
+  semaphore_initialize(ping, 0);
+  pong = semaphore_create();
+  semaphore_initialize(pong, 0);
+  wait_sem = semaphore_create();
+  semaphore_initialize(wait_sem, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+  minithread_system_initialize(run_wait_queue_test, NULL);
+  return 0;
+}